@@ -0,0 +1,103 @@
+// Times BlockBuilder::compute_data_flow on large synthetic TAC:
+// one function made of many labelled blocks with forward and backward
+// conditional jumps over a shared pool of variables.
+//
+// usage: dataflow_bench [blocks] [vars] [runs]
+#include "modules/block.hh"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace twlm::ccpl::modules;
+
+namespace
+{
+    std::shared_ptr<SYM> make_sym(SYM_TYPE type, const std::string &name)
+    {
+        auto sym = std::make_shared<SYM>();
+        sym->type = type;
+        sym->name = name;
+        sym->data_type = DATA_TYPE::INT;
+        sym->scope = SYM_SCOPE::LOCAL;
+        return sym;
+    }
+
+    struct Emitter
+    {
+        std::shared_ptr<TAC> first, last;
+        int count = 0;
+
+        void emit(TAC_OP op, std::shared_ptr<SYM> a = nullptr,
+                  std::shared_ptr<SYM> b = nullptr, std::shared_ptr<SYM> c = nullptr)
+        {
+            auto tac = std::make_shared<TAC>(op);
+            tac->a = a;
+            tac->b = b;
+            tac->c = c;
+            tac->prev = last;
+            if (last)
+                last->next = tac;
+            else
+                first = tac;
+            last = tac;
+            count++;
+        }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    int num_blocks = argc > 1 ? std::stoi(argv[1]) : 2000;
+    int num_vars = argc > 2 ? std::stoi(argv[2]) : 200;
+    int runs = argc > 3 ? std::stoi(argv[3]) : 5;
+
+    std::mt19937 rng(2024);
+    auto pick = [&](int n) { return static_cast<int>(rng() % n); };
+
+    std::vector<std::shared_ptr<SYM>> vars, labels;
+    for (int i = 0; i < num_vars; i++)
+        vars.push_back(make_sym(SYM_TYPE::VAR, "v" + std::to_string(i)));
+    for (int i = 0; i < num_blocks; i++)
+        labels.push_back(make_sym(SYM_TYPE::LABEL, "L" + std::to_string(i + 1)));
+
+    Emitter out;
+    out.emit(TAC_OP::LABEL, make_sym(SYM_TYPE::LABEL, "main"));
+    out.emit(TAC_OP::BEGINFUNC);
+    for (auto &var : vars)
+        out.emit(TAC_OP::VAR, var);
+    for (auto &var : vars)
+        out.emit(TAC_OP::INPUT, var);
+
+    for (int i = 0; i < num_blocks; i++)
+    {
+        out.emit(TAC_OP::LABEL, labels[i]);
+        for (int k = 0; k < 4; k++)
+            out.emit(TAC_OP::ADD, vars[pick(num_vars)], vars[pick(num_vars)], vars[pick(num_vars)]);
+
+        // Mostly short backward jumps (loops), some long forward ones
+        int kind = pick(4);
+        if (kind == 0 && i > 0)
+            out.emit(TAC_OP::IFZ, labels[std::max(0, i - 1 - pick(8))], vars[pick(num_vars)]);
+        else if (kind == 1)
+            out.emit(TAC_OP::IFZ, labels[std::min(num_blocks - 1, i + 1 + pick(64))], vars[pick(num_vars)]);
+    }
+    for (auto &var : vars)
+        out.emit(TAC_OP::OUTPUT, var);
+    out.emit(TAC_OP::ENDFUNC);
+
+    BlockBuilder builder(out.first);
+    builder.build();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++)
+        builder.compute_data_flow();
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+    std::cout << "blocks: " << builder.get_basic_blocks().size()
+              << "  tac: " << out.count
+              << "  vars: " << num_vars << std::endl;
+    std::cout << "compute_data_flow: " << elapsed.count() / runs << " ms/run ("
+              << runs << " runs)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace twlm::ccpl::abstraction
+{
+    // 定长位集合：数据流分析中按编号表示变量或定值
+    struct BitSet
+    {
+        std::vector<uint64_t> words;
+        size_t bits;
+
+        BitSet() : bits(0) {}
+        explicit BitSet(size_t n) : words((n + 63) / 64, 0), bits(n) {}
+
+        size_t size() const { return bits; }
+
+        void set(size_t i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+        void reset(size_t i) { words[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+        bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+
+        void clear() { std::fill(words.begin(), words.end(), 0); }
+        void fill()
+        {
+            std::fill(words.begin(), words.end(), ~uint64_t(0));
+            if (bits % 64)
+                words.back() = (uint64_t(1) << (bits % 64)) - 1;
+        }
+
+        // 并集，返回是否有新的位
+        bool unite(const BitSet &other)
+        {
+            bool changed = false;
+            for (size_t i = 0; i < words.size(); ++i)
+            {
+                auto word = words[i] | other.words[i];
+                changed |= word != words[i];
+                words[i] = word;
+            }
+            return changed;
+        }
+
+        void intersect(const BitSet &other)
+        {
+            for (size_t i = 0; i < words.size(); ++i)
+                words[i] &= other.words[i];
+        }
+
+        void subtract(const BitSet &other)
+        {
+            for (size_t i = 0; i < words.size(); ++i)
+                words[i] &= ~other.words[i];
+        }
+
+        bool operator==(const BitSet &other) const { return words == other.words; }
+        bool operator!=(const BitSet &other) const { return words != other.words; }
+
+        // 依次访问每个置位的编号
+        template <typename F>
+        void for_each(F f) const
+        {
+            for (size_t i = 0; i < words.size(); ++i)
+            {
+                for (auto word = words[i]; word; word &= word - 1)
+                    f(i * 64 + __builtin_ctzll(word));
+            }
+        }
+    };
+}
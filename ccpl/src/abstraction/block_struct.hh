@@ -2,6 +2,7 @@
 #include <memory>
 #include <vector>
 #include "tac_struct.hh"
+#include "bitset_struct.hh"
 #include <unordered_map>
 #include <unordered_set>
 
@@ -17,16 +18,51 @@ namespace twlm::ccpl::abstraction
             : id(id), start(start), end(nullptr) {}
     };
 
+    // 一个函数的控制流图：blocks 按程序顺序排列，第一个为入口块
+    struct FunctionCFG
+    {
+        std::string name;  // 函数名，函数之前的全局代码为空
+        std::vector<std::shared_ptr<BasicBlock>> blocks;
+        std::vector<std::shared_ptr<SYM>> formals;
+    };
+
+    // 自然循环：header 支配循环中的所有块，latches 是回边的源块
+    struct Loop
+    {
+        std::shared_ptr<BasicBlock> header;
+        std::shared_ptr<BasicBlock> preheader;              // 唯一的循环外前驱，且只流向 header
+        std::vector<std::shared_ptr<BasicBlock>> blocks;     // 按程序顺序排列
+        std::unordered_set<std::shared_ptr<BasicBlock>> block_set;
+        std::vector<std::shared_ptr<BasicBlock>> latches;
+        std::vector<std::shared_ptr<BasicBlock>> exits;      // 循环外的后继块
+        std::shared_ptr<Loop> parent;                        // 外层循环
+        std::vector<std::shared_ptr<Loop>> children;
+        int depth;                                           // 最外层为 1
+
+        Loop() : header(nullptr), preheader(nullptr), parent(nullptr), depth(1) {}
+
+        bool contains(const std::shared_ptr<BasicBlock>& block) const
+        {
+            return block_set.count(block) > 0;
+        }
+    };
+
+    // 位向量数据流问题：按块下标给出 gen/kill，OUT = GEN ∪ (IN - KILL)（逆向时交换 IN/OUT）
+    struct DataFlowProblem
+    {
+        bool forward;                 // 前向（到达定值）或逆向（活跃变量）
+        bool meet_union;              // 交汇取并集，否则取交集
+        std::vector<BitSet> gen, kill;
+        BitSet boundary;              // 没有前驱（逆向时没有后继）的块的初值
+    };
+
     // 数据流分析结果
     struct DataFlowInfo
     {
-        // 到达定值集合：每个变量 -> 可能的定值指令集合
-        std::unordered_map<std::shared_ptr<SYM>, std::unordered_set<std::shared_ptr<TAC>>> reaching_defs;
+        // 到达定值集合，按 BlockBuilder 的定值编号
+        BitSet reaching_defs;
         
-        // 活跃变量集合
+        // 活跃变量集合（由位向量展开，供优化和代码生成直接查询）
         std::unordered_set<std::shared_ptr<SYM>> live_vars;
-        
-        // 常量传播信息：变量 -> 常量值（如果确定是常量）
-        std::unordered_map<std::shared_ptr<SYM>, int> constants;
     };
 }
\ No newline at end of file
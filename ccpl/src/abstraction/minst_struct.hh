@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <vector>
+#include <sstream>
+
+namespace twlm::ccpl::abstraction
+{
+    enum class MINST_KIND
+    {
+        INSN,    // Machine instruction or data directive
+        LABEL,   // Label definition
+        COMMENT  // Comment line, e.g. the TAC an instruction came from
+    };
+
+    enum class MOPND_KIND
+    {
+        REG,    // Register: R5
+        IMM,    // Non-negative constant: 8
+        LABEL,  // Address of a label: L3, STATIC
+        MEM,    // Memory word at base + disp: (R2+8)
+        EXPR,   // Register plus displacement, no memory access: R2+8
+        INSN    // Address of another instruction, written relative to R1
+    };
+
+    struct MInst;
+
+    // One operand of a machine instruction
+    struct MOperand
+    {
+        MOPND_KIND kind;
+        int base;                    // REG register, MEM and EXPR base register
+        int value;                   // IMM value, MEM and EXPR displacement,
+                                     // INSN byte offset once the code is laid out
+        std::string name;            // LABEL name
+        std::shared_ptr<MInst> insn; // INSN target; null until the next instruction is emitted
+
+        MOperand(MOPND_KIND kind = MOPND_KIND::IMM, int base = -1, int value = 0)
+            : kind(kind), base(base), value(value), insn(nullptr) {}
+
+        static MOperand reg(int r) { return MOperand(MOPND_KIND::REG, r); }
+        static MOperand imm(int value) { return MOperand(MOPND_KIND::IMM, -1, value); }
+        static MOperand mem(int r, int disp) { return MOperand(MOPND_KIND::MEM, r, disp); }
+        static MOperand expr(int r, int disp) { return MOperand(MOPND_KIND::EXPR, r, disp); }
+
+        static MOperand label(const std::string& name)
+        {
+            MOperand opnd(MOPND_KIND::LABEL);
+            opnd.name = name;
+            return opnd;
+        }
+
+        static MOperand addr_of(std::shared_ptr<MInst> insn)
+        {
+            MOperand opnd(MOPND_KIND::INSN, 1);
+            opnd.insn = insn;
+            return opnd;
+        }
+
+        std::string to_string() const
+        {
+            auto disp = [](int d) { return (d < 0 ? "-" : "+") + std::to_string(d < 0 ? -d : d); };
+            switch (kind)
+            {
+            case MOPND_KIND::REG:
+                return "R" + std::to_string(base);
+            case MOPND_KIND::IMM:
+                return std::to_string(value);
+            case MOPND_KIND::LABEL:
+                return name;
+            case MOPND_KIND::MEM:
+                return "(R" + std::to_string(base) + (value ? disp(value) : "") + ")";
+            case MOPND_KIND::EXPR:
+            case MOPND_KIND::INSN:
+                return "R" + std::to_string(base) + disp(value);
+            }
+            return "";
+        }
+    };
+
+    // One line of generated assembly
+    struct MInst
+    {
+        MINST_KIND kind;
+        std::string op;              // Opcode, label name or comment text
+        std::vector<MOperand> args;  // Operands
+
+        MInst(MINST_KIND kind = MINST_KIND::INSN, const std::string& op = "",
+              std::vector<MOperand> args = {})
+            : kind(kind), op(op), args(std::move(args)) {}
+
+        bool is_insn(const std::string& name) const
+        {
+            return kind == MINST_KIND::INSN && op == name;
+        }
+
+        std::string to_string() const
+        {
+            std::ostringstream oss;
+            switch (kind)
+            {
+            case MINST_KIND::LABEL:
+                oss << op << ":";
+                break;
+            case MINST_KIND::COMMENT:
+                oss << "\t# " << op;
+                break;
+            case MINST_KIND::INSN:
+                oss << "\t" << op;
+                for (size_t i = 0; i < args.size(); i++)
+                {
+                    oss << (i == 0 ? " " : ",") << args[i].to_string();
+                }
+                break;
+            }
+            return oss.str();
+        }
+    };
+}
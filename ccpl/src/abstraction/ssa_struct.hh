@@ -0,0 +1,30 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "block_struct.hh"
+
+namespace twlm::ccpl::abstraction
+{
+    // SSA 值：一条指令的定值、块入口的 phi，或函数入口处变量的初值
+    struct SSAValue
+    {
+        int id;
+        std::shared_ptr<SYM> var;                 // 对应的原变量
+        std::shared_ptr<TAC> def;                 // 定值指令，phi 和初值为空
+        std::shared_ptr<BasicBlock> block;
+        bool is_phi;
+
+        // phi 的参数：前驱块 -> 从该前驱流入的值
+        std::vector<std::pair<std::shared_ptr<BasicBlock>, int>> phi_args;
+
+        // 使用这个值的指令和 phi
+        std::vector<std::shared_ptr<TAC>> tac_users;
+        std::vector<int> phi_users;
+
+        SSAValue(int id, std::shared_ptr<SYM> var, std::shared_ptr<TAC> def,
+                 std::shared_ptr<BasicBlock> block, bool is_phi)
+            : id(id), var(var), def(def), block(block), is_phi(is_phi) {}
+
+        bool is_entry() const { return !def && !is_phi; }
+    };
+}
@@ -4,6 +4,10 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 
 twlm::ccpl::modules::ASTBuilder ast_builder;
 
@@ -11,25 +15,51 @@ int main(int argc, char *argv[])
 {
     if (argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " [-o] <input_file> [output_file]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [-o] [-u<n>] <input_file> [output_file]" << std::endl;
         std::cerr << "  -o: Enable TAC optimization" << std::endl;
+        std::cerr << "  -u<n>: Unroll loops by a factor of n (default 4, -u1 disables)" << std::endl;
         return 1;
     }
 
     bool enable_optimization = false;
+    twlm::ccpl::modules::UnrollOptions unroll_options;
     int arg_index = 1;
     
-    // Check for -o flag
-    if (argc > 1 && strcmp(argv[1], "-o") == 0)
+    // Check for -o and -u<n> flags
+    while (arg_index < argc && argv[arg_index][0] == '-')
     {
-        enable_optimization = true;
-        arg_index = 2;
+        if (strcmp(argv[arg_index], "-o") == 0)
+        {
+            enable_optimization = true;
+        }
+        else if (strncmp(argv[arg_index], "-u", 2) == 0)
+        {
+            // The factor must be a whole positive number, e.g. -u4
+            const char* value = argv[arg_index] + 2;
+            char* end = nullptr;
+            errno = 0;
+            long factor = isdigit(static_cast<unsigned char>(*value)) ? strtol(value, &end, 10) : 0;
+            if (!end || *end || errno == ERANGE || factor < 1 || factor > INT_MAX)
+            {
+                std::cerr << "Error: Invalid unroll factor " << argv[arg_index] << std::endl;
+                return 1;
+            }
+            unroll_options.factor = static_cast<int>(factor);
+            if (unroll_options.factor < 2)
+                unroll_options.full_trip_limit = 0;
+        }
+        else
+        {
+            std::cerr << "Error: Unknown option " << argv[arg_index] << std::endl;
+            return 1;
+        }
+        arg_index++;
     }
     
     if (arg_index >= argc)
     {
         std::cerr << "Error: No input file specified" << std::endl;
-        std::cerr << "Usage: " << argv[0] << " [-o] <input_file> [output_file]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [-o] [-u<n>] <input_file> [output_file]" << std::endl;
         return 1;
     }
     
@@ -76,22 +106,9 @@ int main(int argc, char *argv[])
         tac_gen.print_tac(std::clog);
         std::clog << std::endl;
 
-        //multi-function optimization is not supported yet
-        const auto & sym=tac_gen.get_global_symbols();
-        int func_count=0;
-        for(const auto& [name, sym_ptr]:sym){
-            if(sym_ptr->type==SYM_TYPE::FUNC){
-                func_count++;
-            }
-            if(func_count>1){
-                enable_optimization=false;
-                break;
-            }
-        }
-
         if (enable_optimization)
         {
-            twlm::ccpl::modules::TACOptimizer opt(tac_gen.get_tac_first());
+            twlm::ccpl::modules::TACOptimizer opt(tac_gen.get_tac_first(), unroll_options);
             opt.optimize();
             std::clog << "=== Optimized TAC ===" << std::endl;
             tac_gen.print_tac(std::clog);
@@ -4,6 +4,8 @@
 #include <iomanip>
 #include <queue>
 #include <climits>
+#include <algorithm>
+#include <set>
 using namespace twlm::ccpl::modules;
 
 bool BlockBuilder::is_leader(std::shared_ptr<TAC> tac, std::shared_ptr<TAC> prev)
@@ -11,9 +13,10 @@ bool BlockBuilder::is_leader(std::shared_ptr<TAC> tac, std::shared_ptr<TAC> prev
     if (!tac)
         return false;
 
-    // ENDFUNC 是终止语句
+    // ENDFUNC 是终止语句，一般并入前一个块；紧跟在跳转之后时单独成块，
+    // 否则 goto L; end 会以 ENDFUNC 结尾，跳转的后继就丢了
     if (tac->op == TAC_OP::ENDFUNC)
-        return false;
+        return prev && (prev->op == TAC_OP::GOTO || prev->op == TAC_OP::IFZ);
 
     if (tac == tac_first)
         return true;
@@ -91,15 +94,15 @@ std::shared_ptr<BasicBlock> BlockBuilder::find_block_by_label(std::shared_ptr<SY
     if (!label)
         return nullptr;
 
-    for (auto &block : basic_blocks)
-    {
-        if (block->start && block->start->op == TAC_OP::LABEL &&
-            block->start->a && block->start->a->name == label->name)
-        {
-            return block;
-        }
-    }
-    return nullptr;
+    auto it = label_blocks.find(label->name);
+    return it != label_blocks.end() ? it->second : nullptr;
+}
+
+// 函数入口块：label f; begin
+bool BlockBuilder::is_func_entry(std::shared_ptr<BasicBlock> block) const
+{
+    return block->start && block->start->op == TAC_OP::LABEL &&
+           block->start->next && block->start->next->op == TAC_OP::BEGINFUNC;
 }
 
 void BlockBuilder::build_cfg()
@@ -107,12 +110,28 @@ void BlockBuilder::build_cfg()
     if (basic_blocks.empty())
         return;
 
+    label_blocks.clear();
     for (auto &block : basic_blocks)
     {
         block->predecessors.clear();
         block->successors.clear();
+        if (block->start && block->start->op == TAC_OP::LABEL && block->start->a)
+        {
+            label_blocks[block->start->a->name] = block;
+        }
     }
 
+    // 顺序执行到下一个块，但不会流入另一个函数
+    auto fall_through = [&](size_t i)
+    {
+        if (i + 1 < basic_blocks.size() && !is_func_entry(basic_blocks[i + 1]))
+        {
+            auto next_block = basic_blocks[i + 1];
+            basic_blocks[i]->successors.push_back(next_block);
+            next_block->predecessors.push_back(basic_blocks[i]);
+        }
+    };
+
     // 为每个基础块建立前驱和后继关系
     for (size_t i = 0; i < basic_blocks.size(); ++i)
     {
@@ -148,12 +167,7 @@ void BlockBuilder::build_cfg()
             }
 
             // 2. 顺序执行的下一个基础块（fallthrough）
-            if (i + 1 < basic_blocks.size())
-            {
-                auto next_block = basic_blocks[i + 1];
-                block->successors.push_back(next_block);
-                next_block->predecessors.push_back(block);
-            }
+            fall_through(i);
             break;
         }
 
@@ -165,40 +179,275 @@ void BlockBuilder::build_cfg()
         case TAC_OP::LABEL:
             // 如果基础块只有一个LABEL指令，它会顺序执行到下一个块
             // （这通常不应该发生，但为了健壮性处理）
-            if (block->start == block->end && i + 1 < basic_blocks.size())
+            if (block->start == block->end)
             {
-                auto next_block = basic_blocks[i + 1];
-                block->successors.push_back(next_block);
-                next_block->predecessors.push_back(block);
+                fall_through(i);
             }
             break;
 
         default:
             // 其他指令：顺序执行到下一个基础块
-            if (i + 1 < basic_blocks.size())
+            fall_through(i);
+            break;
+        }
+    }
+}
+
+// 按 label f; begin ... end 把基本块划分到各个函数
+void BlockBuilder::build_functions()
+{
+    functions.clear();
+    functions.emplace_back();  // 第一个函数之前的全局代码
+
+    for (auto &block : basic_blocks)
+    {
+        if (is_func_entry(block))
+        {
+            functions.emplace_back();
+            functions.back().name = block->start->a->name;
+        }
+        functions.back().blocks.push_back(block);
+
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::FORMAL)
+                functions.back().formals.push_back(tac->a);
+            if (tac == block->end)
+                break;
+        }
+    }
+
+    if (functions.front().blocks.empty())
+    {
+        functions.erase(functions.begin());
+    }
+}
+
+void BlockBuilder::collect_memory_vars()
+{
+    global_vars.clear();
+    addr_taken_vars.clear();
+
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        for (auto sym : {tac->a, tac->b, tac->c})
+        {
+            if (sym && sym->type == SYM_TYPE::VAR && sym->scope == SYM_SCOPE::GLOBAL)
+                global_vars.insert(sym);
+        }
+        if (tac->op == TAC_OP::ADDR && tac->b)
+        {
+            addr_taken_vars.insert(tac->b);
+        }
+    }
+
+    compute_points_to();
+}
+
+// 流不敏感、上下文不敏感的 Andersen 指针分析。取过地址的变量就是内存对象，
+// 一个变量的指向集合同时表示它的值和它的内存里存着的指针能指向哪些对象；
+// 加减法保留指针指向的对象，数组和结构体不区分元素和字段，不考虑整数强转成指针
+void BlockBuilder::compute_points_to()
+{
+    points_to.clear();
+    escaped_vars.clear();
+
+    // 约束：copy 为 dst ⊇ src，load 为 dst ⊇ *src，store 为 *dst ⊇ src
+    using Edge = std::pair<std::shared_ptr<SYM>, std::shared_ptr<SYM>>;
+    std::vector<Edge> copies, loads, stores;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<SYM>>> formals, returns;
+    std::vector<std::pair<std::string, std::shared_ptr<TAC>>> calls;
+    std::vector<std::shared_ptr<SYM>> roots;  // 传给调用的实参
+    std::string func;
+
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        for (auto sym : {tac->a, tac->b, tac->c})
+        {
+            if (sym && sym->type == SYM_TYPE::VAR)
+                points_to[sym];
+        }
+
+        switch (tac->op)
+        {
+        case TAC_OP::BEGINFUNC:
+            func = tac->prev && tac->prev->op == TAC_OP::LABEL ? tac->prev->a->name : "";
+            break;
+        case TAC_OP::FORMAL:
+            formals[func].push_back(tac->a);
+            break;
+        case TAC_OP::ADDR:
+            points_to[tac->a].insert(tac->b);
+            break;
+        case TAC_OP::COPY:
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+            for (auto src : {tac->b, tac->c})
             {
-                auto next_block = basic_blocks[i + 1];
-                // 检查下一个块是否是新函数的开始（避免跨函数连接）
-                if (next_block->start && next_block->start->op == TAC_OP::LABEL)
-                {
-                    // 检查当前块的最后一条指令之后是否紧接着ENDFUNC
-                    auto check = end_instr->next;
-                    while (check && check != next_block->start)
-                    {
-                        if (check->op == TAC_OP::ENDFUNC)
-                        {
-                            // 有ENDFUNC，不连接
-                            return;
-                        }
-                        check = check->next;
-                    }
-                }
-                block->successors.push_back(next_block);
-                next_block->predecessors.push_back(block);
+                if (src && src->type == SYM_TYPE::VAR)
+                    copies.emplace_back(tac->a, src);
             }
             break;
+        case TAC_OP::LOAD_PTR:
+            loads.emplace_back(tac->a, tac->b);
+            break;
+        case TAC_OP::STORE_PTR:
+            if (tac->b->type == SYM_TYPE::VAR)
+                stores.emplace_back(tac->a, tac->b);
+            break;
+        case TAC_OP::ACTUAL:
+            if (tac->a->type == SYM_TYPE::VAR)
+                roots.push_back(tac->a);
+            break;
+        case TAC_OP::CALL:
+            calls.emplace_back(tac->b->name, tac);
+            break;
+        case TAC_OP::RETURN:
+            if (tac->a && tac->a->type == SYM_TYPE::VAR)
+                returns[func].push_back(tac->a);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 实参流向形参，返回值流向调用结果
+    for (auto& [callee, call] : calls)
+    {
+        const auto& params = formals[callee];
+        std::vector<std::shared_ptr<SYM>> args;
+        for (auto actual = call->prev; actual && actual->op == TAC_OP::ACTUAL; actual = actual->prev)
+            args.insert(args.begin(), actual->a);
+        for (size_t k = 0; k < args.size() && k < params.size(); k++)
+        {
+            if (args[k]->type == SYM_TYPE::VAR)
+                copies.emplace_back(params[k], args[k]);
+        }
+        if (call->a)
+        {
+            for (auto& ret : returns[callee])
+                copies.emplace_back(call->a, ret);
+        }
+    }
+
+    auto merge = [&](const std::shared_ptr<SYM>& dst, const std::shared_ptr<SYM>& src) {
+        if (dst == src)
+            return false;
+        bool grown = false;
+        auto& to = points_to[dst];
+        for (auto& obj : points_to[src])
+            grown |= to.insert(obj).second;
+        return grown;
+    };
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto& [dst, src] : copies)
+            changed |= merge(dst, src);
+        for (auto& [dst, src] : loads)
+        {
+            std::vector<std::shared_ptr<SYM>> objs(points_to[src].begin(), points_to[src].end());
+            for (auto& obj : objs)
+                changed |= merge(dst, obj);
+        }
+        for (auto& [dst, src] : stores)
+        {
+            std::vector<std::shared_ptr<SYM>> objs(points_to[dst].begin(), points_to[dst].end());
+            for (auto& obj : objs)
+                changed |= merge(obj, src);
         }
     }
+
+    // 被调函数能访问实参和全局变量可达的对象
+    roots.insert(roots.end(), global_vars.begin(), global_vars.end());
+    std::vector<std::shared_ptr<SYM>> worklist;
+    for (auto& root : roots)
+    {
+        for (auto& obj : points_to[root])
+        {
+            if (escaped_vars.insert(obj).second)
+                worklist.push_back(obj);
+        }
+    }
+    while (!worklist.empty())
+    {
+        auto obj = worklist.back();
+        worklist.pop_back();
+        for (auto& next : points_to[obj])
+        {
+            if (escaped_vars.insert(next).second)
+                worklist.push_back(next);
+        }
+    }
+}
+
+const std::unordered_set<std::shared_ptr<SYM>>& BlockBuilder::get_points_to(std::shared_ptr<SYM> ptr) const
+{
+    auto it = ptr ? points_to.find(ptr) : points_to.end();
+    return it != points_to.end() ? it->second : addr_taken_vars;
+}
+
+bool BlockBuilder::is_memory_var(std::shared_ptr<SYM> sym) const
+{
+    return global_vars.count(sym) || addr_taken_vars.count(sym);
+}
+
+bool BlockBuilder::is_clobbered(std::shared_ptr<TAC> tac, std::shared_ptr<SYM> sym) const
+{
+    if (tac->op == TAC_OP::CALL)
+        return global_vars.count(sym) || escaped_vars.count(sym);
+    if (tac->op == TAC_OP::STORE_PTR)
+        return get_points_to(tac->a).count(sym) > 0;
+    return false;
+}
+
+std::vector<std::shared_ptr<SYM>> BlockBuilder::get_clobbers(std::shared_ptr<TAC> tac) const
+{
+    std::vector<std::shared_ptr<SYM>> clobbers;
+    if (tac->op == TAC_OP::CALL)
+    {
+        clobbers.insert(clobbers.end(), global_vars.begin(), global_vars.end());
+        for (auto &sym : escaped_vars)
+        {
+            if (!global_vars.count(sym))
+                clobbers.push_back(sym);
+        }
+    }
+    if (tac->op == TAC_OP::STORE_PTR)
+    {
+        const auto& targets = get_points_to(tac->a);
+        clobbers.insert(clobbers.end(), targets.begin(), targets.end());
+    }
+    return clobbers;
+}
+
+std::vector<std::shared_ptr<SYM>> BlockBuilder::get_uses(std::shared_ptr<TAC> tac) const
+{
+    auto uses = tac->get_uses();
+
+    // 被调函数可以读全局变量和传出去的地址，指针可以读它指向的变量，
+    // 函数返回后调用者还能看到全局变量
+    switch (tac->op)
+    {
+    case TAC_OP::CALL:
+        uses.insert(uses.end(), global_vars.begin(), global_vars.end());
+        uses.insert(uses.end(), escaped_vars.begin(), escaped_vars.end());
+        break;
+    case TAC_OP::LOAD_PTR:
+    {
+        const auto& targets = get_points_to(tac->b);
+        uses.insert(uses.end(), targets.begin(), targets.end());
+        break;
+    }
+    case TAC_OP::RETURN:
+    case TAC_OP::ENDFUNC:
+        uses.insert(uses.end(), global_vars.begin(), global_vars.end());
+        break;
+    default:
+        break;
+    }
+    return uses;
 }
 
 void BlockBuilder::print_basic_blocks(std::ostream &os)
@@ -258,365 +507,652 @@ void BlockBuilder::print_basic_blocks(std::ostream &os)
     os << "==================================" << std::endl;
 }
 
-
-// 到达定值分析：计算每个基本块入口和出口的到达定值集合
-void BlockBuilder::compute_reaching_definitions()
+// 支配树：按函数以逆后序迭代求直接支配者（Cooper-Harvey-Kennedy）
+void BlockBuilder::compute_dominators()
 {
-    const auto& blocks=basic_blocks;
-    // 初始化
-    for (auto& block : blocks)
-    {
-        block_in[block].reaching_defs.clear();
-        block_out[block].reaching_defs.clear();
-    }
-    
-    // 收集所有变量的所有定值点
-    std::unordered_map<std::shared_ptr<SYM>, std::unordered_set<std::shared_ptr<TAC>>> all_defs;
-    for (auto& block : blocks)
+    idom.clear();
+    dom_children.clear();
+    dom_order.clear();
+    dom_frontier.clear();
+
+    int counter = 0;
+    for (auto &func : functions)
     {
-        auto tac = block->start;
-        while (tac)
+        if (func.blocks.empty())
+            continue;
+        auto entry = func.blocks.front();
+
+        // 后序遍历（非递归），只访问从入口可达的块
+        std::vector<std::shared_ptr<BasicBlock>> postorder;
+        std::unordered_set<std::shared_ptr<BasicBlock>> visited;
+        std::vector<std::pair<std::shared_ptr<BasicBlock>, size_t>> stack;
+        stack.push_back({entry, 0});
+        visited.insert(entry);
+        while (!stack.empty())
         {
-            auto def = tac->get_def();
-            if (def)
+            auto &[block, next] = stack.back();
+            if (next < block->successors.size())
             {
-                all_defs[def].insert(tac);
+                auto succ = block->successors[next++];
+                if (visited.insert(succ).second)
+                    stack.push_back({succ, 0});
+            }
+            else
+            {
+                postorder.push_back(block);
+                stack.pop_back();
             }
-            if (tac == block->end)
-                break;
-            tac = tac->next;
         }
-    }
-    
-    // 迭代求解不动点
-    bool changed = true;
-    while (changed)
-    {
-        changed = false;
-        
-        for (auto& block : blocks)
+
+        std::unordered_map<std::shared_ptr<BasicBlock>, int> po_num;
+        for (size_t i = 0; i < postorder.size(); ++i)
+            po_num[postorder[i]] = i;
+
+        auto intersect = [&](std::shared_ptr<BasicBlock> a, std::shared_ptr<BasicBlock> b)
         {
-            // IN[B] = ∪ OUT[P] for all predecessors P
-            std::unordered_map<std::shared_ptr<SYM>, std::unordered_set<std::shared_ptr<TAC>>> new_in;
-            for (auto& pred : block->predecessors)
+            while (a != b)
             {
-                for (auto& [var, defs] : block_out[pred].reaching_defs)
+                while (po_num[a] < po_num[b])
+                    a = idom[a];
+                while (po_num[b] < po_num[a])
+                    b = idom[b];
+            }
+            return a;
+        };
+
+        idom[entry] = entry;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto it = postorder.rbegin(); it != postorder.rend(); ++it)
+            {
+                auto block = *it;
+                if (block == entry)
+                    continue;
+
+                std::shared_ptr<BasicBlock> new_idom = nullptr;
+                for (auto &pred : block->predecessors)
                 {
-                    new_in[var].insert(defs.begin(), defs.end());
+                    if (!idom.count(pred))
+                        continue;
+                    new_idom = new_idom ? intersect(pred, new_idom) : pred;
+                }
+                if (new_idom && idom[block] != new_idom)
+                {
+                    idom[block] = new_idom;
+                    changed = true;
                 }
             }
-            
-            // 检查 IN 是否改变
-            if (new_in != block_in[block].reaching_defs)
+        }
+
+        for (auto it = postorder.rbegin(); it != postorder.rend(); ++it)
+        {
+            if (*it != entry)
+                dom_children[idom[*it]].push_back(*it);
+        }
+
+        // 支配树先序/后序编号：a 支配 b 当且仅当 b 的区间落在 a 的区间内
+        std::vector<std::pair<std::shared_ptr<BasicBlock>, size_t>> walk;
+        walk.push_back({entry, 0});
+        dom_order[entry].first = counter++;
+        while (!walk.empty())
+        {
+            auto &[block, next] = walk.back();
+            auto &children = dom_children[block];
+            if (next < children.size())
             {
-                block_in[block].reaching_defs = new_in;
-                changed = true;
+                auto child = children[next++];
+                dom_order[child].first = counter++;
+                walk.push_back({child, 0});
             }
-            
-            // OUT[B] = GEN[B] ∪ (IN[B] - KILL[B])
-            auto new_out = block_in[block].reaching_defs;
-            
-            // 遍历块中的指令，更新 OUT
-            auto tac = block->start;
-            while (tac)
+            else
             {
-                auto def = tac->get_def();
-                if (def)
-                {
-                    // KILL：删除该变量的所有其他定值
-                    new_out[def].clear();
-                    // GEN：添加当前定值
-                    new_out[def].insert(tac);
-                }
-                
-                if (tac == block->end)
-                    break;
-                tac = tac->next;
+                dom_order[block].second = counter++;
+                walk.pop_back();
             }
-            
-            // 检查 OUT 是否改变
-            if (new_out != block_out[block].reaching_defs)
+        }
+        idom[entry] = nullptr;
+
+        // 支配边界：汇合点沿每个前驱向上走到它的直接支配者为止
+        for (auto &block : postorder)
+        {
+            if (block->predecessors.size() < 2)
+                continue;
+            for (auto &pred : block->predecessors)
             {
-                block_out[block].reaching_defs = new_out;
-                changed = true;
+                if (!idom.count(pred))
+                    continue;
+                for (auto runner = pred; runner && runner != idom[block]; runner = idom[runner])
+                {
+                    auto &frontier = dom_frontier[runner];
+                    if (frontier.empty() || frontier.back() != block)
+                        frontier.push_back(block);
+                }
             }
         }
     }
 }
 
-// 活跃变量分析：计算每个基本块入口和出口的活跃变量集合
-void BlockBuilder::compute_live_variables()
+std::shared_ptr<BasicBlock> BlockBuilder::get_idom(std::shared_ptr<BasicBlock> block) const
+{
+    auto it = idom.find(block);
+    return it != idom.end() ? it->second : nullptr;
+}
+
+const BlockList &BlockBuilder::get_dom_children(std::shared_ptr<BasicBlock> block) const
+{
+    static const BlockList empty;
+    auto it = dom_children.find(block);
+    return it != dom_children.end() ? it->second : empty;
+}
+
+// 不可达块不被任何块支配，也不支配任何块
+bool BlockBuilder::dominates(std::shared_ptr<BasicBlock> a, std::shared_ptr<BasicBlock> b) const
 {
-    const auto& blocks=basic_blocks;
-    // 初始化
-    for (auto& block : blocks)
+    auto ia = dom_order.find(a), ib = dom_order.find(b);
+    if (ia == dom_order.end() || ib == dom_order.end())
+        return false;
+    return ia->second.first <= ib->second.first && ib->second.second <= ia->second.second;
+}
+
+const BlockList &BlockBuilder::get_dominance_frontier(std::shared_ptr<BasicBlock> block) const
+{
+    static const BlockList empty;
+    auto it = dom_frontier.find(block);
+    return it != dom_frontier.end() ? it->second : empty;
+}
+
+std::shared_ptr<Loop> BlockBuilder::get_loop(std::shared_ptr<BasicBlock> block) const
+{
+    auto it = innermost_loop.find(block);
+    return it != innermost_loop.end() ? it->second : nullptr;
+}
+
+// 自然循环：回边 t->h 满足 h 支配 t，同一个 header 的回边合并成一个循环
+void BlockBuilder::find_loops()
+{
+    loops.clear();
+    innermost_loop.clear();
+
+    std::unordered_map<std::shared_ptr<BasicBlock>, int> position;
+    for (size_t i = 0; i < basic_blocks.size(); ++i)
+        position[basic_blocks[i]] = i;
+
+    for (auto &header : basic_blocks)
     {
-        block_in[block].live_vars.clear();
-        block_out[block].live_vars.clear();
+        std::vector<std::shared_ptr<BasicBlock>> latches;
+        for (auto &pred : header->predecessors)
+        {
+            if (dominates(header, pred))
+                latches.push_back(pred);
+        }
+        if (latches.empty())
+            continue;
+
+        auto loop = std::make_shared<Loop>();
+        loop->header = header;
+        loop->latches = latches;
+        loop->block_set.insert(header);
+
+        // 从 latch 逆着前驱边找到 header 为止
+        std::vector<std::shared_ptr<BasicBlock>> worklist;
+        for (auto &latch : latches)
+        {
+            if (loop->block_set.insert(latch).second)
+                worklist.push_back(latch);
+        }
+        while (!worklist.empty())
+        {
+            auto block = worklist.back();
+            worklist.pop_back();
+            for (auto &pred : block->predecessors)
+            {
+                if (dominates(header, pred) && loop->block_set.insert(pred).second)
+                    worklist.push_back(pred);
+            }
+        }
+
+        loop->blocks.assign(loop->block_set.begin(), loop->block_set.end());
+        std::sort(loop->blocks.begin(), loop->blocks.end(),
+                  [&](auto &a, auto &b) { return position[a] < position[b]; });
+
+        std::unordered_set<std::shared_ptr<BasicBlock>> exit_set;
+        for (auto &block : loop->blocks)
+        {
+            for (auto &succ : block->successors)
+            {
+                if (!loop->contains(succ) && exit_set.insert(succ).second)
+                    loop->exits.push_back(succ);
+            }
+        }
+
+        // 预头：唯一的循环外前驱，只有 header 一个后继
+        std::vector<std::shared_ptr<BasicBlock>> outside;
+        for (auto &pred : header->predecessors)
+        {
+            if (!loop->contains(pred))
+                outside.push_back(pred);
+        }
+        if (outside.size() == 1 && outside[0]->successors.size() == 1 &&
+            outside[0]->end->op != TAC_OP::IFZ)
+        {
+            loop->preheader = outside[0];
+        }
+
+        loops.push_back(loop);
     }
-    
-    // 迭代求解不动点（逆向数据流）
-    bool changed = true;
-    while (changed)
+
+    // 块少的循环先处理，这样内层循环一定排在外层循环之前
+    std::stable_sort(loops.begin(), loops.end(),
+                     [](auto &a, auto &b) { return a->blocks.size() < b->blocks.size(); });
+
+    // 外层循环是包含 header 的最小的另一个循环
+    for (size_t i = 0; i < loops.size(); ++i)
     {
-        changed = false;
-        
-        // 逆序遍历基本块
-        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it)
-        {
-            auto& block = *it;
-            
-            // OUT[B] = ∪ IN[S] for all successors S
-            std::unordered_set<std::shared_ptr<SYM>> new_out;
-            for (auto& succ : block->successors)
+        for (size_t j = i + 1; j < loops.size(); ++j)
+        {
+            if (loops[j]->contains(loops[i]->header))
             {
-                new_out.insert(block_in[succ].live_vars.begin(), 
-                              block_in[succ].live_vars.end());
+                loops[i]->parent = loops[j];
+                loops[j]->children.push_back(loops[i]);
+                break;
             }
-            
-            if (new_out != block_out[block].live_vars)
+        }
+    }
+    for (auto it = loops.rbegin(); it != loops.rend(); ++it)
+    {
+        auto &loop = *it;
+        loop->depth = loop->parent ? loop->parent->depth + 1 : 1;
+    }
+
+    for (auto &loop : loops)
+    {
+        for (auto &block : loop->blocks)
+        {
+            if (!innermost_loop.count(block))
+                innermost_loop[block] = loop;
+        }
+    }
+}
+
+// 为没有预头的循环在 header 前插入一个新标签，循环外的跳转改为跳到它
+bool BlockBuilder::insert_preheaders()
+{
+    int next_label = -1;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::LABEL && tac->a && tac->a->name.size() > 1 && tac->a->name[0] == 'L' &&
+            tac->a->name.find_first_not_of("0123456789", 1) == std::string::npos)
+        {
+            next_label = std::max(next_label, std::stoi(tac->a->name.substr(1)));
+        }
+        for (auto sym : {tac->a, tac->b, tac->c})
+        {
+            if (sym && sym->type == SYM_TYPE::TEXT)
+                next_label = std::max(next_label, sym->label);
+        }
+    }
+    next_label++;
+
+    std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> block_of_end;
+    for (auto &block : basic_blocks)
+        block_of_end[block->end] = block;
+
+    bool inserted = false;
+    for (auto &loop : loops)
+    {
+        auto header = loop->header;
+        if (loop->preheader || !header->start || header->start == tac_first ||
+            header->start->op != TAC_OP::LABEL || !header->start->prev)
+            continue;
+
+        auto header_label = header->start->a;
+        auto label = std::make_shared<SYM>();
+        label->type = SYM_TYPE::LABEL;
+        label->name = "L" + std::to_string(next_label++);
+        label->scope = header_label->scope;
+
+        for (auto &pred : header->predecessors)
+        {
+            if (loop->contains(pred))
+                continue;
+            auto end = pred->end;
+            if ((end->op == TAC_OP::GOTO || end->op == TAC_OP::IFZ) && end->a &&
+                end->a->name == header_label->name)
             {
-                block_out[block].live_vars = new_out;
-                changed = true;
+                end->a = label;
             }
-            
-            // IN[B] = USE[B] ∪ (OUT[B] - DEF[B])
-            auto new_in = block_out[block].live_vars;
-            
-            // 逆序遍历块中的指令
-            std::vector<std::shared_ptr<TAC>> instructions;
-            auto tac = block->start;
-            while (tac)
+        }
+
+        // 循环内顺序流入 header 的块需要补一条 goto，否则会经过预头
+        auto before = header->start->prev;
+        auto it = block_of_end.find(before);
+        if (it != block_of_end.end() && loop->contains(it->second) &&
+            before->op != TAC_OP::GOTO && before->op != TAC_OP::RETURN && before->op != TAC_OP::ENDFUNC)
+        {
+            auto jump = std::make_shared<TAC>(TAC_OP::GOTO);
+            jump->a = header_label;
+            jump->prev = before;
+            before->next = jump;
+            before = jump;
+        }
+
+        auto tac = std::make_shared<TAC>(TAC_OP::LABEL);
+        tac->a = label;
+        tac->prev = before;
+        tac->next = header->start;
+        before->next = tac;
+        header->start->prev = tac;
+        inserted = true;
+    }
+    return inserted;
+}
+
+void BlockBuilder::print_loops(std::ostream &os)
+{
+    os << "\n============= Loops ==============" << std::endl;
+    for (auto &loop : loops)
+    {
+        os << std::string(loop->depth * 2, ' ') << "Loop header " << loop->header->id
+           << " (depth " << loop->depth << ")";
+        os << " preheader: ";
+        if (loop->preheader)
+            os << loop->preheader->id;
+        else
+            os << "none";
+        os << " blocks:";
+        for (auto &block : loop->blocks)
+            os << " " << block->id;
+        os << std::endl;
+    }
+    os << "==================================" << std::endl;
+}
+
+
+// 为数据流分析编号：块下标、出现过的变量、每条定值指令，并求块的逆后序
+void BlockBuilder::number_data_flow()
+{
+    block_index.clear();
+    df_vars.clear();
+    var_index.clear();
+    def_tacs.clear();
+    def_index.clear();
+    rpo.clear();
+
+    auto number_var = [&](const std::shared_ptr<SYM> &sym)
+    {
+        if (sym && !var_index.count(sym))
+        {
+            var_index[sym] = df_vars.size();
+            df_vars.push_back(sym);
+        }
+    };
+
+    for (size_t i = 0; i < basic_blocks.size(); ++i)
+    {
+        auto &block = basic_blocks[i];
+        block_index[block] = i;
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            auto def = tac->get_def();
+            if (def)
             {
-                instructions.push_back(tac);
-                if (tac == block->end)
-                    break;
-                tac = tac->next;
+                number_var(def);
+                def_index[tac] = def_tacs.size();
+                def_tacs.push_back(tac);
             }
-            
-            for (auto it = instructions.rbegin(); it != instructions.rend(); ++it)
+            for (auto &use : tac->get_uses())
+                number_var(use);
+            if (tac == block->end)
+                break;
+        }
+    }
+    for (auto &var : global_vars)
+        number_var(var);
+    for (auto &var : addr_taken_vars)
+        number_var(var);
+
+    // 从每个函数入口做深度优先遍历，不可达的块排在最后
+    std::vector<char> visited(basic_blocks.size(), 0);
+    std::vector<int> postorder;
+    auto walk = [&](int root)
+    {
+        std::vector<std::pair<int, size_t>> stack;
+        stack.push_back({root, 0});
+        visited[root] = 1;
+        while (!stack.empty())
+        {
+            auto &[index, next] = stack.back();
+            auto &succs = basic_blocks[index]->successors;
+            if (next < succs.size())
             {
-                auto& instr = *it;
-                
-                // 移除定值变量
-                auto def = instr->get_def();
-                if (def)
-                {
-                    new_in.erase(def);
-                }
-                
-                // 添加使用的变量
-                auto uses = instr->get_uses();
-                for (auto& use : uses)
+                int succ = block_index[succs[next++]];
+                if (!visited[succ])
                 {
-                    new_in.insert(use);
+                    visited[succ] = 1;
+                    stack.push_back({succ, 0});
                 }
             }
-            
-            if (new_in != block_in[block].live_vars)
+            else
             {
-                block_in[block].live_vars = new_in;
-                changed = true;
+                postorder.push_back(index);
+                stack.pop_back();
             }
         }
+    };
+    for (auto &func : functions)
+    {
+        if (!func.blocks.empty() && !visited[block_index[func.blocks.front()]])
+            walk(block_index[func.blocks.front()]);
     }
+    for (size_t i = 0; i < basic_blocks.size(); ++i)
+    {
+        if (!visited[i])
+            walk(i);
+    }
+    rpo.assign(postorder.rbegin(), postorder.rend());
+}
+
+int BlockBuilder::get_block_index(std::shared_ptr<BasicBlock> block) const
+{
+    auto it = block_index.find(block);
+    return it != block_index.end() ? it->second : -1;
 }
 
-// 常量传播分析：确定每个点上哪些变量是常量
-void BlockBuilder::compute_constant_propagation()
+int BlockBuilder::get_var_index(std::shared_ptr<SYM> sym) const
 {
-    const auto& blocks=basic_blocks;
-    // 初始化：所有变量都是 TOP（未知）
-    for (auto& block : blocks)
-    {
-        block_in[block].constants.clear();
-        block_out[block].constants.clear();
-    }
-    
-    std::queue<std::shared_ptr<BasicBlock>> worklist;
-    std::unordered_set<std::shared_ptr<BasicBlock>> in_worklist;
-    
-    for (auto& block : blocks)
-    {
-        worklist.push(block);
-        in_worklist.insert(block);
-    }
-    
-    // 特殊值：用 INT_MIN 表示 BOTTOM（非常量）
-    const int BOTTOM = INT_MIN;
-    
+    auto it = var_index.find(sym);
+    return it != var_index.end() ? it->second : -1;
+}
+
+// 工作表按逆后序（逆向问题按后序）取块，只有 IN/OUT 变化时才把相邻块重新加入
+void BlockBuilder::solve_data_flow(const DataFlowProblem &problem,
+                                   std::vector<BitSet> &in, std::vector<BitSet> &out) const
+{
+    size_t n = basic_blocks.size();
+    size_t width = problem.boundary.size();
+
+    std::vector<int> order(rpo.begin(), rpo.end());
+    if (!problem.forward)
+        std::reverse(order.begin(), order.end());
+    std::vector<int> priority(n);
+    for (size_t k = 0; k < order.size(); ++k)
+        priority[order[k]] = k;
+
+    // 交集问题从全集开始逼近，并集问题从空集开始
+    BitSet initial(width);
+    if (!problem.meet_union)
+        initial.fill();
+    in.assign(n, initial);
+    out.assign(n, initial);
+
+    std::set<int> worklist;
+    for (size_t k = 0; k < order.size(); ++k)
+        worklist.insert(k);
+
+    BitSet result(width);
     while (!worklist.empty())
     {
-        auto block = worklist.front();
-        worklist.pop();
-        in_worklist.erase(block);
-        
-        // IN[B] = meet of OUT[P] for all predecessors P
-        std::unordered_map<std::shared_ptr<SYM>, int> new_in;
-        
-        bool first = true;
-        for (auto& pred : block->predecessors)
-        {
-            if (first)
+        int b = order[*worklist.begin()];
+        worklist.erase(worklist.begin());
+        auto &block = basic_blocks[b];
+
+        // 交汇：前向问题合并前驱的 OUT，逆向问题合并后继的 IN
+        const auto &edges = problem.forward ? block->predecessors : block->successors;
+        auto &meet = problem.forward ? in[b] : out[b];
+        if (edges.empty())
+        {
+            meet = problem.boundary;
+        }
+        else
+        {
+            bool first = true;
+            for (auto &edge : edges)
             {
-                new_in = block_out[pred].constants;
+                int e = block_index.at(edge);
+                const auto &value = problem.forward ? out[e] : in[e];
+                if (first)
+                    meet = value;
+                else if (problem.meet_union)
+                    meet.unite(value);
+                else
+                    meet.intersect(value);
                 first = false;
             }
-            else
-            {
-                // Meet 操作：如果所有前驱的值相同则保持，否则为 BOTTOM
-                std::unordered_set<std::shared_ptr<SYM>> all_vars;
-                for (auto& [var, _] : new_in)
-                    all_vars.insert(var);
-                for (auto& [var, _] : block_out[pred].constants)
-                    all_vars.insert(var);
-                
-                for (auto& var : all_vars)
-                {
-                    bool in_new = new_in.find(var) != new_in.end();
-                    bool in_pred = block_out[pred].constants.find(var) != block_out[pred].constants.end();
-                    
-                    if (in_new && in_pred)
-                    {
-                        if (new_in[var] != block_out[pred].constants[var])
-                        {
-                            new_in[var] = BOTTOM; // 不同的常量值
-                        }
-                    }
-                    else if (in_pred)
-                    {
-                        new_in[var] = block_out[pred].constants[var];
-                    }
-                    // 如果只在 new_in 中，保持不变
-                }
-            }
         }
-        
-        block_in[block].constants = new_in;
-        
-        // OUT[B] = transfer(IN[B])
-        auto new_out = new_in;
-        
-        auto tac = block->start;
-        while (tac)
+
+        // 传递：GEN ∪ (交汇值 - KILL)
+        result = meet;
+        result.subtract(problem.kill[b]);
+        result.unite(problem.gen[b]);
+
+        auto &target = problem.forward ? out[b] : in[b];
+        if (result != target)
         {
-            auto def = tac->get_def();
-            
-            if (def)
+            target = result;
+            const auto &next = problem.forward ? block->successors : block->predecessors;
+            for (auto &succ : next)
+                worklist.insert(priority[block_index.at(succ)]);
+        }
+    }
+}
+
+// 到达定值分析：计算每个基本块入口和出口的到达定值集合
+void BlockBuilder::compute_reaching_definitions()
+{
+    size_t n = basic_blocks.size();
+    size_t width = def_tacs.size();
+
+    // 每个变量的全部定值，用于 KILL
+    std::vector<BitSet> defs_of_var(df_vars.size(), BitSet(width));
+    for (size_t i = 0; i < def_tacs.size(); ++i)
+        defs_of_var[var_index.at(def_tacs[i]->get_def())].set(i);
+
+    DataFlowProblem problem;
+    problem.forward = true;
+    problem.meet_union = true;
+    problem.gen.assign(n, BitSet(width));
+    problem.kill.assign(n, BitSet(width));
+    problem.boundary = BitSet(width);
+
+    for (size_t b = 0; b < n; ++b)
+    {
+        auto &block = basic_blocks[b];
+        auto &gen = problem.gen[b];
+        auto &kill = problem.kill[b];
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            auto it = def_index.find(tac);
+            if (it != def_index.end())
             {
-                // 尝试计算定值的常量值
-                int result = BOTTOM;
-                bool is_const = false;
-                
-                if (tac->op == TAC_OP::COPY)
-                {
-                    int val;
-                    if (tac->b->get_const_value(val))
-                    {
-                        result = val;
-                        is_const = true;
-                    }
-                    else if (tac->b && tac->b->type == SYM_TYPE::VAR)
-                    {
-                        auto it = new_out.find(tac->b);
-                        if (it != new_out.end() && it->second != BOTTOM)
-                        {
-                            result = it->second;
-                            is_const = true;
-                        }
-                    }
-                }
-                else if (tac->op == TAC_OP::ADD || tac->op == TAC_OP::SUB ||
-                         tac->op == TAC_OP::MUL || tac->op == TAC_OP::DIV)
-                {
-                    int val_b, val_c;
-                    bool has_b = false, has_c = false;
-                    
-                    if (tac->b->get_const_value(val_b))
-                    {
-                        has_b = true;
-                    }
-                    else if (tac->b && tac->b->type == SYM_TYPE::VAR)
-                    {
-                        auto it = new_out.find(tac->b);
-                        if (it != new_out.end() && it->second != BOTTOM)
-                        {
-                            val_b = it->second;
-                            has_b = true;
-                        }
-                    }
-                    
-                    if (tac->c->get_const_value(val_c))
-                    {
-                        has_c = true;
-                    }
-                    else if (tac->c && tac->c->type == SYM_TYPE::VAR)
-                    {
-                        auto it = new_out.find(tac->c);
-                        if (it != new_out.end() && it->second != BOTTOM)
-                        {
-                            val_c = it->second;
-                            has_c = true;
-                        }
-                    }
-                    
-                    if (has_b && has_c)
-                    {
-                        switch (tac->op)
-                        {
-                        case TAC_OP::ADD:
-                            result = val_b + val_c;
-                            is_const = true;
-                            break;
-                        case TAC_OP::SUB:
-                            result = val_b - val_c;
-                            is_const = true;
-                            break;
-                        case TAC_OP::MUL:
-                            result = val_b * val_c;
-                            is_const = true;
-                            break;
-                        case TAC_OP::DIV:
-                            if (val_c != 0)
-                            {
-                                result = val_b / val_c;
-                                is_const = true;
-                            }
-                            break;
-                        default:
-                            break;
-                        }
-                    }
-                }
-                
-                if (is_const)
-                {
-                    new_out[def] = result;
-                }
-                else
-                {
-                    new_out[def] = BOTTOM; // 非常量
-                }
+                // 后面的定值覆盖同一变量前面的定值
+                auto &all = defs_of_var[var_index.at(tac->get_def())];
+                gen.subtract(all);
+                kill.unite(all);
+                gen.set(it->second);
             }
-            
             if (tac == block->end)
                 break;
-            tac = tac->next;
         }
-        
-        // 如果 OUT 改变，将后继加入工作列表
-        if (new_out != block_out[block].constants)
+    }
+
+    std::vector<BitSet> in, out;
+    solve_data_flow(problem, in, out);
+    for (size_t b = 0; b < n; ++b)
+    {
+        block_in[basic_blocks[b]].reaching_defs = std::move(in[b]);
+        block_out[basic_blocks[b]].reaching_defs = std::move(out[b]);
+    }
+}
+
+std::vector<std::shared_ptr<TAC>> BlockBuilder::get_reaching_defs(std::shared_ptr<BasicBlock> block,
+                                                                  std::shared_ptr<SYM> var) const
+{
+    std::vector<std::shared_ptr<TAC>> defs;
+    auto it = block_in.find(block);
+    if (it == block_in.end())
+        return defs;
+    it->second.reaching_defs.for_each([&](size_t i)
+    {
+        if (def_tacs[i]->get_def() == var)
+            defs.push_back(def_tacs[i]);
+    });
+    return defs;
+}
+
+// 活跃变量分析：计算每个基本块入口和出口的活跃变量集合
+void BlockBuilder::compute_live_variables()
+{
+    size_t n = basic_blocks.size();
+    size_t width = df_vars.size();
+
+    // 逆向问题：GEN 为向上暴露的使用，KILL 为块内的定值
+    DataFlowProblem problem;
+    problem.forward = false;
+    problem.meet_union = true;
+    problem.gen.assign(n, BitSet(width));
+    problem.kill.assign(n, BitSet(width));
+    problem.boundary = BitSet(width);
+
+    for (size_t b = 0; b < n; ++b)
+    {
+        auto &block = basic_blocks[b];
+        std::vector<std::shared_ptr<TAC>> instructions;
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            instructions.push_back(tac);
+            if (tac == block->end)
+                break;
+        }
+
+        auto &gen = problem.gen[b];
+        auto &kill = problem.kill[b];
+        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it)
         {
-            block_out[block].constants = new_out;
-            
-            for (auto& succ : block->successors)
+            auto def = (*it)->get_def();
+            if (def)
             {
-                if (in_worklist.find(succ) == in_worklist.end())
-                {
-                    worklist.push(succ);
-                    in_worklist.insert(succ);
-                }
+                gen.reset(var_index.at(def));
+                kill.set(var_index.at(def));
             }
+            for (auto &use : get_uses(*it))
+                gen.set(var_index.at(use));
         }
     }
-}
\ No newline at end of file
+
+    std::vector<BitSet> in, out;
+    solve_data_flow(problem, in, out);
+
+    auto expand = [&](const BitSet &bits)
+    {
+        std::unordered_set<std::shared_ptr<SYM>> vars;
+        bits.for_each([&](size_t i) { vars.insert(df_vars[i]); });
+        return vars;
+    };
+    for (size_t b = 0; b < n; ++b)
+    {
+        block_in[basic_blocks[b]].live_vars = expand(in[b]);
+        block_out[basic_blocks[b]].live_vars = expand(out[b]);
+    }
+}
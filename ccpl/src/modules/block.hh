@@ -14,20 +14,55 @@ namespace twlm::ccpl::modules
     private:
         std::shared_ptr<TAC> tac_first;
         BlockList basic_blocks;
+        std::vector<FunctionCFG> functions;
+        std::unordered_map<std::string, std::shared_ptr<BasicBlock>> label_blocks;
+
+        // 调用和指针访问可能读写的变量
+        std::unordered_set<std::shared_ptr<SYM>> global_vars;
+        std::unordered_set<std::shared_ptr<SYM>> addr_taken_vars;
+        // 指针分析：每个变量可能指向的取过地址的变量，以及调用可能访问到的那些
+        std::unordered_map<std::shared_ptr<SYM>, std::unordered_set<std::shared_ptr<SYM>>> points_to;
+        std::unordered_set<std::shared_ptr<SYM>> escaped_vars;
+
+        // 支配树：直接支配者、子节点，以及先序/后序编号（用于 O(1) 判断支配关系）
+        std::unordered_map<std::shared_ptr<BasicBlock>, std::shared_ptr<BasicBlock>> idom;
+        std::unordered_map<std::shared_ptr<BasicBlock>, BlockList> dom_children;
+        std::unordered_map<std::shared_ptr<BasicBlock>, std::pair<int, int>> dom_order;
+        std::unordered_map<std::shared_ptr<BasicBlock>, BlockList> dom_frontier;
+
+        // 循环森林：内层循环排在外层循环之前
+        std::vector<std::shared_ptr<Loop>> loops;
+        std::unordered_map<std::shared_ptr<BasicBlock>, std::shared_ptr<Loop>> innermost_loop;
 
         // 数据流分析结果：每个基本块的入口和出口
         std::unordered_map<std::shared_ptr<BasicBlock>, DataFlowInfo> block_in;
         std::unordered_map<std::shared_ptr<BasicBlock>, DataFlowInfo> block_out;
 
+        // 数据流分析的稠密编号：块下标、变量、定值指令，以及块的逆后序
+        std::unordered_map<std::shared_ptr<BasicBlock>, int> block_index;
+        std::vector<std::shared_ptr<SYM>> df_vars;
+        std::unordered_map<std::shared_ptr<SYM>, int> var_index;
+        std::vector<std::shared_ptr<TAC>> def_tacs;
+        std::unordered_map<std::shared_ptr<TAC>, int> def_index;
+        std::vector<int> rpo;
+
         void build_basic_blocks();
         void build_cfg();
+        void build_functions();
+        void collect_memory_vars();
+        void compute_points_to();
         bool is_leader(std::shared_ptr<TAC> tac, std::shared_ptr<TAC> prev);
+        bool is_func_entry(std::shared_ptr<BasicBlock> block) const;
         std::shared_ptr<BasicBlock> find_block_by_label(std::shared_ptr<SYM> label);
 
+        // 循环
+        void find_loops();
+        bool insert_preheaders();
+
         // 数据流分析
+        void number_data_flow();
         void compute_reaching_definitions();
         void compute_live_variables();
-        void compute_constant_propagation();
 
     public:
         BlockBuilder(std::shared_ptr<TAC> first)
@@ -35,15 +70,63 @@ namespace twlm::ccpl::modules
         void build(){
             build_basic_blocks();
             build_cfg();
+            build_functions();
+            collect_memory_vars();
+            idom.clear();
+            loops.clear();
+            innermost_loop.clear();
+        }
+        // 计算支配树和循环森林，缺少预头的循环会插入一个（此时重建基本块）
+        void build_loops(){
+            compute_dominators();
+            find_loops();
+            if (insert_preheaders())
+            {
+                build();
+                compute_dominators();
+                find_loops();
+            }
         }
         void compute_data_flow(){
+            collect_memory_vars();
+            number_data_flow();
             compute_reaching_definitions();
             compute_live_variables();
-            compute_constant_propagation();
         }
+        // 支配树和支配边界
+        void compute_dominators();
         BlockList get_basic_blocks() const { return basic_blocks; }
+        const std::vector<FunctionCFG>& get_functions() const { return functions; }
+
+        std::shared_ptr<BasicBlock> get_idom(std::shared_ptr<BasicBlock> block) const;
+        const BlockList& get_dom_children(std::shared_ptr<BasicBlock> block) const;
+        const BlockList& get_dominance_frontier(std::shared_ptr<BasicBlock> block) const;
+        bool dominates(std::shared_ptr<BasicBlock> a, std::shared_ptr<BasicBlock> b) const;
+        const std::vector<std::shared_ptr<Loop>>& get_loops() const { return loops; }
+        std::shared_ptr<Loop> get_loop(std::shared_ptr<BasicBlock> block) const;
+
+        // 函数调用破坏全局变量和逃逸的变量，指针写只破坏指针可能指向的变量
+        bool is_memory_var(std::shared_ptr<SYM> sym) const;
+        // 分析之后才出现的指针按可能指向任何取过地址的变量处理
+        const std::unordered_set<std::shared_ptr<SYM>>& get_points_to(std::shared_ptr<SYM> ptr) const;
+        bool is_clobbered(std::shared_ptr<TAC> tac, std::shared_ptr<SYM> sym) const;
+        bool is_escaped(std::shared_ptr<SYM> sym) const { return escaped_vars.count(sym) > 0; }
+        std::vector<std::shared_ptr<SYM>> get_clobbers(std::shared_ptr<TAC> tac) const;
+        // 显式使用，加上调用、指针读和函数出口隐含的使用
+        std::vector<std::shared_ptr<SYM>> get_uses(std::shared_ptr<TAC> tac) const;
         const auto& get_block_in() const { return block_in; }
         const auto& get_block_out() const { return block_out; }
+
+        // 按逆后序（逆向问题按后序）用工作表求解位向量数据流问题，in/out 按块下标
+        void solve_data_flow(const DataFlowProblem& problem,
+                             std::vector<BitSet>& in, std::vector<BitSet>& out) const;
+        int get_block_index(std::shared_ptr<BasicBlock> block) const;
+        int get_var_index(std::shared_ptr<SYM> sym) const;
+        const std::vector<std::shared_ptr<SYM>>& get_data_flow_vars() const { return df_vars; }
+        const std::vector<std::shared_ptr<TAC>>& get_def_tacs() const { return def_tacs; }
+        std::vector<std::shared_ptr<TAC>> get_reaching_defs(std::shared_ptr<BasicBlock> block,
+                                                            std::shared_ptr<SYM> var) const;
         void print_basic_blocks(std::ostream &os = std::cout);
+        void print_loops(std::ostream &os = std::cout);
     };
 }
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "interp.hh"
+#include <algorithm>
+#include <climits>
+using namespace twlm::ccpl::modules;
+
+namespace
+{
+    const int MAX_DEPTH = 200;   // 递归深度上限，编译器自己的栈也有限
+
+    // VM 上的整数运算按 32 位回绕
+    int wrap(long long value)
+    {
+        return static_cast<int>(static_cast<unsigned int>(value));
+    }
+
+    int width_of(const std::shared_ptr<SYM> &sym)
+    {
+        return sym->data_type == DATA_TYPE::CHAR ? 1 : 4;
+    }
+}
+
+TACInterpreter::TACInterpreter(std::shared_ptr<TAC> first, int step_budget) : budget(step_budget)
+{
+    for (auto tac = first; tac; tac = tac->next)
+    {
+        if (tac->op != TAC_OP::BEGINFUNC || !tac->prev || tac->prev->op != TAC_OP::LABEL)
+            continue;
+        auto &func = functions[tac->prev->a->name];
+        func.begin = tac;
+        for (tac = tac->next; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::FORMAL)
+                func.formals.push_back(tac->a);
+            else if (tac->op == TAC_OP::LABEL)
+                func.labels[tac->a->name] = tac;
+        }
+        if (!tac)
+            break;
+    }
+}
+
+bool TACInterpreter::evaluate(const std::string &name, const std::vector<int> &args, int &result)
+{
+    objects.clear();
+    steps = 0;
+    std::vector<Value> values;
+    for (int arg : args)
+        values.push_back({arg, -1});
+    Value value;
+    if (!call(name, values, &value, 0) || value.object >= 0)
+        return false;
+    result = value.number;
+    return true;
+}
+
+// 变量第一次被访问时在当前栈帧里分配对象，全局变量不属于任何栈帧
+int TACInterpreter::object_of(Frame &frame, std::shared_ptr<SYM> var)
+{
+    if (var->type != SYM_TYPE::VAR || var->scope == SYM_SCOPE::GLOBAL)
+        return -1;
+    auto it = frame.find(var);
+    if (it != frame.end())
+        return it->second;
+    objects.push_back({var->get_size(), {}});
+    return frame[var] = static_cast<int>(objects.size()) - 1;
+}
+
+bool TACInterpreter::read(Frame &frame, std::shared_ptr<SYM> sym, Value &value)
+{
+    int constant;
+    if (sym->get_const_value(constant))
+    {
+        value = {constant, -1};
+        return true;
+    }
+    if (sym->is_array || sym->data_type == DATA_TYPE::STRUCT)
+        return false;
+    int object = object_of(frame, sym);
+    return object >= 0 && load({0, object}, width_of(sym), value);
+}
+
+bool TACInterpreter::write(Frame &frame, std::shared_ptr<SYM> var, Value value)
+{
+    if (var->is_array || var->data_type == DATA_TYPE::STRUCT)
+        return false;
+    int object = object_of(frame, var);
+    return object >= 0 && store({0, object}, width_of(var), value);
+}
+
+// 只能按写入时的宽度读回同一位置的值
+bool TACInterpreter::load(Value address, int width, Value &value) const
+{
+    if (address.object < 0)
+        return false;
+    const auto &cells = objects[address.object].cells;
+    auto it = cells.find(address.number);
+    if (it == cells.end() || it->second.width != width)
+        return false;
+    value = it->second.value;
+    return true;
+}
+
+bool TACInterpreter::store(Value address, int width, Value value)
+{
+    if (address.object < 0)
+        return false;
+    auto &object = objects[address.object];
+    int offset = address.number;
+    if (offset < 0 || offset + width > object.size)
+        return false;
+    // 字符只保存 VM 上不受符号扩展影响的值，指针不能截断
+    if (width == 1 && (value.object >= 0 || value.number < 0 || value.number > 127))
+        return false;
+
+    // 覆盖掉和新值重叠的旧值
+    auto it = object.cells.lower_bound(offset - 3);
+    while (it != object.cells.end() && it->first < offset + width)
+    {
+        if (it->first + it->second.width > offset)
+            it = object.cells.erase(it);
+        else
+            ++it;
+    }
+    object.cells[offset] = {value, width};
+    return true;
+}
+
+bool TACInterpreter::call(const std::string &name, const std::vector<Value> &args, Value *result, int depth)
+{
+    auto it = functions.find(name);
+    if (it == functions.end() || depth > MAX_DEPTH || args.size() != it->second.formals.size())
+        return false;
+    const auto &func = it->second;
+
+    Frame frame;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (!write(frame, func.formals[i], args[i]))
+            return false;
+    }
+
+    std::vector<Value> actuals;
+    for (auto tac = func.begin->next; tac; tac = tac->next)
+    {
+        if (++steps > budget)
+            return false;
+
+        Value x, y, value;
+        switch (tac->op)
+        {
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+            if (!read(frame, tac->b, x) || !read(frame, tac->c, y))
+                return false;
+            if (tac->op == TAC_OP::SUB)
+            {
+                // 同一对象内的两个指针相减得到字节差
+                if (x.object >= 0 && x.object == y.object)
+                    value = {wrap(static_cast<long long>(x.number) - y.number), -1};
+                else if (y.object < 0)
+                    value = {wrap(static_cast<long long>(x.number) - y.number), x.object};
+                else
+                    return false;
+            }
+            else
+            {
+                if (x.object >= 0 && y.object >= 0)
+                    return false;
+                value = {wrap(static_cast<long long>(x.number) + y.number), std::max(x.object, y.object)};
+            }
+            if (!write(frame, tac->a, value))
+                return false;
+            break;
+
+        case TAC_OP::MUL:
+        case TAC_OP::DIV:
+            if (!read(frame, tac->b, x) || !read(frame, tac->c, y) || x.object >= 0 || y.object >= 0)
+                return false;
+            if (tac->op == TAC_OP::MUL)
+                value.number = wrap(static_cast<long long>(x.number) * y.number);
+            else if (y.number == 0 || (x.number == INT_MIN && y.number == -1))
+                return false;
+            else
+                value.number = x.number / y.number;
+            if (!write(frame, tac->a, value))
+                return false;
+            break;
+
+        case TAC_OP::EQ:
+        case TAC_OP::NE:
+        case TAC_OP::LT:
+        case TAC_OP::LE:
+        case TAC_OP::GT:
+        case TAC_OP::GE:
+        {
+            // 指针只和同一对象内的指针比较
+            if (!read(frame, tac->b, x) || !read(frame, tac->c, y) || x.object != y.object)
+                return false;
+            bool holds = tac->op == TAC_OP::EQ ? x.number == y.number
+                       : tac->op == TAC_OP::NE ? x.number != y.number
+                       : tac->op == TAC_OP::LT ? x.number < y.number
+                       : tac->op == TAC_OP::LE ? x.number <= y.number
+                       : tac->op == TAC_OP::GT ? x.number > y.number
+                                               : x.number >= y.number;
+            if (!write(frame, tac->a, {holds ? 1 : 0, -1}))
+                return false;
+            break;
+        }
+
+        case TAC_OP::NEG:
+            if (!read(frame, tac->b, x) || x.object >= 0 || !write(frame, tac->a, {wrap(-static_cast<long long>(x.number)), -1}))
+                return false;
+            break;
+
+        case TAC_OP::COPY:
+            if (!read(frame, tac->b, x) || !write(frame, tac->a, x))
+                return false;
+            break;
+
+        case TAC_OP::ADDR:
+        {
+            int object = object_of(frame, tac->b);
+            if (object < 0 || !write(frame, tac->a, {0, object}))
+                return false;
+            break;
+        }
+
+        case TAC_OP::LOAD_PTR:
+            if (!read(frame, tac->b, x) || !load(x, width_of(tac->a), value) || !write(frame, tac->a, value))
+                return false;
+            break;
+
+        case TAC_OP::STORE_PTR:
+            if (!read(frame, tac->a, x) || !read(frame, tac->b, y) || !store(x, width_of(tac->b), y))
+                return false;
+            break;
+
+        case TAC_OP::GOTO:
+        case TAC_OP::IFZ:
+        {
+            if (tac->op == TAC_OP::IFZ)
+            {
+                if (!read(frame, tac->b, x))
+                    return false;
+                if (x.object >= 0 || x.number != 0)
+                    break;
+            }
+            auto label = func.labels.find(tac->a->name);
+            if (label == func.labels.end())
+                return false;
+            tac = label->second;
+            break;
+        }
+
+        case TAC_OP::ACTUAL:
+            if (!read(frame, tac->a, x))
+                return false;
+            actuals.push_back(x);
+            break;
+
+        case TAC_OP::CALL:
+        {
+            auto args = std::move(actuals);
+            actuals.clear();
+            if (!call(tac->b->name, args, tac->a ? &value : nullptr, depth + 1))
+                return false;
+            if (tac->a && !write(frame, tac->a, value))
+                return false;
+            break;
+        }
+
+        case TAC_OP::RETURN:
+            if (!result)
+                return true;
+            return tac->a && read(frame, tac->a, *result);
+
+        case TAC_OP::ENDFUNC:
+            // 从末尾落出去没有返回值
+            return !result;
+
+        case TAC_OP::LABEL:
+        case TAC_OP::VAR:
+        case TAC_OP::FORMAL:
+            break;
+
+        default:
+            // 输入输出等有副作用的指令
+            return false;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "abstraction/tac_struct.hh"
+
+namespace twlm::ccpl::modules
+{
+    using namespace twlm::ccpl::abstraction;
+
+    // 编译期解释执行 TAC 函数，供优化器对实参全是常量的纯函数调用求值。
+    // 每次调用一个新的栈帧，局部变量、数组和结构体各是一个对象，指针是对象加字节偏移；
+    // 读到未初始化的值、访问全局变量或越过对象边界、除零、输入输出、超出步数预算时放弃求值
+    class TACInterpreter
+    {
+    private:
+        struct Value
+        {
+            int number = 0;
+            int object = -1;    // 不小于 0 时是指向该对象的指针，number 是字节偏移
+        };
+        struct Cell
+        {
+            Value value;
+            int width;
+        };
+        struct Object
+        {
+            int size;
+            std::map<int, Cell> cells;  // 按字节偏移存放写入过的值
+        };
+        struct Function
+        {
+            std::shared_ptr<TAC> begin;
+            std::vector<std::shared_ptr<SYM>> formals;
+            std::unordered_map<std::string, std::shared_ptr<TAC>> labels;
+        };
+        using Frame = std::unordered_map<std::shared_ptr<SYM>, int>;
+
+        std::unordered_map<std::string, Function> functions;
+        std::vector<Object> objects;
+        int budget;
+        int steps = 0;
+
+        int object_of(Frame &frame, std::shared_ptr<SYM> var);
+        bool read(Frame &frame, std::shared_ptr<SYM> sym, Value &value);
+        bool write(Frame &frame, std::shared_ptr<SYM> var, Value value);
+        bool load(Value address, int width, Value &value) const;
+        bool store(Value address, int width, Value value);
+        bool call(const std::string &name, const std::vector<Value> &args, Value *result, int depth);
+
+    public:
+        TACInterpreter(std::shared_ptr<TAC> first, int step_budget);
+
+        // 求值成功时返回 true 并写入返回值，否则不改动 result
+        bool evaluate(const std::string &name, const std::vector<int> &args, int &result);
+    };
+}
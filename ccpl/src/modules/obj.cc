@@ -1,28 +1,67 @@
 #include "obj.hh"
 #include <string>
 #include <memory>
-#include <sstream>
 #include <algorithm>
-#include <ctime>
-#include <cstdlib>
+#include <climits>
 #include <stdexcept>
+#include <unordered_set>
 
 using namespace twlm::ccpl::modules;
 using namespace twlm::ccpl::abstraction;
 
 ObjGenerator::ObjGenerator(std::ostream& out, TACGenerator& tac_generator)
-    : output(out), tac_gen(tac_generator), tos(0), tof(0), oof(0), oon(0),block_builder(tac_generator.get_tac_first())
+    : target(out), tac_gen(tac_generator), tos(0), tof(0), frame_touched(false), spill_next(R_GEN),block_builder(tac_generator.get_tac_first())
 {
     // Initialize register descriptors
     for (int i = 0; i < R_NUM; i++)
     {
         rdesc_clear(i);
+        reg_locked[i] = false;
     }
     // Build basic blocks and dataflow analysis
     block_builder.build();
     block_builder.compute_data_flow();
 }
 
+void ObjGenerator::emit(std::shared_ptr<MInst> inst)
+{
+    if (inst->kind == MINST_KIND::INSN)
+    {
+        for (auto& ref : next_refs)
+        {
+            for (auto& arg : ref->args)
+            {
+                if (arg.kind == MOPND_KIND::INSN && !arg.insn)
+                    arg.insn = inst;
+            }
+        }
+        next_refs.clear();
+    }
+    code.push_back(inst);
+}
+
+std::shared_ptr<MInst> ObjGenerator::emit(const std::string& op, std::vector<MOperand> args)
+{
+    auto inst = std::make_shared<MInst>(MINST_KIND::INSN, op, std::move(args));
+    emit(inst);
+    return inst;
+}
+
+void ObjGenerator::emit_label(const std::string& name)
+{
+    emit(std::make_shared<MInst>(MINST_KIND::LABEL, name));
+}
+
+void ObjGenerator::emit_comment(const std::string& text)
+{
+    emit(std::make_shared<MInst>(MINST_KIND::COMMENT, text));
+}
+
+void ObjGenerator::link_next(std::shared_ptr<MInst> inst)
+{
+    next_refs.push_back(inst);
+}
+
 void ObjGenerator::rdesc_clear(int r)
 {
     reg_desc[r].var = nullptr;
@@ -42,6 +81,10 @@ void ObjGenerator::rdesc_fill(int r, std::shared_ptr<SYM> s, RegState state)
 
     reg_desc[r].var = s;
     reg_desc[r].state = state;
+    if (r >= R_CALLEE_SAVED && r < R_IO)
+    {
+        callee_used[r] = true;
+    }
 }
 
 void ObjGenerator::asm_write_back(int r)
@@ -53,20 +96,14 @@ void ObjGenerator::asm_write_back(int r)
         if (var->scope == SYM_SCOPE::LOCAL)
         {
             // Local variable
-            if (var->offset >= 0)
-            {
-                output << "\tSTO (R" << R_BP << "+" << var->offset << "),R" << r << "\n";
-            }
-            else
-            {
-                output << "\tSTO (R" << R_BP << var->offset << "),R" << r << "\n";
-            }
+            emit("STO", {MOperand::mem(R_BP, var->offset), MOperand::reg(r)});
+            frame_touched = true;
         }
         else
         {
             // Global variable
-            output << "\tLOD R" << R_TP << ",STATIC\n";
-            output << "\tSTO (R" << R_TP << "+" << var->offset << "),R" << r << "\n";
+            emit("LOD", {MOperand::reg(R_TP), MOperand::label("STATIC")});
+            emit("STO", {MOperand::mem(R_TP, var->offset), MOperand::reg(r)});
         }
         
         reg_desc[r].state = RegState::UNMODIFIED;
@@ -81,6 +118,28 @@ void ObjGenerator::asm_write_back_all()
     }
 }
 
+bool ObjGenerator::needs_memory(std::shared_ptr<SYM> s) const
+{
+    // Globals and memory reachable through pointers must stay valid
+    return s->type == SYM_TYPE::VAR &&
+           (s->scope != SYM_SCOPE::LOCAL || addr_taken.count(s) ||
+            s->is_array || s->data_type == DATA_TYPE::STRUCT);
+}
+
+void ObjGenerator::asm_write_back_live()
+{
+    // Write back what is still needed after the current block boundary
+    auto live = live_at.find(cur_tac);
+    for (int r = R_GEN; r < R_NUM; r++)
+    {
+        auto var = reg_desc[r].var;
+        if (var == nullptr || reg_desc[r].state != RegState::MODIFIED)
+            continue;
+        if (live == live_at.end() || needs_memory(var) || live->second.count(var))
+            asm_write_back(r);
+    }
+}
+
 void ObjGenerator::asm_clear_all_regs()
 {
     for (int r = R_GEN; r < R_NUM; r++)
@@ -89,6 +148,50 @@ void ObjGenerator::asm_clear_all_regs()
     }
 }
 
+// An access through a pointer can only reach the variables the points-to
+// analysis allows; without a pointer, any variable that lives in memory.
+// Temporaries and locals whose address is never taken stay in registers
+bool ObjGenerator::may_access(std::shared_ptr<SYM> ptr, std::shared_ptr<SYM> s) const
+{
+    return ptr ? block_builder.get_points_to(ptr).count(s) > 0 : needs_memory(s);
+}
+
+void ObjGenerator::asm_write_back_memory(std::shared_ptr<SYM> ptr)
+{
+    for (int r = R_GEN; r < R_NUM; r++)
+    {
+        if (reg_desc[r].var && may_access(ptr, reg_desc[r].var))
+            asm_write_back(r);
+    }
+}
+
+void ObjGenerator::asm_clear_memory_regs(std::shared_ptr<SYM> ptr)
+{
+    for (int r = R_GEN; r < R_NUM; r++)
+    {
+        if (reg_desc[r].var && may_access(ptr, reg_desc[r].var))
+            rdesc_clear(r);
+    }
+}
+
+void ObjGenerator::asm_load_const(int r, int value)
+{
+    if (value >= 0)
+    {
+        emit("LOD", {MOperand::reg(r), MOperand::imm(value)});
+        return;
+    }
+
+    // The assembler has no negative literals, subtract from zero instead
+    emit("LOD", {MOperand::reg(r), MOperand::imm(0)});
+    if (value == INT_MIN)
+    {
+        emit("SUB", {MOperand::reg(r), MOperand::imm(INT_MAX)});
+        value++;
+    }
+    emit("SUB", {MOperand::reg(r), MOperand::imm(-value)});
+}
+
 void ObjGenerator::asm_load(int r, std::shared_ptr<SYM> s)
 {
     // Check if already in a register
@@ -97,7 +200,7 @@ void ObjGenerator::asm_load(int r, std::shared_ptr<SYM> s)
         if (reg_desc[i].var == s)
         {
             // Load from the register
-            output << "\tLOD R" << r << ",R" << i << "\n";
+            emit("LOD", {MOperand::reg(r), MOperand::reg(i)});
             return;
         }
     }
@@ -108,14 +211,14 @@ void ObjGenerator::asm_load(int r, std::shared_ptr<SYM> s)
     case SYM_TYPE::CONST_INT:
         if (std::holds_alternative<int>(s->value))
         {
-            output << "\tLOD R" << r << "," << std::get<int>(s->value) << "\n";
+            asm_load_const(r, std::get<int>(s->value));
         }
         break;
 
     case SYM_TYPE::CONST_CHAR:
         if (std::holds_alternative<char>(s->value))
         {
-            output << "\tLOD R" << r << "," << static_cast<int>(std::get<char>(s->value)) << "\n";
+            asm_load_const(r, static_cast<int>(std::get<char>(s->value)));
         }
         break;
 
@@ -123,25 +226,19 @@ void ObjGenerator::asm_load(int r, std::shared_ptr<SYM> s)
         if (s->scope == SYM_SCOPE::LOCAL)
         {
             // Local variable
-            if (s->offset >= 0)
-            {
-                output << "\tLOD R" << r << ",(R" << R_BP << "+" << s->offset << ")\n";
-            }
-            else
-            {
-                output << "\tLOD R" << r << ",(R" << R_BP << s->offset << ")\n";
-            }
+            emit("LOD", {MOperand::reg(r), MOperand::mem(R_BP, s->offset)});
+            frame_touched = true;
         }
         else
         {
             // Global variable
-            output << "\tLOD R" << R_TP << ",STATIC\n";
-            output << "\tLOD R" << r << ",(R" << R_TP << "+" << s->offset << ")\n";
+            emit("LOD", {MOperand::reg(R_TP), MOperand::label("STATIC")});
+            emit("LOD", {MOperand::reg(r), MOperand::mem(R_TP, s->offset)});
         }
         break;
 
     case SYM_TYPE::TEXT:
-        output << "\tLOD R" << r << ",L" << s->label << "\n";
+        emit("LOD", {MOperand::reg(r), MOperand::label("L" + std::to_string(s->label))});
         break;
 
     default:
@@ -153,22 +250,18 @@ void ObjGenerator::asm_load(int r, std::shared_ptr<SYM> s)
 int ObjGenerator::reg_alloc(std::shared_ptr<SYM> s)
 {
     // Check if already in a register
-    for (int r = R_GEN; r < R_NUM; r++)
+    int cached = find_reg(s);
+    if (cached != R_UNDEF)
     {
-        if (reg_desc[r].var == s)
-        {
-            if (reg_desc[r].state == RegState::MODIFIED)
-            {
-                asm_write_back(r);
-            }
-            return r;
-        }
+        return cached;
     }
 
+    const auto& order = alloc_order(s);
+
     // Find an empty register
-    for (int r = R_GEN; r < R_NUM; r++)
+    for (int r : order)
     {
-        if (reg_desc[r].var == nullptr)
+        if (reg_desc[r].var == nullptr && !reg_locked[r])
         {
             asm_load(r, s);
             rdesc_fill(r, s, RegState::UNMODIFIED);
@@ -177,9 +270,9 @@ int ObjGenerator::reg_alloc(std::shared_ptr<SYM> s)
     }
 
     // Find an unmodified register
-    for (int r = R_GEN; r < R_NUM; r++)
+    for (int r : order)
     {
-        if (reg_desc[r].state == RegState::UNMODIFIED)
+        if (reg_desc[r].state == RegState::UNMODIFIED && !reg_locked[r])
         {
             asm_load(r, s);
             rdesc_fill(r, s, RegState::UNMODIFIED);
@@ -187,53 +280,149 @@ int ObjGenerator::reg_alloc(std::shared_ptr<SYM> s)
         }
     }
 
-    // Pick a random register and spill it
-    std::srand(std::time(nullptr));
-    int random = (std::rand() % (R_NUM - R_GEN)) + R_GEN;
-    asm_write_back(random);
-    asm_load(random, s);
-    rdesc_fill(random, s, RegState::UNMODIFIED);
-    return random;
+    // Spill registers round-robin
+    int victim;
+    do
+    {
+        victim = spill_next;
+        spill_next = spill_next + 1 < R_IO ? spill_next + 1 : R_GEN;
+    } while (reg_locked[victim]);
+    asm_write_back(victim);
+    asm_load(victim, s);
+    rdesc_fill(victim, s, RegState::UNMODIFIED);
+    return victim;
 }
 
-int ObjGenerator::asm_bin(const std::string& op, std::shared_ptr<SYM> a,
-                           std::shared_ptr<SYM> b, std::shared_ptr<SYM> c)
+int ObjGenerator::find_reg(std::shared_ptr<SYM> s) const
 {
-    int reg_b = reg_alloc(b);
-    
-    // CRITICAL FIX: Mark reg_b as MODIFIED temporarily to prevent reg_alloc(c)
-    // from choosing this register and overwriting the value
-    auto original_state = reg_desc[reg_b].state;
-    reg_desc[reg_b].state = RegState::MODIFIED;
+    for (int r = R_GEN; r < R_NUM; r++)
+    {
+        if (reg_desc[r].var == s)
+        {
+            return r;
+        }
+    }
+    return R_UNDEF;
+}
 
-    if(c->type ==SYM_TYPE::CONST_INT || c->type == SYM_TYPE::CONST_CHAR){
-        // For immediate values, we can directly use them in the instruction
-        if (c->type == SYM_TYPE::CONST_INT)
+int ObjGenerator::reg_alloc_dest(std::shared_ptr<SYM> b, std::shared_ptr<SYM> a)
+{
+    // Get b into a register that the result a may overwrite
+    int r = find_reg(b);
+    if (r == R_UNDEF)
+    {
+        // Load b straight into a register suited to the result
+        r = reg_alloc_result(R_UNDEF, a);
+        asm_load(r, b);
+        return r;
+    }
+    if (b == a || dies(b))
+    {
+        return r;
+    }
+
+    // b stays live: keep it cached and compute in a copy
+    reg_locked[r] = true;
+    int r_new = R_UNDEF;
+    if (reg_desc[r].state == RegState::MODIFIED)
+    {
+        r_new = reg_alloc_result(R_UNDEF, a);
+    }
+    else
+    {
+        for (int i : alloc_order(a))
         {
-            output << "\t" << op << " R" << reg_b << "," << std::get<int>(c->value) << "\n";
+            if (reg_desc[i].var == nullptr && !reg_locked[i])
+            {
+                r_new = i;
+                break;
+            }
         }
-        else if (c->type == SYM_TYPE::CONST_CHAR)
+    }
+    reg_locked[r] = false;
+
+    if (r_new == R_UNDEF)
+    {
+        return r;
+    }
+    emit("LOD", {MOperand::reg(r_new), MOperand::reg(r)});
+    return r_new;
+}
+
+const std::array<int, R_ALLOC>& ObjGenerator::alloc_order(std::shared_ptr<SYM> s) const
+{
+    // Values live across a call prefer callee-saved registers
+    static const std::array<int, R_ALLOC> caller_first = {5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+    static const std::array<int, R_ALLOC> callee_first = {10, 11, 12, 13, 14, 5, 6, 7, 8, 9};
+    return s && call_crossing.count(s) && !needs_memory(s) ? callee_first : caller_first;
+}
+
+int ObjGenerator::reg_alloc_result(int avoid, std::shared_ptr<SYM> s)
+{
+    const auto& order = alloc_order(s);
+
+    // Find a free register for a result that is not loaded from memory
+    for (int i : order)
+    {
+        if (reg_desc[i].var == nullptr && !reg_locked[i])
+        {
+            return i;
+        }
+    }
+
+    // No free register, find an unmodified one
+    for (int i : order)
+    {
+        if (reg_desc[i].state == RegState::UNMODIFIED && i != avoid && !reg_locked[i])
+        {
+            rdesc_clear(i);
+            return i;
+        }
+    }
+
+    // All registers are modified, write back one that's not in use
+    for (int i : order)
+    {
+        if (i != avoid && !reg_locked[i])
         {
-            output << "\t" << op << " R" << reg_b << "," << static_cast<int>(std::get<char>(c->value)) << "\n";
+            asm_write_back(i);
+            rdesc_clear(i);
+            return i;
         }
+    }
+
+    error("No register available");
+    return R_UNDEF;
+}
+
+int ObjGenerator::asm_bin(const std::string& op, std::shared_ptr<SYM> a,
+                           std::shared_ptr<SYM> b, std::shared_ptr<SYM> c)
+{
+    int reg_b = reg_alloc_dest(b, a);
+
+    // The assembler only takes unsigned immediates, negative ones go through a register
+    int k;
+    if(c->get_const_value(k) && k >= 0){
+        // For immediate values, we can directly use them in the instruction
+        emit(op, {MOperand::reg(reg_b), MOperand::imm(k)});
         rdesc_fill(reg_b, a, RegState::MODIFIED);
         return reg_b;
     }
     
+    // Keep reg_alloc(c) from choosing reg_b and overwriting the value
+    reg_locked[reg_b] = true;
     int reg_c = reg_alloc(c);
-    
-    // Restore original state
-    reg_desc[reg_b].state = original_state;
+    reg_locked[reg_b] = false;
 
     // If they're the same register (same variable), we need to use a temporary
     if (reg_b == reg_c)
     {
         // Load c into a temporary register
-        output << "\tLOD R" << R_TP << ",R" << reg_c << "\n";
+        emit("LOD", {MOperand::reg(R_TP), MOperand::reg(reg_c)});
         reg_c = R_TP;
     }
 
-    output << "\t" << op << " R" << reg_b << ",R" << reg_c << "\n";
+    emit(op, {MOperand::reg(reg_b), MOperand::reg(reg_c)});
     rdesc_fill(reg_b, a, RegState::MODIFIED);
 
     return reg_b;
@@ -243,69 +432,34 @@ void ObjGenerator::asm_cmp(TAC_OP op, std::shared_ptr<SYM> a,
                            std::shared_ptr<SYM> b, std::shared_ptr<SYM> c)
 {
     int reg_b = asm_bin("SUB",a,b,c);
-    output << "\tTST R" << reg_b << "\n";
+    emit("TST", {MOperand::reg(reg_b)});
 
+    // Jump on the flag and the result when the jump is taken
+    std::string jump;
+    int taken;
     switch (op)
     {
-    case TAC_OP::EQ:  // ==
-        output << "\tLOD R3,R1+40\n";
-        output << "\tJEZ R3\n";
-        output << "\tLOD R" << reg_b << ",0\n";
-        output << "\tLOD R3,R1+24\n";
-        output << "\tJMP R3\n";
-        output << "\tLOD R" << reg_b << ",1\n";
-        break;
-
-    case TAC_OP::NE:  // !=
-        output << "\tLOD R3,R1+40\n";
-        output << "\tJEZ R3\n";
-        output << "\tLOD R" << reg_b << ",1\n";
-        output << "\tLOD R3,R1+24\n";
-        output << "\tJMP R3\n";
-        output << "\tLOD R" << reg_b << ",0\n";
-        break;
-
-    case TAC_OP::LT:  // <
-        output << "\tLOD R3,R1+40\n";
-        output << "\tJLZ R3\n";
-        output << "\tLOD R" << reg_b << ",0\n";
-        output << "\tLOD R3,R1+24\n";
-        output << "\tJMP R3\n";
-        output << "\tLOD R" << reg_b << ",1\n";
-        break;
-
-    case TAC_OP::LE:  // <=
-        output << "\tLOD R3,R1+40\n";
-        output << "\tJGZ R3\n";
-        output << "\tLOD R" << reg_b << ",1\n";
-        output << "\tLOD R3,R1+24\n";
-        output << "\tJMP R3\n";
-        output << "\tLOD R" << reg_b << ",0\n";
-        break;
-
-    case TAC_OP::GT:  // >
-        output << "\tLOD R3,R1+40\n";
-        output << "\tJGZ R3\n";
-        output << "\tLOD R" << reg_b << ",0\n";
-        output << "\tLOD R3,R1+24\n";
-        output << "\tJMP R3\n";
-        output << "\tLOD R" << reg_b << ",1\n";
-        break;
-
-    case TAC_OP::GE:  // >=
-        output << "\tLOD R3,R1+40\n";
-        output << "\tJLZ R3\n";
-        output << "\tLOD R" << reg_b << ",1\n";
-        output << "\tLOD R3,R1+24\n";
-        output << "\tJMP R3\n";
-        output << "\tLOD R" << reg_b << ",0\n";
-        break;
-
+    case TAC_OP::EQ: jump = "JEZ"; taken = 1; break;  // ==
+    case TAC_OP::NE: jump = "JEZ"; taken = 0; break;  // !=
+    case TAC_OP::LT: jump = "JLZ"; taken = 1; break;  // <
+    case TAC_OP::LE: jump = "JGZ"; taken = 0; break;  // <=
+    case TAC_OP::GT: jump = "JGZ"; taken = 1; break;  // >
+    case TAC_OP::GE: jump = "JLZ"; taken = 0; break;  // >=
     default:
         error("Unknown comparison operator");
-        break;
+        return;
     }
 
+    auto on_taken = std::make_shared<MInst>(MINST_KIND::INSN, "LOD",
+                                            std::vector<MOperand>{MOperand::reg(reg_b), MOperand::imm(taken)});
+    emit("LOD", {MOperand::reg(R_TP), MOperand::addr_of(on_taken)});
+    emit(jump, {MOperand::reg(R_TP)});
+    emit("LOD", {MOperand::reg(reg_b), MOperand::imm(1 - taken)});
+    auto skip = emit("LOD", {MOperand::reg(R_TP), MOperand::addr_of(nullptr)});
+    emit("JMP", {MOperand::reg(R_TP)});
+    emit(on_taken);
+    link_next(skip);
+
     // Update descriptor
     rdesc_clear(reg_b);
     rdesc_fill(reg_b, a, RegState::MODIFIED);
@@ -314,7 +468,7 @@ void ObjGenerator::asm_cmp(TAC_OP op, std::shared_ptr<SYM> a,
 void ObjGenerator::asm_cond(const std::string& op, std::shared_ptr<SYM> a,
                             const std::string& label)
 {
-    asm_write_back_all();
+    asm_write_back_live();
 
     if (a != nullptr)
     {
@@ -332,80 +486,342 @@ void ObjGenerator::asm_cond(const std::string& op, std::shared_ptr<SYM> a,
 
         if (r >= R_GEN)
         {
-            output << "\tTST R" << r << "\n";
+            emit("TST", {MOperand::reg(r)});
         }
         else
         {
             r = reg_alloc(a);
-            output << "\tTST R" << r << "\n";
+            emit("TST", {MOperand::reg(r)});
         }
     }
 
-    output << "\t" << op << " " << label << "\n";
+    emit(op, {MOperand::label(label)});
+}
+
+void ObjGenerator::select_compare_branches()
+{
+    fused_cmp.clear();
+    use_count.clear();
+
+    std::unordered_map<std::shared_ptr<SYM>, int> def_count;
+    for (auto cur = tac_gen.get_tac_first(); cur != nullptr; cur = cur->next)
+    {
+        if (auto def = cur->get_def())
+        {
+            def_count[def]++;
+        }
+        for (const auto& use : cur->get_uses())
+        {
+            use_count[use]++;
+        }
+    }
+
+    for (auto cur = tac_gen.get_tac_first(); cur != nullptr; cur = cur->next)
+    {
+        switch (cur->op)
+        {
+        case TAC_OP::EQ:
+        case TAC_OP::NE:
+        case TAC_OP::LT:
+        case TAC_OP::LE:
+        case TAC_OP::GT:
+        case TAC_OP::GE:
+        case TAC_OP::SUB:
+            break;
+        default:
+            continue;
+        }
+
+        auto next = cur->next;
+        if (next && next->op == TAC_OP::IFZ && next->b == cur->a &&
+            !cur->a->name.empty() && cur->a->name[0] == '@' &&
+            def_count[cur->a] == 1 && use_count[cur->a] == 1 &&
+            !folded_addr.count(cur->a))
+        {
+            fused_cmp.insert(cur);
+        }
+    }
+}
+
+void ObjGenerator::asm_cmp_branch(std::shared_ptr<TAC> cmp, const std::string& label)
+{
+    asm_write_back_live();
+
+    int reg_b = reg_alloc(cmp->b);
+    int k;
+    int reg_t;
+
+    if (cmp->c->get_const_value(k) && k == 0)
+    {
+        reg_t = reg_b;
+    }
+    else
+    {
+        // Subtract in place when the left operand dies here, otherwise use R4
+        bool dies = !cmp->b->name.empty() && cmp->b->name[0] == '@' && use_count[cmp->b] == 1;
+        reg_t = dies ? reg_b : R_TP;
+
+        MOperand rhs;
+        if (cmp->c->get_const_value(k) && k >= 0)
+        {
+            rhs = MOperand::imm(k);
+        }
+        else
+        {
+            reg_locked[reg_b] = true;
+            rhs = MOperand::reg(reg_alloc(cmp->c));
+            reg_locked[reg_b] = false;
+        }
+
+        if (reg_t != reg_b)
+        {
+            emit("LOD", {MOperand::reg(reg_t), MOperand::reg(reg_b)});
+        }
+        emit("SUB", {MOperand::reg(reg_t), rhs});
+        if (dies)
+        {
+            rdesc_clear(reg_b);
+        }
+    }
+
+    emit("TST", {MOperand::reg(reg_t)});
+
+    // IFZ jumps when the comparison is false
+    switch (cmp->op)
+    {
+    case TAC_OP::EQ:
+        emit("JLZ", {MOperand::label(label)});
+        emit("JGZ", {MOperand::label(label)});
+        break;
+    case TAC_OP::NE:
+    case TAC_OP::SUB:
+        emit("JEZ", {MOperand::label(label)});
+        break;
+    case TAC_OP::LT:
+        emit("JEZ", {MOperand::label(label)});
+        emit("JGZ", {MOperand::label(label)});
+        break;
+    case TAC_OP::LE:
+        emit("JGZ", {MOperand::label(label)});
+        break;
+    case TAC_OP::GT:
+        emit("JLZ", {MOperand::label(label)});
+        emit("JEZ", {MOperand::label(label)});
+        break;
+    case TAC_OP::GE:
+        emit("JLZ", {MOperand::label(label)});
+        break;
+    default:
+        error("Unknown comparison operator");
+        break;
+    }
 }
 
 void ObjGenerator::asm_call(std::shared_ptr<SYM> ret, std::shared_ptr<SYM> func)
 {
-    asm_write_back_all();
-    asm_clear_all_regs();
+    const FrameInfo& callee = frames[func->name];
+    int nstack = std::max(0, static_cast<int>(actuals.size()) - ARG_REGS);
 
-    // Store old BP
-    output << "\tSTO (R" << R_BP << "+" << (tof + oon) << "),R" << R_BP << "\n";
-    oon += 4;
+    // Arguments beyond the registers go right above the caller's frame
+    for (int j = ARG_REGS; j < static_cast<int>(actuals.size()); j++)
+    {
+        int r = reg_alloc(actuals[j]);
+        emit("STO", {MOperand::mem(R_BP, tof + 4 * (j - ARG_REGS)), MOperand::reg(r)});
+        frame_touched = true;
+    }
 
-    // Store return address
-    output << "\tLOD R4,R1+32\n";  // 4*8=32
-    output << "\tSTO (R" << R_BP << "+" << (tof + oon) << "),R4\n";
-    oon += 4;
+    // Caller-saved registers only need to reach memory when their value is
+    // used after the call; callee-saved ones survive it unless the callee
+    // may read or write the variable through memory
+    auto live = live_at.find(cur_tac);
+    std::vector<int> stale;
+    for (int r = R_GEN; r < R_IO; r++)
+    {
+        auto var = reg_desc[r].var;
+        if (var == nullptr)
+            continue;
+        bool memory = needs_memory(var);
+        if (r < R_CALLEE_SAVED || block_builder.is_clobbered(cur_tac, var))
+            stale.push_back(r);
+        if (reg_desc[r].state != RegState::MODIFIED)
+            continue;
+        if (memory || (r < R_CALLEE_SAVED && (live == live_at.end() || live->second.count(var))))
+            asm_write_back(r);
+    }
 
-    // Load new BP
-    output << "\tLOD R" << R_BP << ",R" << R_BP << "+" << (tof + oon - 8) << "\n";
+    asm_pass_args();
+    for (int r : stale)
+    {
+        rdesc_clear(r);
+    }
+    actuals.clear();
 
-    // Jump to function
-    output << "\tJMP " << func->name << "\n";
+    // A frameless callee runs on the caller's BP
+    int bump = tof + 4 * nstack;
+    bool move_bp = !(callee.frameless && nstack == 0);
+    if (move_bp)
+    {
+        emit("LOD", {MOperand::reg(R_BP), MOperand::expr(R_BP, bump)});
+    }
+    // Return to the instruction after the jump
+    auto link = emit("LOD", {MOperand::reg(R_JP), MOperand::addr_of(nullptr)});
+    emit("JMP", {MOperand::label(func->name)});
+    link_next(link);
+    if (move_bp)
+    {
+        emit("LOD", {MOperand::reg(R_BP), MOperand::expr(R_BP, -bump)});
+    }
 
-    // Handle return value
-    if (ret != nullptr)
+    // The result arrives in R_RET
+    if (ret != nullptr && !dies(ret))
     {
-        int r = reg_alloc(ret);
-        output << "\tLOD R" << r << ",R" << R_TP << "\n";
-        reg_desc[r].state = RegState::MODIFIED;
+        rdesc_fill(R_RET, ret, RegState::MODIFIED);
     }
+}
+
+// Leave the frame as RETURN would, but jump to the callee with the
+// arguments in place; it returns straight to our caller
+void ObjGenerator::asm_tail_call(std::shared_ptr<SYM> func)
+{
+    asm_write_back_memory();
+    asm_pass_args();
+    actuals.clear();
 
-    oon = 0;
+    const FrameInfo& frame = frames[cur_func];
+    for (int i = 0; i < static_cast<int>(frame.saved.size()); i++)
+    {
+        emit("LOD", {MOperand::reg(frame.saved[i]), MOperand::mem(R_BP, frame.save_slot(i))});
+    }
+    if (!frame.leaf)
+    {
+        emit("LOD", {MOperand::reg(R_JP), MOperand::mem(R_BP, RET_OFF)});
+    }
+    emit("JMP", {MOperand::label(func->name)});
+
+    // The callee builds its frame on ours, so this function must have one
+    frame_touched = true;
+    asm_clear_all_regs();
+}
+
+void ObjGenerator::asm_pass_args()
+{
+    int nreg = std::min(ARG_REGS, static_cast<int>(actuals.size()));
+
+    // Arguments already in registers are moved, the rest loaded afterwards
+    std::vector<std::pair<int, int>> moves; // dst <- src
+    std::vector<int> loads;
+    for (int j = 0; j < nreg; j++)
+    {
+        int src = find_reg(actuals[j]);
+        if (src == R_UNDEF)
+            loads.push_back(j);
+        else if (src != R_ARG + j)
+            moves.emplace_back(R_ARG + j, src);
+    }
+
+    while (!moves.empty())
+    {
+        bool progress = false;
+        for (size_t i = 0; i < moves.size(); i++)
+        {
+            int dst = moves[i].first;
+            bool blocked = std::any_of(moves.begin(), moves.end(),
+                                       [dst](const std::pair<int, int>& m)
+                                       { return m.second == dst; });
+            if (!blocked)
+            {
+                emit("LOD", {MOperand::reg(dst), MOperand::reg(moves[i].second)});
+                moves.erase(moves.begin() + i);
+                progress = true;
+                break;
+            }
+        }
+
+        if (!progress)
+        {
+            // Break the cycle through R_TP
+            int dst = moves.front().first;
+            emit("LOD", {MOperand::reg(R_TP), MOperand::reg(dst)});
+            for (auto& m : moves)
+            {
+                if (m.second == dst)
+                    m.second = R_TP;
+            }
+        }
+    }
+
+    for (int j : loads)
+    {
+        asm_load(R_ARG + j, actuals[j]);
+    }
 }
 
 void ObjGenerator::asm_return(std::shared_ptr<SYM> ret_val)
 {
-    asm_write_back_all();
+    // Only globals outlive the frame
+    for (int r = R_GEN; r < R_NUM; r++)
+    {
+        if (reg_desc[r].var && reg_desc[r].var->scope == SYM_SCOPE::GLOBAL)
+        {
+            asm_write_back(r);
+        }
+    }
+
+    if (ret_val != nullptr && find_reg(ret_val) != R_RET)
+    {
+        asm_load(R_RET, ret_val);
+    }
+
+    const FrameInfo& frame = frames[cur_func];
+    for (int i = 0; i < static_cast<int>(frame.saved.size()); i++)
+    {
+        emit("LOD", {MOperand::reg(frame.saved[i]), MOperand::mem(R_BP, frame.save_slot(i))});
+        frame_touched = true;
+    }
+
+    if (!frame.leaf)
+    {
+        emit("LOD", {MOperand::reg(R_JP), MOperand::mem(R_BP, RET_OFF)});
+        frame_touched = true;
+    }
+    emit("JMP", {MOperand::reg(R_JP)});
+
     asm_clear_all_regs();
+}
+
+void ObjGenerator::asm_prologue()
+{
+    const FrameInfo& frame = frames[cur_func];
+
+    if (!frame.leaf)
+    {
+        emit("STO", {MOperand::mem(R_BP, RET_OFF), MOperand::reg(R_JP)});
+        frame_touched = true;
+    }
 
-    if (ret_val != nullptr)
+    for (int i = 0; i < static_cast<int>(frame.saved.size()); i++)
     {
-        // Load return value into R_TP
-        asm_load(R_TP, ret_val);
+        emit("STO", {MOperand::mem(R_BP, frame.save_slot(i)), MOperand::reg(frame.saved[i])});
+        frame_touched = true;
     }
 
-    // Load return address
-    output << "\tLOD R3,(R" << R_BP << "+4)\n";
-    // Restore BP
-    output << "\tLOD R" << R_BP << ",(R" << R_BP << ")\n";
-    // Jump to return address
-    output << "\tJMP R3\n";
+    // Register arguments start out modified in their registers
+    for (int k = 0; k < static_cast<int>(frame.params.size()) && k < ARG_REGS; k++)
+    {
+        rdesc_fill(R_ARG + k, frame.params[k], RegState::MODIFIED);
+    }
 }
 
 void ObjGenerator::asm_head()
 {
-    output << "\tLOD R" << R_BP << ",STACK\n";
-    output << "\tSTO (R" << R_BP << "),0\n";
-    output << "\tLOD R4,EXIT\n";
-    output << "\tSTO (R" << R_BP << "+4),R4\n";
+    emit("LOD", {MOperand::reg(R_BP), MOperand::label("STACK")});
+    emit("LOD", {MOperand::reg(R_JP), MOperand::label("EXIT")});
 }
 
 void ObjGenerator::asm_tail()
 {
-    output << "EXIT:\n";
-    output << "\tEND\n";
+    emit_label("EXIT");
+    emit("END");
 }
 
 void ObjGenerator::asm_str(std::shared_ptr<SYM> s)
@@ -416,12 +832,11 @@ void ObjGenerator::asm_str(std::shared_ptr<SYM> s)
     }
 
     std::string text = std::get<std::string>(s->value);
-    output << "L" << s->label << ":\n";
-    output << "\tDBS ";
+    emit_label("L" + std::to_string(s->label));
 
-    bool first = true;
     // Process string literal - need to handle escape sequences
     // The string includes quotes, so skip them
+    std::vector<MOperand> bytes;
     size_t start = 0, end = text.length();
     if (text.length() >= 2 && text[0] == '"') {
         start = 1;
@@ -430,68 +845,73 @@ void ObjGenerator::asm_str(std::shared_ptr<SYM> s)
     
     for (size_t i = start; i < end; i++)
     {
-        if (!first) output << ",";
-        first = false;
-        
         if (text[i] == '\\' && i + 1 < end)
         {
             i++;
             switch (text[i])
             {
             case 'n':
-                output << static_cast<int>('\n');
+                bytes.push_back(MOperand::imm('\n'));
                 break;
             case 't':
-                output << static_cast<int>('\t');
+                bytes.push_back(MOperand::imm('\t'));
                 break;
             case 'r':
-                output << static_cast<int>('\r');
+                bytes.push_back(MOperand::imm('\r'));
                 break;
             case '\\':
-                output << static_cast<int>('\\');
+                bytes.push_back(MOperand::imm('\\'));
                 break;
             case '"':
-                output << static_cast<int>('"');
+                bytes.push_back(MOperand::imm('"'));
                 break;
             case '0':
-                output << "0";
+                bytes.push_back(MOperand::imm(0));
                 break;
             default:
-                output << static_cast<int>(static_cast<unsigned char>(text[i]));
+                bytes.push_back(MOperand::imm(static_cast<unsigned char>(text[i])));
                 break;
             }
         }
         else
         {
-            output << static_cast<int>(static_cast<unsigned char>(text[i]));
+            bytes.push_back(MOperand::imm(static_cast<unsigned char>(text[i])));
         }
     }
 
     // Always end with null terminator
-    if (!first) {
-        output << ",0\n";
-    } else {
-        output << "0\n";
-    }
+    bytes.push_back(MOperand::imm(0));
+    emit("DBS", std::move(bytes));
 }
 
 void ObjGenerator::asm_static()
 {
-    // Get all TEXT symbols from global symbol table
+    // Get the TEXT symbols from the global symbol table that the code still
+    // uses; the optimizer may have dropped an output and reused its label
+    std::unordered_set<std::shared_ptr<SYM>> used;
+    for (auto cur = tac_gen.get_tac_first(); cur != nullptr; cur = cur->next)
+    {
+        for (const auto& sym : {cur->a, cur->b, cur->c})
+        {
+            if (sym && sym->type == SYM_TYPE::TEXT)
+                used.insert(sym);
+        }
+    }
+
     const auto& global_symbols = tac_gen.get_global_symbols();
     
     for (const auto& pair : global_symbols)
     {
         const auto& sym = pair.second;
-        if (sym->type == SYM_TYPE::TEXT)
+        if (sym->type == SYM_TYPE::TEXT && used.count(sym))
         {
             asm_str(sym);
         }
     }
 
-    output << "STATIC:\n";
-    output << "\tDBN 0," << tos << "\n";
-    output << "STACK:\n";
+    emit_label("STATIC");
+    emit("DBN", {MOperand::imm(0), MOperand::imm(tos)});
+    emit_label("STACK");
 }
 
 void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
@@ -502,6 +922,20 @@ void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
     }
 
     int r;
+    cur_tac = tac;
+
+    // Address computations folded into a later LOD/STO emit no code here
+    if ((tac->op == TAC_OP::ADDR || tac->op == TAC_OP::ADD || tac->op == TAC_OP::SUB) &&
+        folded_addr.count(tac->a))
+    {
+        return;
+    }
+
+    // Comparisons fused with the following IFZ are emitted by the branch
+    if (fused_cmp.count(tac))
+    {
+        return;
+    }
 
     switch (tac->op)
     {
@@ -544,36 +978,38 @@ void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
         return;
 
     case TAC_OP::COPY:
-        r = reg_alloc(tac->b);
+        r = reg_alloc_dest(tac->b, tac->a);
         rdesc_fill(r, tac->a, RegState::MODIFIED);
         return;
 
     case TAC_OP::INPUT:
-        r = reg_alloc(tac->a);
+        r = find_reg(tac->a);
+        if (r == R_UNDEF)
+            r = reg_alloc_result(R_UNDEF, tac->a);
         if(tac->a->data_type==DATA_TYPE::CHAR)
-            output << "\tITC\n";
+            emit("ITC");
         else if(tac->a->data_type==DATA_TYPE::INT)
-            output << "\tITI\n";
+            emit("ITI");
         else throw std::runtime_error("Unsupported data type for INPUT");
-        output << "\tLOD R" << r << ",R" << R_IO << "\n";
-        reg_desc[r].state = RegState::MODIFIED;
+        emit("LOD", {MOperand::reg(r), MOperand::reg(R_IO)});
+        rdesc_fill(r, tac->a, RegState::MODIFIED);
         return;
 
     case TAC_OP::OUTPUT:
         r = reg_alloc(tac->a);
-        output << "\tLOD R" << R_IO << ",R" << r << "\n";
+        emit("LOD", {MOperand::reg(R_IO), MOperand::reg(r)});
         
         if (tac->a->type == SYM_TYPE::CONST_INT||
             (tac->a->type == SYM_TYPE::VAR && tac->a->data_type == DATA_TYPE::INT))
         {
-            output << "\tOTI\n";
+            emit("OTI");
         }else  if (tac->a->type == SYM_TYPE::CONST_CHAR ||
             (tac->a->type == SYM_TYPE::VAR && tac->a->data_type == DATA_TYPE::CHAR )){
-            output << "\tOTC\n";
+            emit("OTC");
         }
         else if (tac->a->type == SYM_TYPE::TEXT)
         {
-            output << "\tOTS\n";
+            emit("OTS");
         }
         return;
 
@@ -582,61 +1018,83 @@ void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
         return;
 
     case TAC_OP::IFZ:
+        if (tac->prev && fused_cmp.count(tac->prev))
+        {
+            asm_cmp_branch(tac->prev, tac->a->name);
+            return;
+        }
         asm_cond("JEZ", tac->b, tac->a->name);
         return;
 
     case TAC_OP::LABEL:
-        asm_write_back_all();
+        asm_write_back_live();
         asm_clear_all_regs();
-        output << tac->a->name << ":\n";
+        emit_label(tac->a->name);
         return;
 
     case TAC_OP::ACTUAL:
-        r = reg_alloc(tac->a);
-        output << "\tSTO (R" << R_BP << "+" << (tof + oon) << "),R" << r << "\n";
-        oon += 4;
+        // Arguments are passed when the CALL is reached
+        actuals.push_back(tac->a);
         return;
 
     case TAC_OP::CALL:
-        asm_call(tac->a, tac->b);
+        if (tail_calls.count(tac))
+            asm_tail_call(tac->b);
+        else
+            asm_call(tac->a, tac->b);
         return;
 
     case TAC_OP::BEGINFUNC:
-        tof = LOCAL_OFF;
-        oof = FORMAL_OFF;
-        oon = 0;
+        cur_func = tac->prev && tac->prev->op == TAC_OP::LABEL ? tac->prev->a->name : "";
+        tof = frames[cur_func].total_size();
+        frame_touched = false;
+        callee_used.fill(false);
+        spill_next = R_GEN;
+        actuals.clear();
+        asm_prologue();
         return;
 
     case TAC_OP::FORMAL:
-        tac->a->scope = SYM_SCOPE::LOCAL;
-        tac->a->offset = oof;
-        oof -= 4;
+        // Laid out by layout_frames, loaded by the prologue
         return;
 
     case TAC_OP::VAR:
     {
-        int var_size = tac->a->get_size();
-        
-        if (tac->a->scope == SYM_SCOPE::LOCAL)
-        {
-            tac->a->offset = tof;
-            tof += var_size;
-        }
-        else
+        // Locals are laid out by layout_frames
+        if (tac->a->scope != SYM_SCOPE::LOCAL)
         {
             tac->a->offset = tos;
-            tos += var_size;
+            tos += tac->a->get_size();
         }
         return;
     }
 
     case TAC_OP::RETURN:
-        asm_return(tac->a);
+    {
+        // A tail call right before already left the function
+        auto prev = tac->prev;
+        while (prev && prev->op == TAC_OP::VAR)
+            prev = prev->prev;
+        if (!prev || !tail_calls.count(prev))
+            asm_return(tac->a);
         return;
+    }
 
     case TAC_OP::ENDFUNC:
+    {
         asm_return(nullptr);
+        FrameInfo& frame = frames[cur_func];
+
+        // Nobody resumes after main unless it is called recursively
+        frame.saved.clear();
+        for (int r = R_CALLEE_SAVED; r < R_IO; r++)
+        {
+            if (callee_used[r] && (cur_func != "main" || main_called))
+                frame.saved.push_back(r);
+        }
+        frame.frameless = frame.leaf && !frame_touched && frame.saved.empty();
         return;
+    }
 
     case TAC_OP::ADDR:
         {
@@ -649,45 +1107,17 @@ void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
                 }
             }
             
-            r = -1;
-            for (int i = R_GEN; i < R_NUM; i++)
-            {
-                if (reg_desc[i].var == nullptr)
-                {
-                    r = i;
-                    break;
-                }
-            }
-            
-            if (r == -1)
-            {
-                for (int i = R_GEN; i < R_NUM; i++)
-                {
-                    if (reg_desc[i].state == RegState::UNMODIFIED)
-                    {
-                        r = i;
-                        break;
-                    }
-                }
-                if (r == -1)
-                {
-                    r = R_GEN;
-                    asm_write_back(r);
-                }
-            }
+            r = reg_alloc_result(R_UNDEF, tac->a);
             
             if (tac->b->scope == SYM_SCOPE::LOCAL)
             {
-                output << "\tLOD R" << r << ",R" << R_BP << "\n";
-                if (tac->b->offset >= 0)
-                    output << "\tADD R" << r << "," << tac->b->offset << "\n";
-                else
-                    output << "\tSUB R" << r << "," << (-tac->b->offset) << "\n";
+                emit("LOD", {MOperand::reg(r), MOperand::expr(R_BP, tac->b->offset)});
+                frame_touched = true;
             }
             else
             {
-                output << "\tLOD R" << r << ",STATIC\n";
-                output << "\tADD R" << r << "," << tac->b->offset << "\n";
+                emit("LOD", {MOperand::reg(r), MOperand::label("STATIC")});
+                emit("ADD", {MOperand::reg(r), MOperand::imm(tac->b->offset)});
             }
             
             rdesc_fill(r, tac->a, RegState::MODIFIED);
@@ -696,53 +1126,39 @@ void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
 
     case TAC_OP::LOAD_PTR:
         // a = *b : Load value from address stored in b
+        if (folded_addr.count(tac->b))
+        {
+            asm_load_indirect(tac->a, folded_addr.at(tac->b));
+            return;
+        }
         {
             int r_ptr = reg_alloc(tac->b);  // Load pointer value
             
             // Find a free register for the result (don't load tac->a, it's the result!)
-            int r_val = -1;
-            for (int i = R_GEN; i < R_NUM; i++) {
-                if (reg_desc[i].var == nullptr) {
-                    r_val = i;
-                    break;
-                }
-            }
-            
-            if (r_val == -1) {
-                // No free register, find an unmodified one
-                for (int i = R_GEN; i < R_NUM; i++) {
-                    if (reg_desc[i].state == RegState::UNMODIFIED && i != r_ptr) {
-                        r_val = i;
-                        rdesc_clear(r_val);
-                        break;
-                    }
-                }
-            }
+            int r_val = reg_alloc_result(r_ptr, tac->a);
             
-            if (r_val == -1) {
-                // All registers are modified, write back one that's not r_ptr
-                for (int i = R_GEN; i < R_NUM; i++) {
-                    if (i != r_ptr) {
-                        r_val = i;
-                        asm_write_back(r_val);
-                        rdesc_clear(r_val);
-                        break;
-                    }
-                }
-            }
-            
-            // Load value from address in r_ptr
+            // Load value from address in r_ptr, after flushing what it may read
+            asm_write_back_memory(tac->b);
             if (tac->a->data_type == DATA_TYPE::CHAR) {
-                output << "\tLDC R" << r_val << ",(R" << r_ptr << ")\n";
+                emit("LDC", {MOperand::reg(r_val), MOperand::mem(r_ptr, 0)});
             } else {
-                output << "\tLOD R" << r_val << ",(R" << r_ptr << ")\n";
+                emit("LOD", {MOperand::reg(r_val), MOperand::mem(r_ptr, 0)});
             }
             rdesc_fill(r_val, tac->a, RegState::MODIFIED);
         }
         return;
 
     case TAC_OP::STORE_PTR:
+        if (folded_addr.count(tac->a))
+        {
+            asm_store_indirect(tac->b, folded_addr.at(tac->a));
+            return;
+        }
         {
+            // The store may overwrite what the pointer points to: flush
+            // those variables first (before R_TP may hold the pointer),
+            // then force them to be reloaded
+            asm_write_back_memory(tac->a);
             int r_ptr = reg_alloc(tac->a);
             int r_val = reg_alloc(tac->b);
             
@@ -753,55 +1169,502 @@ void ObjGenerator::asm_code(std::shared_ptr<TAC> tac)
                 r_ptr = R_TP;
                 if (tac->a->scope == SYM_SCOPE::LOCAL)
                 {
-                    output << "\tLOD R" << r_ptr << ",(R" << R_BP << "+" << tac->a->offset << ")\n";
+                    emit("LOD", {MOperand::reg(r_ptr), MOperand::mem(R_BP, tac->a->offset)});
+                    frame_touched = true;
                 }
                 else
                 {
-                    output << "\tLOD R" << R_TP << ",STATIC\n";
-                    output << "\tLOD R" << r_ptr << ",(R" << R_TP << "+" << tac->a->offset << ")\n";
+                    emit("LOD", {MOperand::reg(R_TP), MOperand::label("STATIC")});
+                    emit("LOD", {MOperand::reg(r_ptr), MOperand::mem(R_TP, tac->a->offset)});
                 }
             }
             
             if (tac->b->data_type == DATA_TYPE::CHAR)
-                output << "\tSTC (R" << r_ptr << "),R" << r_val << "\n";
+                emit("STC", {MOperand::mem(r_ptr, 0), MOperand::reg(r_val)});
             else
-                output << "\tSTO (R" << r_ptr << "),R" << r_val << "\n";
-            
-            // After pointer store, invalidate all registers since we don't know what was modified
-            // Write back all modified variables first, then clear all descriptors
-            for (int i = R_GEN; i < R_NUM; i++)
+                emit("STO", {MOperand::mem(r_ptr, 0), MOperand::reg(r_val)});
+            asm_clear_memory_regs(tac->a);
+        }
+        return;
+
+    default:
+        error("Unknown TAC opcode: " + std::to_string(static_cast<int>(tac->op)));
+        return;
+    }
+}
+
+void ObjGenerator::select_addressing_modes()
+{
+    folded_addr.clear();
+
+    // Number every TAC and record the block it lives in
+    std::vector<std::shared_ptr<TAC>> order;
+    std::unordered_map<std::shared_ptr<TAC>, int> pos;
+    std::unordered_map<std::shared_ptr<TAC>, int> block_of;
+    std::unordered_map<std::shared_ptr<SYM>, int> def_count;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<TAC>>> use_sites;
+
+    for (auto cur = tac_gen.get_tac_first(); cur != nullptr; cur = cur->next)
+    {
+        pos[cur] = static_cast<int>(order.size());
+        order.push_back(cur);
+        if (auto def = cur->get_def())
+        {
+            def_count[def]++;
+        }
+        for (const auto& use : cur->get_uses())
+        {
+            use_sites[use].push_back(cur);
+        }
+    }
+    for (const auto& block : block_builder.get_basic_blocks())
+    {
+        for (auto cur = block->start; cur != nullptr; cur = cur->next)
+        {
+            block_of[cur] = block->id;
+            if (cur == block->end)
+                break;
+        }
+    }
+
+    auto is_temp = [](const std::shared_ptr<SYM>& s)
+    {
+        return s && s->type == SYM_TYPE::VAR && !s->name.empty() && s->name[0] == '@';
+    };
+
+    // Candidates: single-definition temps computed by ADDR or by adding a
+    // constant/index to an address
+    std::vector<std::shared_ptr<TAC>> candidates;
+    for (const auto& cur : order)
+    {
+        if (!is_temp(cur->a) || def_count[cur->a] != 1)
+            continue;
+        if (cur->op == TAC_OP::ADDR || cur->op == TAC_OP::ADD || cur->op == TAC_OP::SUB)
+            candidates.push_back(cur);
+    }
+
+    // Compose the addressing mode of a candidate from its operands
+    auto compose = [&](const std::shared_ptr<TAC>& tac, AddrMode& mode) -> bool
+    {
+        if (tac->op == TAC_OP::ADDR)
+        {
+            if (tac->b->type != SYM_TYPE::VAR)
+                return false;
+            mode.base = AddrMode::Base::OBJECT;
+            mode.object = tac->b;
+            mode.index = nullptr;
+            mode.disp = 0;
+            mode.from = pos[tac];
+            return true;
+        }
+
+        auto b = tac->b, c = tac->c;
+        int k;
+        if (tac->op == TAC_OP::ADD && b->get_const_value(k))
+            std::swap(b, c);
+
+        if (c->get_const_value(k))
+        {
+            if (b->type != SYM_TYPE::VAR)
+                return false;
+            if (tac->op == TAC_OP::SUB)
+                k = -k;
+            if (folded_addr.count(b))
+            {
+                mode = folded_addr.at(b);
+                mode.disp += k;
+            }
+            else
+            {
+                mode.base = AddrMode::Base::REG;
+                mode.object = b;
+                mode.index = nullptr;
+                mode.disp = k;
+                mode.from = pos[tac];
+            }
+            return true;
+        }
+
+        if (tac->op != TAC_OP::ADD || b->type != SYM_TYPE::VAR || c->type != SYM_TYPE::VAR)
+            return false;
+        if (folded_addr.count(c) && !folded_addr.count(b))
+            std::swap(b, c);
+        if (!folded_addr.count(b) || folded_addr.count(c) || folded_addr.at(b).index)
+            return false;
+        mode = folded_addr.at(b);
+        mode.index = c;
+        return true;
+    };
+
+    // The variables read by the mode must keep their value until the access
+    auto stable = [&](const AddrMode& mode, int use_pos) -> bool
+    {
+        std::vector<std::shared_ptr<SYM>> leaves;
+        if (mode.base == AddrMode::Base::REG)
+            leaves.push_back(mode.object);
+        if (mode.index)
+            leaves.push_back(mode.index);
+
+        for (int i = mode.from + 1; i < use_pos; i++)
+        {
+            const auto& cur = order[i];
+            for (const auto& leaf : leaves)
+            {
+                if (cur->get_def() == leaf)
+                    return false;
+                if (!is_temp(leaf) && block_builder.is_clobbered(cur, leaf))
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    // A candidate is folded only when every use is an access (or another
+    // folded candidate) later in the same basic block
+    std::unordered_set<std::shared_ptr<TAC>> rejected;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        folded_addr.clear();
+
+        for (const auto& cand : candidates)
+        {
+            if (rejected.count(cand))
+                continue;
+            AddrMode mode;
+            if (compose(cand, mode))
+                folded_addr[cand->a] = mode;
+            else
+                rejected.insert(cand);
+        }
+
+        for (const auto& cand : candidates)
+        {
+            if (rejected.count(cand))
+                continue;
+            const auto& mode = folded_addr.at(cand->a);
+
+            for (const auto& use : use_sites[cand->a])
             {
-                if (reg_desc[i].var && reg_desc[i].var->type == SYM_TYPE::VAR && 
-                    reg_desc[i].state == RegState::MODIFIED)
+                bool ok = block_of[use] == block_of[cand] && pos[use] > pos[cand];
+                if (ok)
                 {
-                    asm_write_back(i);
+                    if (use->op == TAC_OP::LOAD_PTR && use->b == cand->a)
+                        ok = stable(mode, pos[use]);
+                    else if (use->op == TAC_OP::STORE_PTR && use->a == cand->a && use->b != cand->a)
+                        ok = stable(mode, pos[use]);
+                    else
+                        ok = use->a != nullptr && folded_addr.count(use->a) &&
+                             (use->op == TAC_OP::ADD || use->op == TAC_OP::SUB);
+                }
+                if (!ok)
+                {
+                    rejected.insert(cand);
+                    changed = true;
+                    break;
                 }
             }
-            // Clear all register descriptors to force reload from memory
-            for (int i = R_GEN; i < R_NUM; i++)
+        }
+    }
+}
+
+int ObjGenerator::asm_addr_base(const AddrMode& mode, int& disp)
+{
+    disp = mode.disp;
+
+    int r_index = R_UNDEF;
+    if (mode.index)
+    {
+        r_index = reg_alloc(mode.index);
+        reg_locked[r_index] = true;
+    }
+
+    int r_base;
+    if (mode.base == AddrMode::Base::OBJECT)
+    {
+        disp += mode.object->offset;
+        if (mode.object->scope == SYM_SCOPE::LOCAL)
+        {
+            r_base = R_BP;
+            frame_touched = true;
+        }
+        else
+        {
+            emit("LOD", {MOperand::reg(R_TP), MOperand::label("STATIC")});
+            r_base = R_TP;
+        }
+    }
+    else
+    {
+        r_base = reg_alloc(mode.object);
+    }
+
+    if (r_index != R_UNDEF)
+    {
+        reg_locked[r_index] = false;
+        if (r_base != R_TP)
+        {
+            emit("LOD", {MOperand::reg(R_TP), MOperand::reg(r_base)});
+        }
+        emit("ADD", {MOperand::reg(R_TP), MOperand::reg(r_index)});
+        r_base = R_TP;
+    }
+
+    return r_base;
+}
+
+void ObjGenerator::asm_load_indirect(std::shared_ptr<SYM> a, const AddrMode& mode)
+{
+    // The addressed variable's memory must be up to date
+    if (mode.base == AddrMode::Base::OBJECT)
+    {
+        for (int i = R_GEN; i < R_NUM; i++)
+        {
+            if (reg_desc[i].var == mode.object)
+            {
+                asm_write_back(i);
+            }
+        }
+    }
+    else
+    {
+        asm_write_back_memory(mode.object);
+    }
+
+    int r_val = reg_alloc_result(R_UNDEF, a);
+    reg_locked[r_val] = true;
+    int disp;
+    int r_base = asm_addr_base(mode, disp);
+    reg_locked[r_val] = false;
+
+    emit(a->data_type == DATA_TYPE::CHAR ? "LDC" : "LOD", {MOperand::reg(r_val), MOperand::mem(r_base, disp)});
+    rdesc_fill(r_val, a, RegState::MODIFIED);
+}
+
+void ObjGenerator::asm_store_indirect(std::shared_ptr<SYM> b, const AddrMode& mode)
+{
+    if (mode.base == AddrMode::Base::OBJECT)
+    {
+        for (int i = R_GEN; i < R_NUM; i++)
+        {
+            if (reg_desc[i].var == mode.object)
+            {
+                asm_write_back(i);
+            }
+        }
+    }
+    else
+    {
+        asm_write_back_memory(mode.object);
+    }
+
+    int r_val = reg_alloc(b);
+    reg_locked[r_val] = true;
+    int disp;
+    int r_base = asm_addr_base(mode, disp);
+    reg_locked[r_val] = false;
+
+    emit(b->data_type == DATA_TYPE::CHAR ? "STC" : "STO", {MOperand::mem(r_base, disp), MOperand::reg(r_val)});
+
+    if (mode.base == AddrMode::Base::OBJECT)
+    {
+        // Only the addressed variable can have changed
+        for (int i = R_GEN; i < R_NUM; i++)
+        {
+            if (reg_desc[i].var == mode.object)
             {
                 rdesc_clear(i);
             }
         }
         return;
+    }
 
-    default:
-        error("Unknown TAC opcode: " + std::to_string(static_cast<int>(tac->op)));
-        return;
+    // Pointer target: forget what it may point to
+    asm_clear_memory_regs(mode.object);
+}
+
+void ObjGenerator::layout_frames()
+{
+    frames.clear();
+    addr_taken.clear();
+    tail_calls.clear();
+    main_called = false;
+
+    for (auto cur = tac_gen.get_tac_first(); cur != nullptr; cur = cur->next)
+    {
+        if (cur->op == TAC_OP::ADDR)
+        {
+            addr_taken.insert(cur->b);
+        }
+        if (cur->op != TAC_OP::BEGINFUNC || !cur->prev || cur->prev->op != TAC_OP::LABEL)
+        {
+            continue;
+        }
+
+        FrameInfo& frame = frames[cur->prev->a->name];
+        std::unordered_set<std::shared_ptr<SYM>> seen;
+        std::unordered_set<std::shared_ptr<SYM>> addressed;
+        std::vector<std::shared_ptr<TAC>> calls;
+        int off = LOCAL_OFF;
+
+        for (auto t = cur->next; t != nullptr && t->op != TAC_OP::ENDFUNC; t = t->next)
+        {
+            switch (t->op)
+            {
+            case TAC_OP::FORMAL:
+                frame.params.push_back(t->a);
+                break;
+            case TAC_OP::VAR:
+                if (t->a->scope == SYM_SCOPE::LOCAL && seen.insert(t->a).second)
+                {
+                    t->a->offset = off;
+                    off += t->a->get_size();
+                }
+                break;
+            case TAC_OP::ADDR:
+                addressed.insert(t->b);
+                break;
+            case TAC_OP::CALL:
+                calls.push_back(t);
+                main_called = main_called || t->b->name == "main";
+                break;
+            default:
+                break;
+            }
+        }
+
+        // A call whose result is returned right away can jump into the callee
+        // on the current frame, unless the callee needs stack arguments or
+        // the frame holds a variable whose address may have escaped.
+        // Declarations and labels in between do not matter
+        bool escaped = std::any_of(addressed.begin(), addressed.end(), [&](const std::shared_ptr<SYM>& sym) {
+            return seen.count(sym) || std::count(frame.params.begin(), frame.params.end(), sym);
+        });
+        for (const auto& call : calls)
+        {
+            auto next = call->next;
+            while (next && (next->op == TAC_OP::VAR || next->op == TAC_OP::LABEL))
+                next = next->next;
+            int nargs = 0;
+            for (auto prev = call->prev; prev && prev->op == TAC_OP::ACTUAL; prev = prev->prev)
+                nargs++;
+            bool returns = next && ((next->op == TAC_OP::RETURN && next->a == call->a) || next->op == TAC_OP::ENDFUNC);
+            if (returns && !escaped && nargs <= ARG_REGS)
+                tail_calls.insert(call);
+            else
+                frame.leaf = false;
+        }
+
+        // Register arguments get a home slot in the callee's frame,
+        // stack arguments sit right below BP
+        int nstack = std::max(0, static_cast<int>(frame.params.size()) - ARG_REGS);
+        for (int k = 0; k < static_cast<int>(frame.params.size()); k++)
+        {
+            auto& param = frame.params[k];
+            param->scope = SYM_SCOPE::LOCAL;
+            if (k < ARG_REGS)
+            {
+                param->offset = off;
+                off += 4;
+            }
+            else
+            {
+                param->offset = FORMAL_OFF * (nstack - (k - ARG_REGS));
+            }
+        }
+
+        frame.size = off;
     }
 }
 
-void ObjGenerator::generate()
+void ObjGenerator::compute_liveness()
+{
+    dead_after.clear();
+    live_at.clear();
+    call_crossing.clear();
+
+    const auto& live_in = block_builder.get_block_in();
+    const auto& live_out = block_builder.get_block_out();
+    for (const auto& block : block_builder.get_basic_blocks())
+    {
+        std::vector<std::shared_ptr<TAC>> instructions;
+        for (auto cur = block->start; cur != nullptr; cur = cur->next)
+        {
+            instructions.push_back(cur);
+            if (cur == block->end)
+                break;
+        }
+
+        auto live = live_out.at(block).live_vars;
+        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it)
+        {
+            const auto& tac = *it;
+            auto def = tac->get_def();
+            auto uses = tac->get_uses();
+
+            // Variables that must be in memory at block boundaries and calls
+            if (tac->op == TAC_OP::IFZ || tac->op == TAC_OP::GOTO)
+            {
+                live_at[tac] = live_out.at(block).live_vars;
+            }
+            else if (tac->op == TAC_OP::LABEL && live_in.count(block))
+            {
+                live_at[tac] = live_in.at(block).live_vars;
+            }
+            else if (tac->op == TAC_OP::CALL)
+            {
+                auto& across = live_at[tac];
+                across = live;
+                if (def)
+                    across.erase(def);
+                call_crossing.insert(across.begin(), across.end());
+            }
+
+            for (const auto& use : uses)
+            {
+                if (!live.count(use))
+                    dead_after[tac].insert(use);
+            }
+            if (def && !live.count(def))
+            {
+                dead_after[tac].insert(def);
+            }
+
+            if (def)
+                live.erase(def);
+            live.insert(uses.begin(), uses.end());
+        }
+    }
+}
+
+bool ObjGenerator::dies(std::shared_ptr<SYM> s) const
+{
+    // Constants can always be reloaded
+    if (!s || s->type != SYM_TYPE::VAR)
+        return true;
+
+    if (needs_memory(s))
+        return false;
+
+    auto it = dead_after.find(cur_tac);
+    return it != dead_after.end() && it->second.count(s);
+}
+
+void ObjGenerator::asm_translate()
 {
+    tos = 0;
     tof = LOCAL_OFF;
-    oof = FORMAL_OFF;
-    oon = 0;
+    cur_func.clear();
+    actuals.clear();
 
     // Initialize register descriptors
     for (int r = 0; r < R_NUM; r++)
     {
         rdesc_clear(r);
+        reg_locked[r] = false;
     }
+    callee_used.fill(false);
 
     // Generate assembly header
     asm_head();
@@ -811,7 +1674,7 @@ void ObjGenerator::generate()
     auto cur = tac_gen.get_tac_first();
     while (cur != nullptr)
     {
-        output << "\n\t# " << cur->to_string() << "\n";
+        emit_comment(cur->to_string());
         asm_code(cur);
         cur = cur->next;
     }
@@ -823,6 +1686,28 @@ void ObjGenerator::generate()
     asm_static();
 }
 
+void ObjGenerator::generate()
+{
+    select_addressing_modes();
+    select_compare_branches();
+    layout_frames();
+    compute_liveness();
+
+    // Dry run to find leaf functions that never touch their frame;
+    // their callers can skip moving BP
+    asm_translate();
+    code.clear();
+    next_refs.clear();
+
+    asm_translate();
+
+    // Clean up after register allocation, then print
+    PeepholeOptimizer peephole(code);
+    peephole.optimize();
+    peephole.report(std::clog);
+    print_code(code, target);
+}
+
 void ObjGenerator::asm_main(){
     auto cur =tac_gen.get_tac_first();
     //check if the first label of func is main
@@ -836,8 +1721,8 @@ void ObjGenerator::asm_main(){
         }
         cur=cur->next;
     }
-    output << "\n\t# Jump to main\n";
-    output << "\tJMP main\n";
+    emit_comment("Jump to main");
+    emit("JMP", {MOperand::label("main")});
 }
 
 void ObjGenerator::error(const std::string& msg)
@@ -2,10 +2,14 @@
 #include <string>
 #include <memory>
 #include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <iostream>
 #include <fstream>
 #include "tac.hh"
 #include "block.hh"
+#include "peephole.hh"
 
 namespace twlm::ccpl::modules
 {
@@ -20,13 +24,24 @@ namespace twlm::ccpl::modules
     constexpr int R_TP = 4;      // Temporary pointer
     constexpr int R_GEN = 5;     // First general purpose register
     constexpr int R_NUM = 16;    // Total number of registers
-    constexpr int R_IO = 15;     // I/O register
+    constexpr int R_IO = 15;     // I/O register, never allocated
+
+    // Register classes: calls clobber R5-R9, callees preserve R10-R14
+    constexpr int R_CALLER_SAVED = 5;  // First caller-saved register
+    constexpr int R_CALLEE_SAVED = 10; // First callee-saved register
+    constexpr int R_ALLOC = R_IO - R_GEN; // Number of allocatable registers
 
     // Frame layout offsets
-    constexpr int FORMAL_OFF = -4;   // First formal parameter
-    constexpr int OBP_OFF = 0;       // Dynamic chain (old BP)
-    constexpr int RET_OFF = 4;       // Return address
-    constexpr int LOCAL_OFF = 8;     // Local variables start
+    constexpr int FORMAL_OFF = -4;   // Last stack-passed formal parameter
+    constexpr int RET_OFF = 0;       // Saved return address (non-leaf functions)
+    constexpr int LOCAL_OFF = 4;     // Local variables start
+
+    // Calling convention: the caller passes the return address in R_JP,
+    // the first ARG_REGS arguments in R_ARG.. and gets the result in R_RET.
+    // Further arguments are stored right above the caller's frame.
+    constexpr int R_RET = 5;         // Return value
+    constexpr int R_ARG = 5;         // First argument register
+    constexpr int ARG_REGS = 4;      // Arguments passed in registers
 
     // Register descriptor states
     enum class RegState
@@ -44,22 +59,94 @@ namespace twlm::ccpl::modules
         RegDescriptor() : var(nullptr), state(RegState::UNMODIFIED) {}
     };
 
+    // Per-function frame information, computed before code generation
+    struct FrameInfo
+    {
+        int size;                                // Bytes from BP to the end of the frame
+        std::vector<std::shared_ptr<SYM>> params; // Formal parameters in order
+        bool leaf;                               // Makes no calls
+        bool frameless;                          // Leaf that never touches its frame
+        std::vector<int> saved;                  // Callee-saved registers it writes
+
+        FrameInfo() : size(LOCAL_OFF), leaf(true), frameless(false) {}
+
+        // Locals, then one save slot per callee-saved register
+        int save_slot(size_t i) const { return size + 4 * static_cast<int>(i); }
+        int total_size() const { return save_slot(saved.size()); }
+    };
+
+    // Folded address computation: base + index + disp
+    // OBJECT bases address a variable directly (frame slot or STATIC),
+    // REG bases use the value of a pointer variable.
+    struct AddrMode
+    {
+        enum class Base
+        {
+            OBJECT,
+            REG
+        };
+
+        Base base;
+        std::shared_ptr<SYM> object; // Addressed variable or pointer variable
+        std::shared_ptr<SYM> index;  // Optional index variable
+        int disp;                    // Constant displacement
+        int from;                    // Position of the first TAC of the chain
+
+        AddrMode() : base(Base::REG), object(nullptr), index(nullptr), disp(0), from(0) {}
+    };
+
     // Assembly code generator
     class ObjGenerator
     {
     private:
-        std::ostream& output;
+        std::ostream& target;     // Final assembly text
+        MCode code;               // Machine instructions before the peephole pass
+        std::vector<std::shared_ptr<MInst>> next_refs;  // Waiting for the address of the next instruction
         TACGenerator& tac_gen;
         BlockBuilder block_builder;
 
         // Register management
         std::array<RegDescriptor, R_NUM> reg_desc;
+        std::array<bool, R_NUM> reg_locked;  // Registers reg_alloc must not evict
+
+        // Address temps folded into the LOD/STO instructions that use them
+        std::unordered_map<std::shared_ptr<SYM>, AddrMode> folded_addr;
+
+        // Comparisons whose only use is the IFZ right after them
+        std::unordered_set<std::shared_ptr<TAC>> fused_cmp;
+        std::unordered_map<std::shared_ptr<SYM>, int> use_count;
 
         // Memory offsets
         int tos;  // Top of static (global variables)
-        int tof;  // Top of frame (local variables)
-        int oof;  // Offset of formal parameters
-        int oon;  // Offset of next frame
+        int tof;  // Frame size of the current function
+
+        // Function state
+        std::unordered_map<std::string, FrameInfo> frames;
+        std::string cur_func;
+        std::shared_ptr<TAC> cur_tac;
+        std::vector<std::shared_ptr<SYM>> actuals;  // Pending ACTUALs of the next CALL
+        bool frame_touched;                          // Current function accessed its frame
+        int spill_next;                              // Next register to spill
+        std::array<bool, R_NUM> callee_used;         // Callee-saved registers written
+        bool main_called;                            // main is called recursively
+        std::unordered_set<std::shared_ptr<TAC>> tail_calls; // Calls that jump into the callee reusing the frame
+
+        // Variables that are dead after each TAC
+        std::unordered_map<std::shared_ptr<TAC>, std::unordered_set<std::shared_ptr<SYM>>> dead_after;
+        std::unordered_set<std::shared_ptr<SYM>> addr_taken;
+
+        // Variables live at LABEL entry, after IFZ/GOTO and across CALL,
+        // and the variables live across any call
+        std::unordered_map<std::shared_ptr<TAC>, std::unordered_set<std::shared_ptr<SYM>>> live_at;
+        std::unordered_set<std::shared_ptr<SYM>> call_crossing;
+
+        // Append to code
+        void emit(std::shared_ptr<MInst> inst);
+        std::shared_ptr<MInst> emit(const std::string& op, std::vector<MOperand> args = {});
+        void emit_label(const std::string& name);
+        void emit_comment(const std::string& text);
+        // Point the instruction address operand of inst at the next instruction emitted
+        void link_next(std::shared_ptr<MInst> inst);
 
         // Helper methods
         void rdesc_clear(int r);
@@ -67,10 +154,31 @@ namespace twlm::ccpl::modules
         
         void asm_write_back(int r);
         void asm_write_back_all();
+        void asm_write_back_live();
+        bool needs_memory(std::shared_ptr<SYM> s) const;
         void asm_clear_all_regs();
+        bool may_access(std::shared_ptr<SYM> ptr, std::shared_ptr<SYM> s) const;
+        void asm_write_back_memory(std::shared_ptr<SYM> ptr = nullptr);
+        void asm_clear_memory_regs(std::shared_ptr<SYM> ptr = nullptr);
         
+        void asm_load_const(int r, int value);
         void asm_load(int r, std::shared_ptr<SYM> s);
         int reg_alloc(std::shared_ptr<SYM> s);
+        int reg_alloc_result(int avoid = R_UNDEF, std::shared_ptr<SYM> s = nullptr);
+        const std::array<int, R_ALLOC>& alloc_order(std::shared_ptr<SYM> s) const;
+        int reg_alloc_dest(std::shared_ptr<SYM> b, std::shared_ptr<SYM> a);
+        int find_reg(std::shared_ptr<SYM> s) const;
+
+        // Frame layout and liveness
+        void layout_frames();
+        void compute_liveness();
+        bool dies(std::shared_ptr<SYM> s) const;
+
+        // Addressing mode selection
+        void select_addressing_modes();
+        int asm_addr_base(const AddrMode& mode, int& disp);
+        void asm_load_indirect(std::shared_ptr<SYM> a, const AddrMode& mode);
+        void asm_store_indirect(std::shared_ptr<SYM> b, const AddrMode& mode);
         
         //return: reg_b
         int asm_bin(const std::string& op, std::shared_ptr<SYM> a, 
@@ -79,9 +187,14 @@ namespace twlm::ccpl::modules
                      std::shared_ptr<SYM> b, std::shared_ptr<SYM> c);
         void asm_cond(const std::string& op, std::shared_ptr<SYM> a, 
                       const std::string& label);
+        void select_compare_branches();
+        void asm_cmp_branch(std::shared_ptr<TAC> cmp, const std::string& label);
         
         void asm_call(std::shared_ptr<SYM> ret, std::shared_ptr<SYM> func);
+        void asm_pass_args();
+        void asm_tail_call(std::shared_ptr<SYM> func);
         void asm_return(std::shared_ptr<SYM> ret_val);
+        void asm_prologue();
         
         void asm_head();
         void asm_tail();
@@ -90,6 +203,7 @@ namespace twlm::ccpl::modules
         void asm_str(std::shared_ptr<SYM> s);
         
         void asm_code(std::shared_ptr<TAC> tac);
+        void asm_translate();
 
     public:
         ObjGenerator(std::ostream& out, TACGenerator& tac_generator);
@@ -4,6 +4,12 @@
 #include <iomanip>
 #include <queue>
 #include <climits>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <optional>
+#include "ssa.hh"
+#include "interp.hh"
 using namespace twlm::ccpl::modules;
 
 void TACOptimizer::warning(const std::string &module, const std::string &msg) const
@@ -11,9 +17,16 @@ void TACOptimizer::warning(const std::string &module, const std::string &msg) co
     std::cerr << "AST Opt[" << module << "] Warning: " << msg << std::endl;
 }
 
-std::shared_ptr<SYM> TACOptimizer::make_const(int value) const
+std::shared_ptr<SYM> TACOptimizer::make_const(int value, DATA_TYPE type) const
 {
     auto const_sym = std::make_shared<SYM>();
+    if (type == DATA_TYPE::CHAR)
+    {
+        const_sym->type = SYM_TYPE::CONST_CHAR;
+        const_sym->value = static_cast<char>(value);
+        const_sym->data_type = DATA_TYPE::CHAR;
+        return const_sym;
+    }
     const_sym->type = SYM_TYPE::CONST_INT;
     const_sym->value = value;
     const_sym->data_type = DATA_TYPE::INT;
@@ -145,18 +158,6 @@ bool TACOptimizer::local_copy_propagation(std::shared_ptr<TAC> tac,std::shared_p
     auto current = tac;
     while (current != nullptr)
     {
-        // 处理简单的拷贝赋值 a = b（b不是常量）
-        if (current->op == TAC_OP::COPY && current->a && current->b &&
-            current->b->type == SYM_TYPE::VAR)
-        {
-            copy_map[current->a] = current->b;
-        }
-        // 如果变量被重新赋值，清除其拷贝信息
-        else if (current->a)
-        {
-            copy_map.erase(current->a);
-        }
-
         // 替换使用处
         bool is_pointer_op = (current->op == TAC_OP::ADDR || 
                               current->op == TAC_OP::LOAD_PTR || 
@@ -182,6 +183,25 @@ bool TACOptimizer::local_copy_propagation(std::shared_ptr<TAC> tac,std::shared_p
             }
         }
 
+        // 如果变量被重新赋值（或被调用、指针写破坏），清除与它相关的拷贝信息
+        auto def = current->get_def();
+        for (auto it = copy_map.begin(); it != copy_map.end();)
+        {
+            if (it->first == def || it->second == def ||
+                block_builder.is_clobbered(current, it->first) ||
+                block_builder.is_clobbered(current, it->second))
+                it = copy_map.erase(it);
+            else
+                ++it;
+        }
+
+        // 处理简单的拷贝赋值 a = b（b不是常量）
+        if (current->op == TAC_OP::COPY && current->a && current->b &&
+            current->b->type == SYM_TYPE::VAR && current->a != current->b)
+        {
+            copy_map[current->a] = current->b;
+        }
+
         if(current==end)
             break;
         current = current->next;
@@ -395,89 +415,381 @@ void TACOptimizer::optimize_block_local(std::shared_ptr<BasicBlock> block)
     }
 }
 
-// 全局常量传播（基于数据流分析）
-bool TACOptimizer::global_constant_propagation(const std::vector<std::shared_ptr<BasicBlock>>& blocks)
+// 稀疏条件常量传播：在 SSA 上同时求常量和可执行边，
+// 只沿可能执行的边合并 phi，所以只在某些路径上为常量的分支也能被消去
+bool TACOptimizer::sparse_conditional_constant_propagation()
 {
+    SSABuilder ssa(block_builder);
+    ssa.build();
+    const auto& values = ssa.get_values();
+    auto blocks = block_builder.get_basic_blocks();
+
+    // 格：TOP（尚未确定） > 常量 > BOTTOM（非常量）
+    enum class Lattice { TOP, CONST, BOTTOM };
+    struct Cell
+    {
+        Lattice state = Lattice::TOP;
+        int value = 0;
+    };
+    std::vector<Cell> cells(values.size());
+    for (auto& value : values)
+    {
+        if (value.is_entry())
+            cells[value.id].state = Lattice::BOTTOM;
+    }
+
+    std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> tac_block;
+    for (auto& block : blocks)
+    {
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            tac_block[tac] = block;
+            if (tac == block->end)
+                break;
+        }
+    }
+
+    std::unordered_set<std::shared_ptr<BasicBlock>> executable;
+    std::set<std::pair<BasicBlock*, BasicBlock*>> executable_edges;
+    std::queue<std::pair<std::shared_ptr<BasicBlock>, std::shared_ptr<BasicBlock>>> flow_worklist;
+    std::queue<int> ssa_worklist;
+
+    auto meet = [](Cell a, const Cell& b) {
+        if (a.state == Lattice::TOP)
+            return b;
+        if (b.state == Lattice::TOP || a.state == Lattice::BOTTOM)
+            return a;
+        if (b.state == Lattice::BOTTOM || a.value != b.value)
+            return Cell{Lattice::BOTTOM, 0};
+        return a;
+    };
+
+    // 值只会沿格下降，下降时通知使用者
+    auto lower = [&](int id, const Cell& cell) {
+        auto& current = cells[id];
+        if (cell.state == current.state && (cell.state != Lattice::CONST || cell.value == current.value))
+            return;
+        current = meet(current, cell);
+        ssa_worklist.push(id);
+    };
+
+    auto operand = [&](std::shared_ptr<TAC> tac, std::shared_ptr<SYM> sym) -> Cell {
+        int value;
+        if (sym && sym->get_const_value(value))
+            return Cell{Lattice::CONST, value};
+        int id = ssa.get_use(tac, sym);
+        return id < 0 ? Cell{Lattice::BOTTOM, 0} : cells[id];
+    };
+
+    auto evaluate = [&](std::shared_ptr<TAC> tac) -> Cell {
+        switch (tac->op)
+        {
+        case TAC_OP::COPY:
+            return operand(tac, tac->b);
+        case TAC_OP::NEG:
+        {
+            auto b = operand(tac, tac->b);
+            if (b.state == Lattice::CONST)
+                b.value = -b.value;
+            return b;
+        }
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+        case TAC_OP::MUL:
+        case TAC_OP::DIV:
+        case TAC_OP::EQ:
+        case TAC_OP::NE:
+        case TAC_OP::LT:
+        case TAC_OP::LE:
+        case TAC_OP::GT:
+        case TAC_OP::GE:
+        {
+            auto b = operand(tac, tac->b), c = operand(tac, tac->c);
+            if (b.state == Lattice::BOTTOM || c.state == Lattice::BOTTOM)
+                return Cell{Lattice::BOTTOM, 0};
+            if (b.state == Lattice::TOP || c.state == Lattice::TOP)
+                return Cell{};
+
+            int x = b.value, y = c.value;
+            switch (tac->op)
+            {
+            case TAC_OP::ADD: return Cell{Lattice::CONST, x + y};
+            case TAC_OP::SUB: return Cell{Lattice::CONST, x - y};
+            case TAC_OP::MUL: return Cell{Lattice::CONST, x * y};
+            case TAC_OP::DIV:
+                if (y == 0)
+                    return Cell{Lattice::BOTTOM, 0};
+                return Cell{Lattice::CONST, x / y};
+            case TAC_OP::EQ: return Cell{Lattice::CONST, x == y};
+            case TAC_OP::NE: return Cell{Lattice::CONST, x != y};
+            case TAC_OP::LT: return Cell{Lattice::CONST, x < y};
+            case TAC_OP::LE: return Cell{Lattice::CONST, x <= y};
+            case TAC_OP::GT: return Cell{Lattice::CONST, x > y};
+            default:         return Cell{Lattice::CONST, x >= y};
+            }
+        }
+        default:
+            return Cell{Lattice::BOTTOM, 0};
+        }
+    };
+
+    auto add_edge = [&](std::shared_ptr<BasicBlock> from, std::shared_ptr<BasicBlock> to) {
+        if (executable_edges.insert({from.get(), to.get()}).second)
+            flow_worklist.push({from, to});
+    };
+
+    auto visit_phi = [&](int id) {
+        auto& phi = values[id];
+        Cell result;
+        for (auto& [pred, arg] : phi.phi_args)
+        {
+            if (executable_edges.count({pred.get(), phi.block.get()}))
+                result = meet(result, cells[arg]);
+        }
+        lower(id, result);
+    };
+
+    auto visit_tac = [&](std::shared_ptr<TAC> tac, std::shared_ptr<BasicBlock> block) {
+        int def = ssa.get_def(tac);
+        if (def >= 0)
+            lower(def, evaluate(tac));
+
+        if (tac != block->end)
+            return;
+
+        // 条件确定时只有一条出边可能执行
+        if (tac->op == TAC_OP::IFZ)
+        {
+            auto cond = operand(tac, tac->b);
+            if (cond.state == Lattice::TOP)
+                return;
+            if (cond.state == Lattice::CONST)
+            {
+                for (auto& succ : block->successors)
+                {
+                    bool is_target = succ->start->op == TAC_OP::LABEL &&
+                                     succ->start->a->name == tac->a->name;
+                    if (is_target == (cond.value == 0))
+                        add_edge(block, succ);
+                }
+                return;
+            }
+        }
+        for (auto& succ : block->successors)
+            add_edge(block, succ);
+    };
+
+    for (auto& func : block_builder.get_functions())
+    {
+        if (!func.blocks.empty())
+            flow_worklist.push({nullptr, func.blocks.front()});
+    }
+
+    while (!flow_worklist.empty() || !ssa_worklist.empty())
+    {
+        while (!flow_worklist.empty())
+        {
+            auto [from, block] = flow_worklist.front();
+            flow_worklist.pop();
+
+            for (int phi : ssa.get_phis(block))
+                visit_phi(phi);
+
+            // 第一次到达的块才需要计算它的指令
+            if (!executable.insert(block).second)
+                continue;
+            for (auto tac = block->start; tac; tac = tac->next)
+            {
+                visit_tac(tac, block);
+                if (tac == block->end)
+                    break;
+            }
+        }
+
+        while (!ssa_worklist.empty())
+        {
+            int id = ssa_worklist.front();
+            ssa_worklist.pop();
+
+            for (int phi : values[id].phi_users)
+            {
+                if (executable.count(values[phi].block))
+                    visit_phi(phi);
+            }
+            for (auto& tac : values[id].tac_users)
+            {
+                auto block = tac_block[tac];
+                if (executable.count(block))
+                    visit_tac(tac, block);
+            }
+        }
+    }
+
+    // 把常量写回 TAC：使用替换成常量，结果为常量的运算改成赋值
     bool changed = false;
-    const int BOTTOM = INT_MIN;
-    const auto& block_in=block_builder.get_block_in();
+    auto constant_of = [&](std::shared_ptr<TAC> tac, std::shared_ptr<SYM> sym) -> std::shared_ptr<SYM> {
+        if (!sym || sym->type != SYM_TYPE::VAR)
+            return nullptr;
+        int id = ssa.get_use(tac, sym);
+        if (id < 0 || cells[id].state != Lattice::CONST)
+            return nullptr;
+        return make_const(cells[id].value, sym->data_type);
+    };
+
     for (auto& block : blocks)
     {
-        auto& in_constants = block_in.at(block).constants;
-        auto current_constants = in_constants;
-        
-        auto tac = block->start;
-        while (tac)
+        if (!executable.count(block))
+            continue;
+
+        for (auto tac = block->start; tac; tac = tac->next)
         {
-            // 替换使用的变量为常量
-            bool is_pointer_op = (tac->op == TAC_OP::ADDR || 
-                                  tac->op == TAC_OP::LOAD_PTR || 
+            bool is_pointer_op = (tac->op == TAC_OP::ADDR ||
+                                  tac->op == TAC_OP::LOAD_PTR ||
                                   tac->op == TAC_OP::STORE_PTR);
-            
-            if (tac->b && tac->b->type == SYM_TYPE::VAR && !is_pointer_op)
+            if (!is_pointer_op)
             {
-                auto it = current_constants.find(tac->b);
-                if (it != current_constants.end() && it->second != BOTTOM)
+                if (auto value = constant_of(tac, tac->b))
+                {
+                    tac->b = value;
+                    changed = true;
+                }
+                if (auto value = constant_of(tac, tac->c))
                 {
-                    tac->b = make_const(it->second);
+                    tac->c = value;
                     changed = true;
                 }
             }
-            
-            if (tac->c && tac->c->type == SYM_TYPE::VAR && !is_pointer_op)
+            if (tac->op == TAC_OP::RETURN || tac->op == TAC_OP::OUTPUT || tac->op == TAC_OP::ACTUAL)
             {
-                auto it = current_constants.find(tac->c);
-                if (it != current_constants.end() && it->second != BOTTOM)
+                if (auto value = constant_of(tac, tac->a))
                 {
-                    tac->c = make_const(it->second);
+                    tac->a = value;
                     changed = true;
                 }
             }
-            
-            // 特殊指令
-            if (tac->op == TAC_OP::RETURN || tac->op == TAC_OP::OUTPUT ||
-                tac->op == TAC_OP::IFZ || tac->op == TAC_OP::ACTUAL)
+
+            int def = ssa.get_def(tac);
+            if (def >= 0 && cells[def].state == Lattice::CONST && tac->op != TAC_OP::COPY)
+            {
+                std::clog << "    SCCP: " << tac->to_string() << " -> " << cells[def].value << std::endl;
+                tac->op = TAC_OP::COPY;
+                tac->b = make_const(cells[def].value, tac->a->data_type);
+                tac->c = nullptr;
+                changed = true;
+            }
+
+            if (tac == block->end)
+                break;
+        }
+    }
+
+    // 删掉不可能执行的出边：只有跳转边可执行的 ifz 改成 goto，只有顺序边可执行的直接删除，
+    // 走不到的块留给不可达代码消除
+    for (auto& block : blocks)
+    {
+        auto tac = block->end;
+        if (!executable.count(block) || tac->op != TAC_OP::IFZ || block->successors.size() != 2)
+            continue;
+        auto target = block->successors[0], fallthrough = block->successors[1];
+        bool jumps = executable_edges.count({block.get(), target.get()});
+        bool falls = executable_edges.count({block.get(), fallthrough.get()});
+        if (jumps == falls)
+            continue;
+
+        std::clog << "    SCCP: " << tac->to_string() << (jumps ? " -> goto" : " -> removed") << std::endl;
+        if (jumps)
+        {
+            tac->op = TAC_OP::GOTO;
+            tac->b = nullptr;
+        }
+        else
+        {
+            if (tac->prev)
+                tac->prev->next = tac->next;
+            if (tac->next)
+                tac->next->prev = tac->prev;
+            tac->prev = nullptr;
+            tac->next = nullptr;
+        }
+        changed = true;
+    }
+
+    return changed;
+}
+
+// 值域传播：用 IFZ 分支条件收窄出的区间和已知成立的比较，折叠结果确定的比较和条件跳转，
+// 取值唯一的变量换成常量（例如 switch 各分支中的 case 值）；
+// 跳转变成常量条件后由控制流简化和不可达代码消除删掉走不到的分支
+bool TACOptimizer::value_range_propagation()
+{
+    RangeAnalysis ranges(block_builder);
+    ranges.compute();
+
+    bool changed = false;
+    auto constant_of = [&](const RangeState& state, const std::shared_ptr<SYM>& sym) -> std::shared_ptr<SYM> {
+        if (!sym || sym->type != SYM_TYPE::VAR)
+            return nullptr;
+        auto range = state.range(sym);
+        if (!range.is_constant())
+            return nullptr;
+        return make_const(static_cast<int>(range.lo), sym->data_type);
+    };
+
+    for (auto& block : block_builder.get_basic_blocks())
+    {
+        ranges.visit(block, [&](const std::shared_ptr<TAC>& tac, const RangeState& state) {
+            bool is_compare = tac->op == TAC_OP::EQ || tac->op == TAC_OP::NE || tac->op == TAC_OP::LT ||
+                              tac->op == TAC_OP::LE || tac->op == TAC_OP::GT || tac->op == TAC_OP::GE;
+            if (is_compare)
             {
-                if (tac->a && tac->a->type == SYM_TYPE::VAR)
+                if (auto known = state.evaluate(tac->op, tac->b, tac->c))
                 {
-                    auto it = current_constants.find(tac->a);
-                    if (it != current_constants.end() && it->second != BOTTOM)
-                    {
-                        tac->a = make_const(it->second);
-                        changed = true;
-                    }
+                    std::clog << "    Range: " << tac->to_string() << " -> " << *known << std::endl;
+                    tac->op = TAC_OP::COPY;
+                    tac->b = make_const(*known ? 1 : 0, tac->a->data_type);
+                    tac->c = nullptr;
+                    changed = true;
+                    return;
                 }
             }
-            
-            // 更新当前常量状态
-            auto def = tac->get_def();
-            if (def)
+            if (tac->op == TAC_OP::IFZ && tac->b->type == SYM_TYPE::VAR)
             {
-                // 简化计算
-                if (tac->op == TAC_OP::COPY)
+                auto range = state.range(tac->b);
+                if (!range.contains(0) || range.is_constant())
                 {
-                    int val;
-                    if (tac->b->get_const_value(val))
-                    {
-                        current_constants[def] = val;
-                    }
-                    else
+                    std::clog << "    Range: " << tac->to_string() << " -> "
+                              << (range.contains(0) ? "always jumps" : "never jumps") << std::endl;
+                    tac->b = make_const(range.contains(0) ? 0 : 1);
+                    changed = true;
+                }
+                return;
+            }
+
+            bool is_pointer_op = (tac->op == TAC_OP::ADDR ||
+                                  tac->op == TAC_OP::LOAD_PTR ||
+                                  tac->op == TAC_OP::STORE_PTR);
+            if (!is_pointer_op)
+            {
+                for (auto operand : {&tac->b, &tac->c})
+                {
+                    if (auto value = constant_of(state, *operand))
                     {
-                        current_constants[def] = BOTTOM;
+                        *operand = value;
+                        changed = true;
                     }
                 }
-                else
+            }
+            if (tac->op == TAC_OP::RETURN || tac->op == TAC_OP::OUTPUT || tac->op == TAC_OP::ACTUAL)
+            {
+                if (auto value = constant_of(state, tac->a))
                 {
-                    current_constants[def] = BOTTOM;
+                    tac->a = value;
+                    changed = true;
                 }
             }
-            
-            if (tac == block->end)
-                break;
-            tac = tac->next;
-        }
+        });
     }
-    
+
     return changed;
 }
 
@@ -553,7 +865,7 @@ bool TACOptimizer::global_dead_code_elimination(const std::vector<std::shared_pt
                 current_live.erase(def);
             }
             
-            auto uses = instr->get_uses();
+            auto uses = block_builder.get_uses(instr);
             for (auto& use : uses)
             {
                 current_live.insert(use);
@@ -564,391 +876,3564 @@ bool TACOptimizer::global_dead_code_elimination(const std::vector<std::shared_pt
     return changed;
 }
 
-// 判断是否是循环头
-bool TACOptimizer::is_loop_header(std::shared_ptr<BasicBlock> block) const
+namespace
 {
-    // 循环头的特征：有前驱在它之后（回边）
-    for (const auto& pred : block->predecessors)
+    // 地址编号：地址按定值时的表达式编号，表示成基址加常数偏移，操作数带上版本，
+    // 重新定值后版本变化，同一个表达式不会把不同时刻的地址当成相同
+    struct AddressNumbering
     {
-        if (pred->id >= block->id)  // 简单判断：后继块指向前面的块
+        struct Value
         {
-            return true;
-        }
-    }
-    return false;
-}
+            std::string base;   // 为空时是常数
+            int offset;
+        };
+        std::unordered_map<std::shared_ptr<SYM>, int> version;
+        std::unordered_map<std::shared_ptr<SYM>, Value> expr;  // 地址变量的表达式
 
-// 查找循环体中的所有基本块
-void TACOptimizer::find_loop_blocks(std::shared_ptr<BasicBlock> header,
-                                    std::unordered_set<std::shared_ptr<BasicBlock>>& loop_blocks) const
-{
-    loop_blocks.clear();
-    loop_blocks.insert(header);
-    
-    // 使用工作列表算法，从回边的源节点开始反向遍历
-    std::queue<std::shared_ptr<BasicBlock>> worklist;
-    
-    for (const auto& pred : header->predecessors)
-    {
-        if (pred->id >= header->id)  // 回边
+        static std::string name(const std::shared_ptr<SYM>& sym)
         {
-            worklist.push(pred);
-            loop_blocks.insert(pred);
+            std::ostringstream oss;
+            oss << sym.get();
+            return oss.str();
         }
-    }
-    
-    while (!worklist.empty())
-    {
-        auto block = worklist.front();
-        worklist.pop();
-        
-        for (const auto& pred : block->predecessors)
+
+        Value value(const std::shared_ptr<SYM>& sym)
         {
-            if (loop_blocks.find(pred) == loop_blocks.end())
-            {
-                loop_blocks.insert(pred);
-                worklist.push(pred);
-            }
+            int constant;
+            if (sym->get_const_value(constant))
+                return {"", constant};
+            auto it = expr.find(sym);
+            if (it != expr.end())
+                return it->second;
+            return {name(sym) + "#" + std::to_string(version[sym]), 0};
         }
-    }
-}
-
-// 获取表达式的唯一键（用于CSE）
-std::string TACOptimizer::get_expression_key(std::shared_ptr<TAC> tac) const
-{
-    if (!tac)
-        return "";
-    
-    std::string key;
-    
-    switch (tac->op)
-    {
-    case TAC_OP::ADD:
-    case TAC_OP::MUL:  // 交换律
-        {
-            std::string b_str = tac->b ? tac->b->to_string() : "";
-            std::string c_str = tac->c ? tac->c->to_string() : "";
-            if (b_str > c_str)
-                std::swap(b_str, c_str);
-            key = "+*:" + b_str + "," + c_str;
-        }
-        break;
-    case TAC_OP::SUB:
-        key = "-:" + (tac->b ? tac->b->to_string() : "") + "," + 
-              (tac->c ? tac->c->to_string() : "");
-        break;
-    case TAC_OP::DIV:
-        key = "/:" + (tac->b ? tac->b->to_string() : "") + "," + 
-              (tac->c ? tac->c->to_string() : "");
-        break;
-    case TAC_OP::LT:
-    case TAC_OP::LE:
-    case TAC_OP::GT:
-    case TAC_OP::GE:
-    case TAC_OP::EQ:
-    case TAC_OP::NE:
-        key = std::to_string(static_cast<int>(tac->op)) + ":" +
-              (tac->b ? tac->b->to_string() : "") + "," + 
-              (tac->c ? tac->c->to_string() : "");
-        break;
-    default:
-        return "";
-    }
-    
-    return key;
-}
 
-// 公共子表达式消除（基本块内）
-bool TACOptimizer::common_subexpression_elimination(std::shared_ptr<BasicBlock> block)
-{
-    bool changed = false;
-    
-    // 表达式 -> 结果变量的映射
-    std::unordered_map<std::string, std::shared_ptr<SYM>> expr_map;
-    
-    auto tac = block->start;
-    while (tac)
-    {
-        std::string key = get_expression_key(tac);
-        
-        if (!key.empty() && tac->a && tac->a->type == SYM_TYPE::VAR)
+        std::string key(const std::shared_ptr<SYM>& sym)
         {
-            auto it = expr_map.find(key);
-            if (it != expr_map.end())
-            {
-                // 找到相同的表达式，替换为拷贝
-                tac->op = TAC_OP::COPY;
-                tac->b = it->second;    //it->second 是临时变量的符号
-                tac->c = nullptr;
-                changed = true;
-            }
-            else
-            {
-                // 记录新表达式
-                expr_map[key] = tac->a;
-            }
+            auto v = value(sym);
+            return v.base + "+" + std::to_string(v.offset);
         }
-        
-        // 如果有变量被重新定值，使相关表达式失效
-        auto def = tac->get_def();
-        if (def)
+
+        // 定值：地址运算记下表达式，其他的只换版本
+        void define(const std::shared_ptr<TAC>& tac)
         {
-            // 移除包含该变量的表达式
-            std::vector<std::string> to_remove;
-            for (auto& [expr_key, var] : expr_map)
+            auto def = tac->get_def();
+            std::optional<Value> e;
+            switch (tac->op)
+            {
+            case TAC_OP::ADDR:
+                e = Value{"&" + name(tac->b), 0};
+                break;
+            case TAC_OP::COPY:
+                e = value(tac->b);
+                break;
+            case TAC_OP::ADD:
             {
-                if (expr_key.find(def->to_string()) != std::string::npos)
+                auto x = value(tac->b), y = value(tac->c);
+                if (x.base.empty() || y.base.empty())
                 {
-                    to_remove.push_back(expr_key);
+                    e = Value{x.base + y.base, x.offset + y.offset};
+                    break;
                 }
+                auto kx = key(tac->b), ky = key(tac->c);
+                if (ky < kx)
+                    std::swap(kx, ky);
+                e = Value{"(" + kx + "+" + ky + ")", 0};
+                break;
             }
-            for (const auto& key : to_remove)
+            case TAC_OP::SUB:
+                if (value(tac->c).base.empty())
+                {
+                    auto x = value(tac->b);
+                    e = Value{x.base, x.offset - value(tac->c).offset};
+                }
+                else
+                    e = Value{"(" + key(tac->b) + "-" + key(tac->c) + ")", 0};
+                break;
+            case TAC_OP::MUL:
             {
-                expr_map.erase(key);
+                auto kx = key(tac->b), ky = key(tac->c);
+                if (ky < kx)
+                    std::swap(kx, ky);
+                e = Value{"(" + kx + "*" + ky + ")", 0};
+                break;
+            }
+            default:
+                break;
             }
+            version[def]++;
+            if (e)
+                expr[def] = *e;
+            else
+                expr.erase(def);
         }
-        
-        if (tac == block->end)
-            break;
-        tac = tac->next;
-    }
-    
-    return changed;
+    };
 }
 
-// 循环不变量外提
-bool TACOptimizer::loop_invariant_code_motion(std::shared_ptr<BasicBlock> loop_header)
+// 冗余读消除和存储到读取的转发：在扩展基本块上做局部值编号，地址用上面的编号。
+// 记下每个地址上已知的内存值：指针写按指针分析杀掉可能别名的地址，调用杀掉它能访问的，
+// 直接给取过地址的变量赋值也要杀掉。按字节的访问会截断，只处理整字
+bool TACOptimizer::redundant_load_elimination()
 {
-    bool changed = false;
-
-    std::unordered_set<std::shared_ptr<BasicBlock>> loop_blocks;
-    find_loop_blocks(loop_header, loop_blocks);
+    struct Known
+    {
+        std::shared_ptr<SYM> value;
+        int version;
+        std::shared_ptr<SYM> ptr;   // 建立时用的指针，用来判断别名
+    };
+    struct State
+    {
+        AddressNumbering numbering;
+        std::unordered_map<std::string, Known> memory;
+    };
 
-    if (loop_blocks.size() <= 1)
-        return false;
+    auto may_alias = [&](const std::shared_ptr<SYM>& p, const std::shared_ptr<SYM>& q) {
+        const auto& a = block_builder.get_points_to(p);
+        const auto& b = block_builder.get_points_to(q);
+        const auto& small = a.size() < b.size() ? a : b;
+        const auto& large = a.size() < b.size() ? b : a;
+        return std::any_of(small.begin(), small.end(), [&](const std::shared_ptr<SYM>& obj) {
+            return large.count(obj) > 0;
+        });
+    };
+    auto kill_if = [](State& state, const std::function<bool(const Known&)>& pred) {
+        for (auto it = state.memory.begin(); it != state.memory.end();)
+        {
+            if (pred(it->second))
+                it = state.memory.erase(it);
+            else
+                ++it;
+        }
+    };
+
+    bool changed = false;
+    std::unordered_map<std::shared_ptr<BasicBlock>, State> block_out;
+    for (const auto& func : block_builder.get_functions())
+    {
+        for (const auto& block : func.blocks)
+        {
+            // 唯一前驱已经处理过时沿用它的出口状态
+            State state;
+            if (block->predecessors.size() == 1 && block_out.count(block->predecessors.front()))
+                state = block_out[block->predecessors.front()];
+
+            for (auto tac = block->start; tac; tac = tac->next)
+            {
+                if (tac->op == TAC_OP::LOAD_PTR && tac->a->data_type != DATA_TYPE::CHAR)
+                {
+                    auto address = state.numbering.key(tac->b);
+                    auto it = state.memory.find(address);
+                    if (it != state.memory.end())
+                    {
+                        auto& known = it->second;
+                        if (known.value->type != SYM_TYPE::VAR || state.numbering.version[known.value] == known.version)
+                        {
+                            std::clog << "    Forwarded load " << tac->to_string() << std::endl;
+                            tac->op = TAC_OP::COPY;
+                            tac->b = known.value;
+                            changed = true;
+                        }
+                    }
+                    if (tac->op == TAC_OP::LOAD_PTR)
+                    {
+                        auto def = tac->a;
+                        state.numbering.define(tac);
+                        kill_if(state, [&](const Known& known) {
+                            return block_builder.get_points_to(known.ptr).count(def) > 0;
+                        });
+                        state.memory[address] = {def, state.numbering.version[def], tac->b};
+                        if (tac == block->end)
+                            break;
+                        continue;
+                    }
+                }
+
+                if (tac->op == TAC_OP::STORE_PTR)
+                {
+                    auto ptr = tac->a;
+                    kill_if(state, [&](const Known& known) { return may_alias(known.ptr, ptr); });
+                    if (tac->b->data_type != DATA_TYPE::CHAR)
+                    {
+                        int version = tac->b->type == SYM_TYPE::VAR ? state.numbering.version[tac->b] : 0;
+                        state.memory[state.numbering.key(ptr)] = {tac->b, version, ptr};
+                    }
+                }
+                else if (tac->op == TAC_OP::CALL)
+                {
+                    kill_if(state, [&](const Known& known) {
+                        const auto& objs = block_builder.get_points_to(known.ptr);
+                        return std::any_of(objs.begin(), objs.end(), [&](const std::shared_ptr<SYM>& obj) {
+                            return block_builder.is_clobbered(tac, obj);
+                        });
+                    });
+                }
+
+                if (auto def = tac->get_def())
+                {
+                    state.numbering.define(tac);
+                    kill_if(state, [&](const Known& known) {
+                        return block_builder.get_points_to(known.ptr).count(def) > 0;
+                    });
+                }
+
+                if (tac == block->end)
+                    break;
+            }
+            block_out[block] = std::move(state);
+        }
+    }
+    return changed;
+}
+
+// 死存储消除：指针写在被读到之前又被同一地址的整字写覆盖的删掉，地址用上面的编号；
+// 写之后指向的对象都不再活跃的也删掉，这些对象只能是没有逃逸的局部变量，
+// 全局变量和逃逸的对象在函数返回后还可能被读
+bool TACOptimizer::dead_store_elimination(const std::vector<std::shared_ptr<BasicBlock>>& blocks)
+{
+    bool changed = false;
+    const auto& block_out = block_builder.get_block_out();
+    // 取地址不读内存
+    auto memory_uses = [&](const std::shared_ptr<TAC>& tac) {
+        return tac->op == TAC_OP::ADDR ? std::vector<std::shared_ptr<SYM>>{} : block_builder.get_uses(tac);
+    };
+    auto reads = [&](const std::shared_ptr<TAC>& store, const std::vector<std::shared_ptr<SYM>>& uses) {
+        const auto& objs = block_builder.get_points_to(store->a);
+        return std::any_of(uses.begin(), uses.end(), [&](const std::shared_ptr<SYM>& sym) {
+            return objs.count(sym) > 0;
+        });
+    };
+
+    for (auto& block : blocks)
+    {
+        std::vector<std::shared_ptr<TAC>> instructions;
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            instructions.push_back(tac);
+            if (tac == block->end)
+                break;
+        }
+        std::unordered_set<std::shared_ptr<TAC>> dead;
+
+        // 正向：还没被读过的写，同一地址再写一次时前一次就没用了。
+        // 同一基址上和写的范围不重叠的读不算读到它
+        AddressNumbering numbering;
+        std::unordered_map<std::string, std::shared_ptr<TAC>> pending;
+        auto width = [](const std::shared_ptr<SYM>& sym) { return sym->data_type == DATA_TYPE::CHAR ? 1 : 4; };
+        for (auto& tac : instructions)
+        {
+            auto uses = memory_uses(tac);
+            for (auto it = pending.begin(); it != pending.end();)
+            {
+                if (tac->op == TAC_OP::LOAD_PTR)
+                {
+                    auto load = numbering.value(tac->b), store = numbering.value(it->second->a);
+                    if (load.base == store.base &&
+                        (load.offset + width(tac->a) <= store.offset || store.offset + width(it->second->b) <= load.offset))
+                    {
+                        ++it;
+                        continue;
+                    }
+                }
+                if (reads(it->second, uses))
+                    it = pending.erase(it);
+                else
+                    ++it;
+            }
+            if (tac->op == TAC_OP::STORE_PTR)
+            {
+                auto address = numbering.key(tac->a);
+                auto it = pending.find(address);
+                if (it != pending.end() && tac->b->data_type != DATA_TYPE::CHAR)
+                    dead.insert(it->second);
+                pending[address] = tac;
+            }
+            if (tac->get_def())
+                numbering.define(tac);
+        }
+
+        // 逆向：写之后不再活跃的局部对象
+        auto current_live = block_out.at(block).live_vars;
+        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it)
+        {
+            auto& tac = *it;
+            if (tac->op == TAC_OP::STORE_PTR)
+            {
+                const auto& objs = block_builder.get_points_to(tac->a);
+                bool unused = !objs.empty() && std::none_of(objs.begin(), objs.end(), [&](const std::shared_ptr<SYM>& obj) {
+                    return obj->scope == SYM_SCOPE::GLOBAL || block_builder.is_escaped(obj) || current_live.count(obj);
+                });
+                if (unused)
+                    dead.insert(tac);
+            }
+            if (auto def = tac->get_def())
+                current_live.erase(def);
+            for (auto& use : memory_uses(tac))
+                current_live.insert(use);
+        }
+
+        for (auto& tac : instructions)
+        {
+            if (dead.count(tac) && remove_from_block(tac, block))
+            {
+                std::clog << "    Removed dead store " << tac->to_string() << std::endl;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// 聚合量标量替换：局部结构体和小数组的地址只用来以常数偏移读写整字时，
+// 每个用到的字段或元素换成一个独立的标量变量，读写变成拷贝，之后就能放进寄存器、参与常量传播。
+// 地址经过别的运算、传出去或存进内存，或者有按字节的访问，都不替换
+bool TACOptimizer::scalar_replacement_of_aggregates()
+{
+    const int MAX_AGGREGATE_SIZE = 64;
+
+    // 候选：局部数组和结构体
+    std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<TAC>> decls;
+    std::unordered_map<std::shared_ptr<SYM>, int> def_count;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::VAR && tac->a->scope == SYM_SCOPE::LOCAL &&
+            (tac->a->is_array || tac->a->data_type == DATA_TYPE::STRUCT) &&
+            tac->a->get_size() <= MAX_AGGREGATE_SIZE)
+            decls[tac->a] = tac;
+        if (auto def = tac->get_def())
+            def_count[def]++;
+    }
+    if (decls.empty())
+        return false;
+
+    // 只定值一次的地址：&x 加减常数，记下对应的聚合量和偏移
+    std::unordered_map<std::shared_ptr<SYM>, std::pair<std::shared_ptr<SYM>, int>> address;
+    std::unordered_set<std::shared_ptr<SYM>> rejected;
+    bool grown = true;
+    while (grown)
+    {
+        grown = false;
+        for (auto tac = tac_first; tac; tac = tac->next)
+        {
+            auto def = tac->get_def();
+            if (!def || address.count(def))
+                continue;
+            int value;
+            std::shared_ptr<SYM> base = nullptr;
+            int offset = 0;
+            if (tac->op == TAC_OP::ADDR && decls.count(tac->b))
+            {
+                address[def] = {tac->b, 0};
+                grown = true;
+                continue;
+            }
+            if (tac->op == TAC_OP::COPY && address.count(tac->b))
+                base = tac->b;
+            else if (tac->op == TAC_OP::ADD && address.count(tac->b) && tac->c->get_const_value(value))
+                base = tac->b, offset = value;
+            else if (tac->op == TAC_OP::ADD && address.count(tac->c) && tac->b->get_const_value(value))
+                base = tac->c, offset = value;
+            else if (tac->op == TAC_OP::SUB && address.count(tac->b) && tac->c->get_const_value(value))
+                base = tac->b, offset = -value;
+            if (!base)
+                continue;
+            address[def] = {address[base].first, address[base].second + offset};
+            grown = true;
+        }
+    }
+    // address 只记下了每个变量的第一次定值，所以要检查带着地址的每一条定值：
+    // 地址流进用户变量或多次定值的变量时，它可能指向的聚合量都不拆
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        auto def = tac->get_def();
+        if (!def)
+            continue;
+        std::vector<std::shared_ptr<SYM>> sources;
+        if (tac->op == TAC_OP::ADDR && decls.count(tac->b))
+            sources.push_back(tac->b);
+        else if (tac->op == TAC_OP::COPY || tac->op == TAC_OP::ADD || tac->op == TAC_OP::SUB)
+        {
+            for (auto sym : {tac->b, tac->c})
+            {
+                if (sym && address.count(sym))
+                    sources.push_back(address[sym].first);
+            }
+        }
+        if (sources.empty() || (def_count[def] == 1 && def->name.rfind("@t", 0) == 0))
+            continue;
+        rejected.insert(sources.begin(), sources.end());
+        if (address.count(def))
+            rejected.insert(address[def].first);
+    }
+
+    // 检查每个地址和聚合量本身的所有使用
+    std::unordered_map<std::shared_ptr<SYM>, std::set<int>> fields;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        auto reject = [&](const std::shared_ptr<SYM>& sym) {
+            if (address.count(sym))
+                rejected.insert(address[sym].first);
+            else if (decls.count(sym))
+                rejected.insert(sym);
+        };
+        auto def = tac->get_def();
+        switch (tac->op)
+        {
+        case TAC_OP::VAR:
+            continue;
+        case TAC_OP::ADDR:
+            if (decls.count(tac->b) && !address.count(def))
+                rejected.insert(tac->b);
+            continue;
+        case TAC_OP::COPY:
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+            if (def && address.count(def))
+                continue;
+            break;
+        case TAC_OP::LOAD_PTR:
+            if (address.count(tac->b))
+            {
+                auto& [aggregate, offset] = address[tac->b];
+                if (tac->a->data_type == DATA_TYPE::CHAR || offset < 0 || offset % 4 ||
+                    offset >= aggregate->get_size())
+                    rejected.insert(aggregate);
+                fields[aggregate].insert(offset);
+            }
+            reject(tac->a);
+            continue;
+        case TAC_OP::STORE_PTR:
+            if (address.count(tac->a))
+            {
+                auto& [aggregate, offset] = address[tac->a];
+                if (tac->b->data_type == DATA_TYPE::CHAR || offset < 0 || offset % 4 ||
+                    offset >= aggregate->get_size())
+                    rejected.insert(aggregate);
+                fields[aggregate].insert(offset);
+            }
+            else
+            {
+                reject(tac->a);
+            }
+            reject(tac->b);
+            continue;
+        default:
+            break;
+        }
+        for (auto sym : {tac->a, tac->b, tac->c})
+        {
+            if (sym)
+                reject(sym);
+        }
+    }
+
+    // 每个字段一个标量，结构体用字段名，数组用下标
+    std::unordered_map<std::shared_ptr<SYM>, std::map<int, std::shared_ptr<SYM>>> scalars;
+    for (auto& [aggregate, offsets] : fields)
+    {
+        if (rejected.count(aggregate))
+            continue;
+        std::clog << "    Scalar replacement of " << aggregate->name << " (" << offsets.size() << " fields)" << std::endl;
+        auto position = decls[aggregate];
+        for (int offset : offsets)
+        {
+            auto scalar = std::make_shared<SYM>();
+            scalar->type = SYM_TYPE::VAR;
+            scalar->data_type = DATA_TYPE::INT;
+            scalar->scope = SYM_SCOPE::LOCAL;
+            scalar->name = aggregate->name + "." + std::to_string(offset);
+            if (aggregate->is_array && aggregate->array_metadata)
+            {
+                scalar->name = aggregate->name + "[" + std::to_string(offset / aggregate->array_metadata->element_size) + "]";
+            }
+            else if (aggregate->struct_metadata)
+            {
+                for (auto& field : aggregate->struct_metadata->fields)
+                {
+                    if (field.offset == offset)
+                        scalar->name = aggregate->name + "." + field.name;
+                }
+            }
+            scalars[aggregate][offset] = scalar;
+
+            auto decl = make_tac(TAC_OP::VAR, scalar);
+            decl->prev = position;
+            decl->next = position->next;
+            position->next->prev = decl;
+            position->next = decl;
+            position = decl;
+        }
+    }
+    if (scalars.empty())
+        return false;
+
+    // 读写改成拷贝，地址计算和原来的声明删掉
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        auto def = tac->get_def();
+        std::shared_ptr<SYM> aggregate = nullptr;
+        if (tac->op == TAC_OP::VAR)
+            aggregate = tac->a;
+        else if (def && address.count(def) && tac->op != TAC_OP::LOAD_PTR)
+            aggregate = address[def].first;
+        if (aggregate && scalars.count(aggregate))
+        {
+            tac->prev->next = tac->next;
+            if (tac->next)
+                tac->next->prev = tac->prev;
+            continue;
+        }
+
+        if (tac->op == TAC_OP::LOAD_PTR && address.count(tac->b) && scalars.count(address[tac->b].first))
+        {
+            auto& [target, offset] = address[tac->b];
+            tac->op = TAC_OP::COPY;
+            tac->b = scalars[target][offset];
+        }
+        else if (tac->op == TAC_OP::STORE_PTR && address.count(tac->a) && scalars.count(address[tac->a].first))
+        {
+            auto& [target, offset] = address[tac->a];
+            tac->op = TAC_OP::COPY;
+            tac->a = scalars[target][offset];
+        }
+    }
+    return true;
+}
+
+// 全局值编号：沿支配树遍历，表达式按（运算，操作数值编号）哈希，
+// 支配当前指令的相同表达式且结果变量仍保存着该值时，改为拷贝。
+// 地址运算不编号：代码生成会把 &x + 常量 折叠进寻址，复用反而要多占寄存器
+bool TACOptimizer::global_value_numbering()
+{
+    SSABuilder ssa(block_builder);
+    ssa.build();
+    const auto& values = ssa.get_values();
+
+    struct ExprKey
+    {
+        TAC_OP op;
+        int lhs, rhs;
+        bool operator==(const ExprKey& other) const
+        {
+            return op == other.op && lhs == other.lhs && rhs == other.rhs;
+        }
+    };
+    struct ExprHash
+    {
+        size_t operator()(const ExprKey& key) const
+        {
+            size_t h = static_cast<size_t>(key.op);
+            h = h * 1000003u ^ static_cast<size_t>(key.lhs);
+            h = h * 1000003u ^ static_cast<size_t>(key.rhs);
+            return h;
+        }
+    };
+
+    int next_number = 0;
+    std::vector<int> value_number(values.size(), -1);      // SSA 值 -> 值编号
+    std::vector<char> is_address(values.size(), 0);         // 由取地址得到的值
+    std::unordered_map<int, int> const_number;              // 常量 -> 值编号
+    std::unordered_map<std::shared_ptr<SYM>, int> memory_number; // 内存变量在当前块中的值编号
+    std::unordered_map<ExprKey, int, ExprHash> table;       // 表达式 -> 计算它的 SSA 值
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<int>> current;  // 变量当前的版本
+    bool changed = false;
+
+    auto number_of_value = [&](int id) {
+        if (value_number[id] < 0)
+            value_number[id] = next_number++;
+        return value_number[id];
+    };
+
+    auto number_of = [&](std::shared_ptr<TAC> tac, std::shared_ptr<SYM> sym) {
+        int value;
+        if (sym->get_const_value(value))
+        {
+            auto it = const_number.find(value);
+            if (it == const_number.end())
+                it = const_number.emplace(value, next_number++).first;
+            return it->second;
+        }
+        int id = ssa.get_use(tac, sym);
+        if (id >= 0)
+            return number_of_value(id);
+        // 不在 SSA 中的变量只在块内、两次修改之间编号相同
+        auto it = memory_number.find(sym);
+        if (it == memory_number.end())
+            it = memory_number.emplace(sym, next_number++).first;
+        return it->second;
+    };
+
+    auto make_key = [&](std::shared_ptr<TAC> tac, ExprKey& key) {
+        switch (tac->op)
+        {
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+        case TAC_OP::MUL:
+        case TAC_OP::DIV:
+        case TAC_OP::EQ:
+        case TAC_OP::NE:
+        case TAC_OP::LT:
+        case TAC_OP::LE:
+            key = {tac->op, number_of(tac, tac->b), number_of(tac, tac->c)};
+            break;
+        // a > b 即 b < a
+        case TAC_OP::GT:
+            key = {TAC_OP::LT, number_of(tac, tac->c), number_of(tac, tac->b)};
+            break;
+        case TAC_OP::GE:
+            key = {TAC_OP::LE, number_of(tac, tac->c), number_of(tac, tac->b)};
+            break;
+        case TAC_OP::NEG:
+            key = {tac->op, number_of(tac, tac->b), -1};
+            break;
+        default:
+            return false;
+        }
+
+        // 交换律
+        if ((key.op == TAC_OP::ADD || key.op == TAC_OP::MUL ||
+             key.op == TAC_OP::EQ || key.op == TAC_OP::NE) && key.lhs > key.rhs)
+        {
+            std::swap(key.lhs, key.rhs);
+        }
+        return true;
+    };
+
+    std::function<void(std::shared_ptr<BasicBlock>)> visit = [&](std::shared_ptr<BasicBlock> block) {
+        std::vector<ExprKey> inserted;
+        std::vector<std::shared_ptr<SYM>> pushed;
+        memory_number.clear();
+
+        // phi 的参数都已编号且相同时，phi 就是这个值
+        for (int phi : ssa.get_phis(block))
+        {
+            int number = -1;
+            for (auto& [pred, arg] : values[phi].phi_args)
+            {
+                int arg_number = value_number[arg];
+                if (arg_number < 0 || (number >= 0 && arg_number != number))
+                {
+                    number = -1;
+                    break;
+                }
+                number = arg_number;
+            }
+            value_number[phi] = number >= 0 ? number : next_number++;
+            current[values[phi].var].push_back(phi);
+            pushed.push_back(values[phi].var);
+        }
+
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            int def = ssa.get_def(tac);
+            ExprKey key;
+
+            if (def >= 0 && (tac->op == TAC_OP::ADD || tac->op == TAC_OP::SUB || tac->op == TAC_OP::COPY))
+            {
+                for (auto& sym : tac->get_uses())
+                {
+                    int id = ssa.get_use(tac, sym);
+                    if (id >= 0 && is_address[id])
+                        is_address[def] = 1;
+                }
+            }
+            if (def >= 0 && tac->op == TAC_OP::ADDR)
+                is_address[def] = 1;
+
+            if (def >= 0 && tac->op == TAC_OP::COPY)
+            {
+                value_number[def] = number_of(tac, tac->b);
+            }
+            else if (def >= 0 && !is_address[def] && make_key(tac, key))
+            {
+                auto it = table.find(key);
+                if (it != table.end())
+                {
+                    auto& previous = values[it->second];
+                    auto& versions = current[previous.var];
+                    if (!versions.empty() && versions.back() == previous.id)
+                    {
+                        std::clog << "    GVN: " << tac->to_string() << " -> "
+                                  << previous.var->name << std::endl;
+                        tac->op = TAC_OP::COPY;
+                        tac->b = previous.var;
+                        tac->c = nullptr;
+                        changed = true;
+                    }
+                    value_number[def] = value_number[previous.id];
+                }
+                else
+                {
+                    table[key] = def;
+                    inserted.push_back(key);
+                    value_number[def] = next_number++;
+                }
+            }
+
+            // 内存变量被写或可能被改写后换一个编号
+            auto target = tac->get_def();
+            if (target && def < 0)
+                memory_number.erase(target);
+            for (auto& var : block_builder.get_clobbers(tac))
+                memory_number.erase(var);
+
+            if (def >= 0)
+            {
+                current[values[def].var].push_back(def);
+                pushed.push_back(values[def].var);
+            }
+
+            if (tac == block->end)
+                break;
+        }
+
+        for (auto& child : block_builder.get_dom_children(block))
+        {
+            visit(child);
+        }
+
+        for (auto& key : inserted)
+            table.erase(key);
+        for (auto& var : pushed)
+            current[var].pop_back();
+    };
+
+    for (auto& func : block_builder.get_functions())
+    {
+        if (!func.blocks.empty())
+            visit(func.blocks.front());
+    }
+
+    return changed;
+}
+
+// 惰性代码移动（部分冗余消除）：由可用表达式和可预期表达式求出每条边上最早的插入位置，
+// 再沿着不用到表达式的路径尽量往后推，把计算放在所有后续路径都要用到它的最迟的边上，
+// 原来冗余的计算改成拷贝。跨块的公共子表达式和循环不变量都是它的特例，任何路径上的计算次数都不会增加。
+// 每个被移动的表达式用一个新的临时变量保存，插入位置在关键边上时拆边
+bool TACOptimizer::lazy_code_motion()
+{
+    auto is_expression = [](const std::shared_ptr<TAC>& tac) {
+        switch (tac->op)
+        {
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+        case TAC_OP::MUL:
+        case TAC_OP::DIV:
+        case TAC_OP::EQ:
+        case TAC_OP::NE:
+        case TAC_OP::LT:
+        case TAC_OP::LE:
+        case TAC_OP::GT:
+        case TAC_OP::GE:
+        case TAC_OP::NEG:
+            return true;
+        default:
+            return false;
+        }
+    };
+    auto operand_key = [](const std::shared_ptr<SYM>& sym) {
+        if (!sym)
+            return std::string();
+        int value;
+        if (sym->get_const_value(value))
+            return (sym->data_type == DATA_TYPE::CHAR ? "'" : "") + std::to_string(value);
+        std::ostringstream oss;
+        oss << sym.get();
+        return oss.str();
+    };
+
+    // 表达式按 (运算, 操作数, 结果类型) 编号，记下每个变量出现在哪些表达式里
+    std::vector<std::shared_ptr<TAC>> samples;
+    std::unordered_map<std::string, int> expr_index;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<int>> users;
+    std::unordered_map<std::shared_ptr<TAC>, int> occurrence;
+    for (const auto& func : block_builder.get_functions())
+    {
+        for (const auto& block : func.name.empty() ? BlockList{} : func.blocks)
+        {
+            for (auto tac = block->start; tac; tac = tac->next)
+            {
+                if (is_expression(tac))
+                {
+                    auto key = std::to_string(static_cast<int>(tac->op)) + ":" + operand_key(tac->b) + ":" +
+                               operand_key(tac->c) + ":" + std::to_string(static_cast<int>(tac->a->data_type));
+                    auto [it, inserted] = expr_index.emplace(key, samples.size());
+                    if (inserted)
+                    {
+                        samples.push_back(make_tac(tac->op, tac->a, tac->b, tac->c));
+                        for (auto& use : tac->get_uses())
+                            users[use].push_back(it->second);
+                    }
+                    occurrence[tac] = it->second;
+                }
+                if (tac == block->end)
+                    break;
+            }
+        }
+    }
+    if (samples.empty())
+        return false;
+
+    // 局部性质：ANTLOC 块内向上暴露的计算，COMP 向下暴露的计算，TRANSP 块内不修改操作数
+    auto all_blocks = block_builder.get_basic_blocks();
+    size_t n = all_blocks.size(), width = samples.size();
+    std::vector<BitSet> antloc(n, BitSet(width)), comp(n, BitSet(width)), transp(n, BitSet(width));
+    for (size_t b = 0; b < n; ++b)
+    {
+        BitSet killed(width);
+        for (auto tac = all_blocks[b]->start; tac; tac = tac->next)
+        {
+            auto it = occurrence.find(tac);
+            if (it != occurrence.end())
+            {
+                if (!killed.test(it->second))
+                    antloc[b].set(it->second);
+                comp[b].set(it->second);
+            }
+            auto defs = block_builder.get_clobbers(tac);
+            if (auto def = tac->get_def())
+                defs.push_back(def);
+            for (auto& def : defs)
+            {
+                auto users_it = users.find(def);
+                if (users_it == users.end())
+                    continue;
+                for (int e : users_it->second)
+                {
+                    killed.set(e);
+                    comp[b].reset(e);
+                }
+            }
+            if (tac == all_blocks[b]->end)
+                break;
+        }
+        transp[b].fill();
+        transp[b].subtract(killed);
+    }
+
+    // 可用表达式（前向）和可预期表达式（逆向），交汇都取交集
+    DataFlowProblem problem;
+    problem.boundary = BitSet(width);
+    problem.meet_union = false;
+    problem.kill.assign(n, BitSet(width));
+    for (size_t b = 0; b < n; ++b)
+    {
+        problem.kill[b].fill();
+        problem.kill[b].subtract(transp[b]);
+    }
+    std::vector<BitSet> avin, avout, antin, antout;
+    problem.forward = true;
+    problem.gen = comp;
+    block_builder.solve_data_flow(problem, avin, avout);
+    problem.forward = false;
+    problem.gen = antloc;
+    block_builder.solve_data_flow(problem, antin, antout);
+
+    auto index = [&](const std::shared_ptr<BasicBlock>& block) { return block_builder.get_block_index(block); };
+    auto unique_successors = [](const std::shared_ptr<BasicBlock>& block) {
+        BlockList succs;
+        for (auto& succ : block->successors)
+        {
+            if (std::find(succs.begin(), succs.end(), succ) == succs.end())
+                succs.push_back(succ);
+        }
+        return succs;
+    };
+
+    // EARLIEST(i,j) = ANTIN(j) ∩ ¬AVOUT(i) ∩ (¬TRANSP(i) ∪ ¬ANTOUT(i))
+    // LATER(i,j) = EARLIEST(i,j) ∪ (LATERIN(i) ∩ ¬ANTLOC(i))，LATERIN(j) 为进入 j 的各边 LATER 的交；
+    // 函数入口有一条虚拟的入边，它的 EARLIEST 就是入口块的 ANTIN
+    using Edge = std::pair<int, int>;
+    std::map<Edge, BitSet> earliest, later;
+    std::vector<BitSet> laterin(n, BitSet(width));
+    for (const auto& func : block_builder.get_functions())
+    {
+        if (func.name.empty())
+            continue;
+        for (const auto& block : func.blocks)
+        {
+            int i = index(block);
+            BitSet keep = transp[i];
+            keep.intersect(antout[i]);
+            for (auto& succ : unique_successors(block))
+            {
+                int j = index(succ);
+                BitSet bits = antin[j];
+                bits.subtract(avout[i]);
+                bits.subtract(keep);
+                earliest[{i, j}] = bits;
+            }
+            laterin[i].fill();
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (const auto& block : func.blocks)
+            {
+                int j = index(block);
+                BitSet in(width);
+                in.fill();
+                if (block == func.blocks.front())
+                    in = antin[j];
+                for (auto& pred : block->predecessors)
+                {
+                    int i = index(pred);
+                    BitSet bits = laterin[i];
+                    bits.subtract(antloc[i]);
+                    bits.unite(earliest[{i, j}]);
+                    later[{i, j}] = bits;
+                    in.intersect(bits);
+                }
+                if (block->predecessors.empty() && block != func.blocks.front())
+                    in.clear();
+                if (in != laterin[j])
+                {
+                    laterin[j] = in;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // INSERT(i,j) = LATER(i,j) ∩ ¬LATERIN(j)，DELETE(b) = ANTLOC(b) ∩ ¬LATERIN(b)
+    std::map<Edge, BitSet> insert;
+    std::vector<BitSet> remove(n, BitSet(width));
+    BitSet moved(width);
+    for (size_t b = 0; b < n; ++b)
+    {
+        remove[b] = antloc[b];
+        remove[b].subtract(laterin[b]);
+        moved.unite(remove[b]);
+    }
+    for (auto& [edge, bits] : later)
+    {
+        BitSet ins = bits;
+        ins.subtract(laterin[edge.second]);
+        ins.intersect(moved);
+        if (ins != BitSet(width))
+            insert[edge] = ins;
+    }
+
+    // 保存：向下暴露的计算在后面有被删掉的计算要用它的值时写到新变量里
+    // NEEDIN(b) = DELETE(b) ∪ (NEEDOUT(b) ∩ TRANSP(b) ∩ ¬ANTLOC(b))，NEEDOUT(i) 为 ∪ (NEEDIN(j) ∩ ¬INSERT(i,j))
+    std::vector<BitSet> needin(n, BitSet(width)), needout(n, BitSet(width));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t k = n; k-- > 0;)
+        {
+            BitSet out(width);
+            for (auto& succ : unique_successors(all_blocks[k]))
+            {
+                int j = index(succ);
+                BitSet bits = needin[j];
+                auto it = insert.find({static_cast<int>(k), j});
+                if (it != insert.end())
+                    bits.subtract(it->second);
+                out.unite(bits);
+            }
+            BitSet in = out;
+            in.intersect(transp[k]);
+            in.subtract(antloc[k]);
+            in.unite(remove[k]);
+            if (in != needin[k] || out != needout[k])
+            {
+                needin[k] = in;
+                needout[k] = out;
+                changed = true;
+            }
+        }
+    }
+
+    // 计算次数不增加，但寄存器只在块内分配，跨块的新变量要经过内存，所以按周期估计收益：
+    // 原来的计算要装入变量操作数再运算，删掉后换成装入新变量；插入的计算还要写回结果，
+    // 保存多一条拷贝和一次写回。执行频率按循环深度估计，循环里有条件执行的块和条件分支的出边算一半
+    const int MEMORY_CYCLES = 10;
+    const int MULDIV_CYCLES = 5;
+    auto evaluation = [&](int e) {
+        auto sample = samples[e];
+        int cycles = sample->op == TAC_OP::MUL || sample->op == TAC_OP::DIV ? MULDIV_CYCLES : 1;
+        return cycles + static_cast<int>(sample->get_uses().size()) * MEMORY_CYCLES;
+    };
+    auto frequency = [&](int b) {
+        auto loop = block_builder.get_loop(all_blocks[b]);
+        int freq = 2;
+        for (int depth = loop ? loop->depth : 0; depth > 0 && freq < 2000; depth--)
+            freq *= 10;
+        // 不是每次迭代都执行的块
+        if (loop && std::any_of(loop->latches.begin(), loop->latches.end(), [&](const std::shared_ptr<BasicBlock>& latch) {
+                return !block_builder.dominates(all_blocks[b], latch);
+            }))
+            freq /= 2;
+        return freq;
+    };
+    // 操作数可能已经在块内的寄存器里，同频率之间的移动省不下装入，所以还要求删掉的计算都比插入和保存的更频繁
+    std::vector<long> benefit(width, 0);
+    std::vector<int> hottest_kept(width, 0), coldest_removed(width, INT_MAX);
+    for (size_t b = 0; b < n; ++b)
+    {
+        remove[b].for_each([&](size_t e) {
+            benefit[e] += frequency(b) * (evaluation(e) - MEMORY_CYCLES);
+            coldest_removed[e] = std::min(coldest_removed[e], frequency(b));
+        });
+    }
+    for (auto& [edge, bits] : insert)
+    {
+        int freq = std::min(frequency(edge.first), frequency(edge.second));
+        auto loop = block_builder.get_loop(all_blocks[edge.second]);
+        if (unique_successors(all_blocks[edge.first]).size() > 1 && !(loop && loop->header == all_blocks[edge.second]))
+            freq /= 2;
+        bits.for_each([&](size_t e) {
+            benefit[e] -= freq * (evaluation(e) + MEMORY_CYCLES);
+            hottest_kept[e] = std::max(hottest_kept[e], freq);
+        });
+    }
+    for (size_t b = 0; b < n; ++b)
+    {
+        BitSet saves = comp[b];
+        saves.intersect(needout[b]);
+        saves.subtract(remove[b]);
+        saves.for_each([&](size_t e) {
+            benefit[e] -= frequency(b) * (1 + MEMORY_CYCLES);
+            hottest_kept[e] = std::max(hottest_kept[e], frequency(b));
+        });
+    }
+    for (size_t e = 0; e < width; ++e)
+    {
+        if (benefit[e] <= 0 || hottest_kept[e] >= coldest_removed[e])
+            moved.reset(e);
+    }
+
+    // 插入的位置：后继只有这一个前驱时放在后继开头，前驱只有这一个后继时放在前驱末尾，
+    // 否则是关键边：顺序流入的边直接在两块之间插一块；跳转边新建标签，
+    // 放在不会顺序执行到的地方，不能顺序流入 j 时再补一条 goto。标签不够用的边上的表达式不移动
+    enum class Place { SUCC_START, PRED_END, FALL_THROUGH, JUMP, JUMP_INTO };
+    std::map<Edge, Place> place;
+    std::map<Edge, std::shared_ptr<TAC>> jump_anchor;   // 跳转边的新块插在它后面
+    std::unordered_set<std::shared_ptr<BasicBlock>> entered;  // 已经有新块顺序流入的 j
+    int labels_left = unroll_options.label_limit - count_labels();
+    std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> block_of_end;
+    for (auto& block : all_blocks)
+        block_of_end[block->end] = block;
+    for (auto& [edge, bits] : insert)
+    {
+        auto from = all_blocks[edge.first], to = all_blocks[edge.second];
+        if (to->predecessors.size() == 1 && to->start->op == TAC_OP::LABEL &&
+            !(to->start->next && to->start->next->op == TAC_OP::BEGINFUNC))
+            place[edge] = Place::SUCC_START;
+        else if (unique_successors(from).size() == 1)
+            place[edge] = Place::PRED_END;
+        else if (from->end->next == to->start)
+            place[edge] = Place::FALL_THROUGH;
+        else if (to->start->op == TAC_OP::LABEL && labels_left > 0)
+        {
+            // 同一函数里找一条无条件转移，优先用 j 前面那条
+            std::shared_ptr<TAC> anchor;
+            auto before = to->start->prev;
+            if (before && (before->op == TAC_OP::GOTO || before->op == TAC_OP::RETURN))
+                anchor = before;
+            for (auto tac = to->start; !anchor && tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+            {
+                if ((tac->op == TAC_OP::GOTO || tac->op == TAC_OP::RETURN) && block_of_end.count(tac))
+                    anchor = tac;
+            }
+            if (!anchor)
+            {
+                moved.subtract(bits);
+                continue;
+            }
+            place[edge] = anchor == before && entered.insert(to).second ? Place::JUMP_INTO : Place::JUMP;
+            jump_anchor[edge] = anchor;
+            labels_left--;
+        }
+        else
+            moved.subtract(bits);
+    }
+    if (moved == BitSet(width))
+        return false;
+
+    std::vector<std::shared_ptr<SYM>> temps(width);
+    moved.for_each([&](size_t e) { temps[e] = make_temp(samples[e]->a->data_type, SYM_SCOPE::LOCAL); });
+    BitSet declared(width);
+    auto compute = [&](int e) {
+        auto sample = samples[e];
+        std::vector<std::shared_ptr<TAC>> code;
+        if (!declared.test(e))
+        {
+            declared.set(e);
+            code.push_back(make_tac(TAC_OP::VAR, temps[e]));
+        }
+        code.push_back(make_tac(sample->op, temps[e], sample->b, sample->c));
+        return code;
+    };
+
+    // 改写块内的计算：被删除的改成拷贝，需要保存的最后一次计算先写到新变量
+    for (size_t b = 0; b < n; ++b)
+    {
+        auto block = all_blocks[b];
+        std::unordered_map<int, std::shared_ptr<TAC>> first, last;
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            auto it = occurrence.find(tac);
+            if (it != occurrence.end() && moved.test(it->second))
+            {
+                first.emplace(it->second, tac);
+                last[it->second] = tac;
+            }
+            if (tac == block->end)
+                break;
+        }
+        for (auto& [e, tac] : first)
+        {
+            if (!remove[b].test(e))
+                continue;
+            std::clog << "    Replaced partially redundant " << tac->to_string() << std::endl;
+            tac->op = TAC_OP::COPY;
+            tac->b = temps[e];
+            tac->c = nullptr;
+        }
+        for (auto& [e, tac] : last)
+        {
+            if (!comp[b].test(e) || !needout[b].test(e) || tac->op == TAC_OP::COPY)
+                continue;
+            auto code = compute(e);
+            auto copy = make_tac(TAC_OP::COPY, tac->a, temps[e]);
+            tac->a = code.back()->a;
+            code.pop_back();
+            for (auto& node : code)
+            {
+                node->prev = tac->prev;
+                node->next = tac;
+                tac->prev->next = node;
+                tac->prev = node;
+                if (block->start == tac)
+                    block->start = node;
+            }
+            insert_after(copy, tac, block);
+        }
+    }
+
+    // 在边上插入
+    for (auto& [edge, bits] : insert)
+    {
+        BitSet ins = bits;
+        ins.intersect(moved);
+        if (ins == BitSet(width))
+            continue;
+        std::vector<std::shared_ptr<TAC>> code;
+        ins.for_each([&](size_t e) {
+            std::clog << "    Inserted " << samples[e]->to_string() << " on edge " << all_blocks[edge.first]->id
+                      << " -> " << all_blocks[edge.second]->id << std::endl;
+            auto part = compute(e);
+            code.insert(code.end(), part.begin(), part.end());
+        });
+
+        auto from = all_blocks[edge.first], to = all_blocks[edge.second];
+        std::shared_ptr<TAC> position;
+        switch (place.at(edge))
+        {
+        case Place::SUCC_START:
+            position = to->start;
+            break;
+        case Place::PRED_END:
+            for (auto& node : code)
+                append_to_block(node, from);
+            continue;
+        case Place::FALL_THROUGH:
+            position = from->end;
+            break;
+        case Place::JUMP:
+        case Place::JUMP_INTO:
+        {
+            // 紧挨在 j 前面的新块直接流入 j，其余的插在无条件转移后面，跳回 j
+            auto label = make_label(to->start->a->scope);
+            code.insert(code.begin(), make_tac(TAC_OP::LABEL, label));
+            from->end->a = label;
+            if (place.at(edge) == Place::JUMP_INTO)
+            {
+                position = to->start->prev;
+                break;
+            }
+            code.push_back(make_tac(TAC_OP::GOTO, to->start->a));
+            position = jump_anchor.at(edge);
+            break;
+        }
+        }
+        for (auto& node : code)
+        {
+            node->prev = position;
+            node->next = position->next;
+            if (position->next)
+                position->next->prev = node;
+            position->next = node;
+            position = node;
+        }
+    }
+    return true;
+}
+
+// 循环不变量外提
+bool TACOptimizer::loop_invariant_code_motion(std::shared_ptr<Loop> loop)
+{
+    bool changed = false;
+
+    auto preheader = loop->preheader;
+    if (!preheader || !preheader->end)
+        return false;
+
+    std::vector<std::shared_ptr<TAC>> loop_instructions;
+    std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> instr_block;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<TAC>>> defs_in_loop;
+    std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<TAC>> var_decl_in_loop;
+    std::vector<std::shared_ptr<TAC>> loop_clobbers;  // 循环中的调用和指针写
+
+    auto record_instruction = [&](std::shared_ptr<BasicBlock> block, std::shared_ptr<TAC> tac) {
+        instr_block[tac] = block;
+        loop_instructions.push_back(tac);
+
+        if (tac->op == TAC_OP::CALL || tac->op == TAC_OP::STORE_PTR)
+        {
+            loop_clobbers.push_back(tac);
+        }
+
+        if (tac->op == TAC_OP::VAR && tac->a && tac->a->type == SYM_TYPE::VAR)
+        {
+            var_decl_in_loop[tac->a] = tac;
+        }
+
+        auto def = tac->get_def();
+        if (def)
+        {
+            defs_in_loop[def].push_back(tac);
+        }
+    };
+
+    for (auto& block : loop->blocks)
+    {
+        if (!block || !block->start || !block->end)
+            continue;
+
+        auto tac = block->start;
+        while (tac)
+        {
+            record_instruction(block, tac);
+            if (tac == block->end)
+                break;
+            tac = tac->next;
+        }
+    }
+
+    if (loop_instructions.empty())
+        return false;
+
+    // 循环出口处活跃的变量，以及有边离开循环的块
+    const auto& block_in = block_builder.get_block_in();
+    const auto& live_at_header = block_in.at(loop->header).live_vars;
+    std::unordered_set<std::shared_ptr<SYM>> live_at_exit;
+    for (auto& exit : loop->exits)
+    {
+        auto it = block_in.find(exit);
+        if (it != block_in.end())
+            live_at_exit.insert(it->second.live_vars.begin(), it->second.live_vars.end());
+    }
+    std::vector<std::shared_ptr<BasicBlock>> exiting_blocks;
+    for (auto& block : loop->blocks)
+    {
+        for (auto& succ : block->successors)
+        {
+            if (!loop->contains(succ))
+            {
+                exiting_blocks.push_back(block);
+                break;
+            }
+        }
+    }
+
+    // 每次离开循环之前都一定执行过 block
+    auto dominates_exits = [&](std::shared_ptr<BasicBlock> block) {
+        for (auto& exiting : exiting_blocks)
+        {
+            if (!block_builder.dominates(block, exiting))
+                return false;
+        }
+        return true;
+    };
+
+    auto is_supported_op = [](TAC_OP op) {
+        switch (op)
+        {
+        case TAC_OP::ADD:
+        case TAC_OP::SUB:
+        case TAC_OP::MUL:
+        case TAC_OP::DIV:
+        case TAC_OP::LT:
+        case TAC_OP::LE:
+        case TAC_OP::GT:
+        case TAC_OP::GE:
+        case TAC_OP::EQ:
+        case TAC_OP::NE:
+        case TAC_OP::COPY:
+            return true;
+        default:
+            return false;
+        }
+    };
+
+    auto operand_ready = [&](const std::shared_ptr<SYM>& sym,
+                             const std::unordered_set<std::shared_ptr<TAC>>& movable) -> bool {
+        if (!sym)
+            return true;
+
+        if (sym->type == SYM_TYPE::CONST_INT || sym->type == SYM_TYPE::CONST_CHAR)
+            return true;
+
+        if (sym->type != SYM_TYPE::VAR)
+            return false;
+
+        for (auto& clobber : loop_clobbers)
+        {
+            if (block_builder.is_clobbered(clobber, sym))
+                return false;
+        }
+
+        auto it = defs_in_loop.find(sym);
+        if (it == defs_in_loop.end())
+            return true; // 定义在循环外
+
+        for (auto& defining_instr : it->second)
+        {
+            if (movable.find(defining_instr) == movable.end())
+                return false;
+        }
+
+        return true;
+    };
+
+    // 每个块至少留下一条指令，否则块的首尾无法表示
+    std::unordered_map<std::shared_ptr<BasicBlock>, int> remaining;
+    for (auto& instr : loop_instructions)
+        remaining[instr_block[instr]]++;
+
+    std::unordered_set<std::shared_ptr<TAC>> movable;
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+
+        for (auto& instr : loop_instructions)
+        {
+            if (movable.find(instr) != movable.end())
+                continue;
+
+            if (!is_supported_op(instr->op))
+                continue;
+
+            auto def = instr->get_def();
+            if (!def || block_builder.is_memory_var(def))
+                continue;
+
+            auto def_it = defs_in_loop.find(def);
+            if (def_it == defs_in_loop.end())
+                continue;
+
+            if (def_it->second.size() != 1)
+                continue; // 在循环中有多次定值，不能外提
+
+            // 进入循环时还要用到旧值，不能提前覆盖
+            if (live_at_header.count(def))
+                continue;
+
+            // 定值不一定执行时，只有出口处不再使用才能外提；除法可能出错，必须一定执行
+            bool always_executed = dominates_exits(instr_block[instr]);
+            if (!always_executed && (live_at_exit.count(def) || instr->op == TAC_OP::DIV))
+                continue;
+
+            if (!operand_ready(instr->b, movable))
+                continue;
+
+            if (!operand_ready(instr->c, movable))
+                continue;
+
+            auto block = instr_block[instr];
+            auto decl_it = var_decl_in_loop.find(def);
+            auto decl_block = decl_it != var_decl_in_loop.end() ? instr_block[decl_it->second] : nullptr;
+            if (remaining[block] - (decl_block == block ? 2 : 1) < 1 || (decl_block && remaining[decl_block] < 2))
+                continue;
+            remaining[block]--;
+            if (decl_block)
+                remaining[decl_block]--;
+
+            movable.insert(instr);
+            progress = true;
+        }
+    }
+
+    if (movable.empty())
+        return false;
+
+    std::vector<std::shared_ptr<TAC>> ordered_to_move;
+    ordered_to_move.reserve(movable.size());
+    for (auto& instr : loop_instructions)
+    {
+        if (movable.find(instr) != movable.end())
+            ordered_to_move.push_back(instr);
+    }
+
+    std::unordered_set<std::shared_ptr<SYM>> moved_var_decls;
+
+    auto remove_from_block = [&](std::shared_ptr<TAC> node) {
+        if (!node)
+            return;
+
+        auto block_it = instr_block.find(node);
+        if (block_it == instr_block.end())
+            return;
+
+        auto block = block_it->second;
+        if (!block)
+            return;
+
+        if (node == block->start)
+            block->start = node->next;
+        if (node == block->end)
+            block->end = node->prev;
+
+        if (node->prev)
+            node->prev->next = node->next;
+        if (node->next)
+            node->next->prev = node->prev;
+
+        node->prev = nullptr;
+        node->next = nullptr;
+
+        if (!block->start)
+            block->start = block->end;
+    };
+
+    // 预头以 goto 结尾时插在 goto 之前，否则接在预头末尾
+    auto anchor = preheader->end->op == TAC_OP::GOTO ? preheader->end : nullptr;
+    auto insert_into_preheader = [&](std::shared_ptr<TAC> node) {
+        if (anchor)
+        {
+            node->prev = anchor->prev;
+            node->next = anchor;
+            if (anchor->prev)
+                anchor->prev->next = node;
+            anchor->prev = node;
+
+            if (preheader->start == anchor)
+                preheader->start = node;
+        }
+        else
+        {
+            auto position = preheader->end;
+            node->prev = position;
+            node->next = position->next;
+
+            if (position->next)
+                position->next->prev = node;
+            position->next = node;
+
+            preheader->end = node;
+        }
+
+        instr_block[node] = preheader;
+    };
+
+    for (auto& instr : ordered_to_move)
+    {
+        auto def = instr->get_def();
+        if (def)
+        {
+            auto decl_it = var_decl_in_loop.find(def);
+            if (decl_it != var_decl_in_loop.end() &&
+                moved_var_decls.insert(def).second)
+            {
+                auto decl = decl_it->second;
+                remove_from_block(decl);
+                insert_into_preheader(decl);
+                changed = true;
+            }
+        }
+
+        remove_from_block(instr);
+        insert_into_preheader(instr);
+        changed = true;
+    }
+
+    if (changed)
+    {
+        std::clog << "    Loop invariant code motion: found "
+                  << ordered_to_move.size() << " invariant instructions" << std::endl;
+    }
+
+    return changed;
+}
+
+// 新的临时变量，编号接在 TACGenerator 生成的 @t 之后
+std::shared_ptr<SYM> TACOptimizer::make_temp(DATA_TYPE type, SYM_SCOPE scope)
+{
+    if (next_temp < 0)
+    {
+        next_temp = 0;
+        for (auto tac = tac_first; tac; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::VAR && tac->a && tac->a->name.rfind("@t", 0) == 0 &&
+                tac->a->name.size() > 2 && tac->a->name.find_first_not_of("0123456789", 2) == std::string::npos)
+            {
+                next_temp = std::max(next_temp, std::stoi(tac->a->name.substr(2)) + 1);
+            }
+        }
+    }
+
+    auto sym = std::make_shared<SYM>();
+    sym->type = SYM_TYPE::VAR;
+    sym->data_type = type;
+    sym->name = "@t" + std::to_string(next_temp++);
+    sym->scope = scope;
+    return sym;
+}
+
+// 新的标签，编号接在已有的 L 标签和字符串标签之后；
+// BlockBuilder 插入预头时也会新建标签，所以每次都重新扫描
+std::shared_ptr<SYM> TACOptimizer::make_label(SYM_SCOPE scope)
+{
+    int next_label = 0;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::LABEL && tac->a && tac->a->name.size() > 1 && tac->a->name[0] == 'L' &&
+            tac->a->name.find_first_not_of("0123456789", 1) == std::string::npos)
+        {
+            next_label = std::max(next_label, std::stoi(tac->a->name.substr(1)) + 1);
+        }
+        for (auto sym : {tac->a, tac->b, tac->c})
+        {
+            if (sym && sym->type == SYM_TYPE::TEXT)
+                next_label = std::max(next_label, sym->label + 1);
+        }
+    }
+
+    auto sym = std::make_shared<SYM>();
+    sym->type = SYM_TYPE::LABEL;
+    sym->name = "L" + std::to_string(next_label);
+    sym->scope = scope;
+    return sym;
+}
+
+// 汇编中会出现的标签数：代码标签和字符串常量
+int TACOptimizer::count_labels() const
+{
+    int count = 0;
+    std::unordered_set<std::shared_ptr<SYM>> texts;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::LABEL)
+            count++;
+        for (auto sym : {tac->a, tac->b, tac->c})
+        {
+            if (sym && sym->type == SYM_TYPE::TEXT)
+                texts.insert(sym);
+        }
+    }
+    return count + static_cast<int>(texts.size());
+}
+
+std::shared_ptr<TAC> TACOptimizer::make_tac(TAC_OP op, std::shared_ptr<SYM> a,
+                                            std::shared_ptr<SYM> b, std::shared_ptr<SYM> c) const
+{
+    auto tac = std::make_shared<TAC>(op);
+    tac->a = a;
+    tac->b = b;
+    tac->c = c;
+    return tac;
+}
+
+void TACOptimizer::insert_after(std::shared_ptr<TAC> node, std::shared_ptr<TAC> position,
+                                std::shared_ptr<BasicBlock> block)
+{
+    node->prev = position;
+    node->next = position->next;
+    if (position->next)
+        position->next->prev = node;
+    position->next = node;
+
+    if (block->end == position)
+        block->end = node;
+}
+
+// 追加到块末尾；块以跳转结尾时插在跳转之前
+void TACOptimizer::append_to_block(std::shared_ptr<TAC> node, std::shared_ptr<BasicBlock> block)
+{
+    auto end = block->end;
+    if (end->op != TAC_OP::GOTO && end->op != TAC_OP::IFZ)
+    {
+        insert_after(node, end, block);
+        return;
+    }
+
+    node->prev = end->prev;
+    node->next = end;
+    if (end->prev)
+        end->prev->next = node;
+    end->prev = node;
+
+    if (block->start == end)
+        block->start = node;
+}
+
+// 删除块中的一条指令，块会因此变空时不删除
+bool TACOptimizer::remove_from_block(std::shared_ptr<TAC> node, std::shared_ptr<BasicBlock> block)
+{
+    if (block->start == node && block->end == node)
+        return false;
+
+    if (block->start == node)
+        block->start = node->next;
+    if (block->end == node)
+        block->end = node->prev;
+
+    if (node->prev)
+        node->prev->next = node->next;
+    if (node->next)
+        node->next->prev = node->prev;
+    node->prev = nullptr;
+    node->next = nullptr;
+    return true;
+}
+
+// 归纳变量强度削减：循环中的地址计算 base + i * k 改为随 i 一起递增的变量，
+// 乘法只在预头里算一次；i 只剩出口判断使用时，判断也改用新变量，并删除 i 的递增
+bool TACOptimizer::strength_reduction(std::shared_ptr<Loop> loop, const RangeAnalysis& ranges)
+{
+    auto preheader = loop->preheader;
+    if (!preheader || !preheader->end)
+        return false;
+
+    std::vector<std::shared_ptr<TAC>> loop_instructions;
+    std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> instr_block;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<TAC>>> defs_in_loop;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<TAC>>> uses_in_loop;
+
+    for (auto& block : loop->blocks)
+    {
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            loop_instructions.push_back(tac);
+            instr_block[tac] = block;
+            if (auto def = tac->get_def())
+                defs_in_loop[def].push_back(tac);
+            for (auto& use : tac->get_uses())
+                uses_in_loop[use].push_back(tac);
+            if (tac == block->end)
+                break;
+        }
+    }
+
+    auto is_scalar = [&](const std::shared_ptr<SYM>& sym) {
+        return sym && sym->type == SYM_TYPE::VAR && sym->data_type == DATA_TYPE::INT &&
+               !sym->is_array && !block_builder.is_memory_var(sym);
+    };
+    auto single_def = [&](const std::shared_ptr<SYM>& sym) -> std::shared_ptr<TAC> {
+        auto it = defs_in_loop.find(sym);
+        return it != defs_in_loop.end() && it->second.size() == 1 ? it->second.front() : nullptr;
+    };
+    auto in_loop_uses = [&](const std::shared_ptr<SYM>& sym) -> const std::vector<std::shared_ptr<TAC>>& {
+        static const std::vector<std::shared_ptr<TAC>> none;
+        auto it = uses_in_loop.find(sym);
+        return it != uses_in_loop.end() ? it->second : none;
+    };
+    // 在同一块中 from 之后（不含）能否走到 to
+    auto follows = [&](std::shared_ptr<TAC> from, std::shared_ptr<TAC> to) {
+        auto block = instr_block[from];
+        if (instr_block[to] != block)
+            return false;
+        for (auto tac = from; tac != block->end; )
+        {
+            tac = tac->next;
+            if (tac == to)
+                return true;
+        }
+        return false;
+    };
+
+    // 基本归纳变量：循环中唯一的定值是 i = i ± c，或 t = i ± c; i = t
+    struct InductionVar
+    {
+        std::shared_ptr<SYM> var, temp;
+        std::shared_ptr<TAC> step_tac, update;  // t = i ± c 和 i = t（直接形式时二者相同）
+        int step;
+    };
+    std::vector<InductionVar> ivs;
+
+    auto match_step = [&](std::shared_ptr<TAC> tac, std::shared_ptr<SYM> var, int& step) {
+        int value;
+        if (tac->op == TAC_OP::ADD && tac->b == var && tac->c->get_const_value(value))
+            step = value;
+        else if (tac->op == TAC_OP::ADD && tac->c == var && tac->b->get_const_value(value))
+            step = value;
+        else if (tac->op == TAC_OP::SUB && tac->b == var && tac->c->get_const_value(value))
+            step = -value;
+        else
+            return false;
+        return step != 0;
+    };
+
+    for (auto& [var, defs] : defs_in_loop)
+    {
+        if (defs.size() != 1 || !is_scalar(var))
+            continue;
+
+        InductionVar iv{var, nullptr, nullptr, defs.front(), 0};
+        if (match_step(iv.update, var, iv.step))
+        {
+            iv.step_tac = iv.update;
+        }
+        else if (iv.update->op == TAC_OP::COPY && is_scalar(iv.update->b))
+        {
+            auto step_tac = single_def(iv.update->b);
+            if (!step_tac || !match_step(step_tac, var, iv.step) || !follows(step_tac, iv.update))
+                continue;
+            iv.temp = iv.update->b;
+            iv.step_tac = step_tac;
+        }
+        else
+        {
+            continue;
+        }
+        ivs.push_back(iv);
+    }
+    if (ivs.empty())
+        return false;
+
+    // 循环中不变的基址：常量、循环外定值的变量，或循环中的 &x
+    auto invariant_base = [&](std::shared_ptr<SYM> sym) -> std::shared_ptr<SYM> {
+        int value;
+        if (sym->get_const_value(value))
+            return sym;
+        if (sym->type != SYM_TYPE::VAR || sym->is_array || sym->data_type == DATA_TYPE::STRUCT ||
+            block_builder.is_memory_var(sym))
+            return nullptr;
+        if (!defs_in_loop.count(sym))
+            return sym;
+        auto def = single_def(sym);
+        if (def && def->op == TAC_OP::ADDR)
+            return sym;
+        return nullptr;
+    };
+
+    // x 在指令 tac 处等于 i 的当前值加上一个不变量（没有时 offset 为空），
+    // 例如 x 就是 i，或在 i = t 之后的 t，或同一块中 x = i + n 且两者之间 i 没有变
+    struct IVRef
+    {
+        int iv;
+        std::shared_ptr<SYM> offset;
+    };
+    std::function<IVRef(std::shared_ptr<SYM>, std::shared_ptr<TAC>, bool)> iv_at =
+        [&](std::shared_ptr<SYM> x, std::shared_ptr<TAC> tac, bool allow_offset) -> IVRef {
+        for (size_t n = 0; n < ivs.size(); ++n)
+        {
+            if (x == ivs[n].var)
+                return {static_cast<int>(n), nullptr};
+            if (ivs[n].temp && x == ivs[n].temp && follows(ivs[n].update, tac))
+                return {static_cast<int>(n), nullptr};
+        }
+
+        auto def = single_def(x);
+        if (!allow_offset || !def || def->op != TAC_OP::ADD || !follows(def, tac))
+            return {-1, nullptr};
+        for (auto [var, other] : {std::pair{def->b, def->c}, std::pair{def->c, def->b}})
+        {
+            auto ref = iv_at(var, def, false);
+            if (ref.iv < 0 || !invariant_base(other))
+                continue;
+            auto update = ivs[ref.iv].update;
+            if (follows(def, update) && follows(update, tac))
+                continue;
+            return {ref.iv, other};
+        }
+        return {-1, nullptr};
+    };
+
+    const auto& block_in = block_builder.get_block_in();
+    auto live_at_exit = [&](const std::shared_ptr<SYM>& sym) {
+        for (auto& exit : loop->exits)
+        {
+            auto it = block_in.find(exit);
+            if (it != block_in.end() && it->second.live_vars.count(sym))
+                return true;
+        }
+        return false;
+    };
+
+    // 削减后的变量 r = base + k * (i + offset)，相同的组合共用一个；
+    // 每个都要占一个寄存器，所以一个循环里最多引入 MAX_REDUCED 个
+    struct Reduced
+    {
+        int iv;
+        int factor;
+        std::shared_ptr<SYM> base, offset;
+        std::shared_ptr<SYM> var;
+    };
+    const size_t MAX_REDUCED = 4;
+    std::vector<Reduced> reduced;
+    auto find_reduced = [&](int iv, int factor, std::shared_ptr<SYM> base, std::shared_ptr<SYM> offset) {
+        for (auto& r : reduced)
+        {
+            if (r.iv == iv && r.factor == factor && r.base == base && r.offset == offset)
+                return r.var;
+        }
+        if (reduced.size() >= MAX_REDUCED)
+            return std::shared_ptr<SYM>(nullptr);
+        auto var = make_temp(DATA_TYPE::INT, ivs[iv].var->scope);
+        reduced.push_back({iv, factor, base, offset, var});
+        return var;
+    };
+
+    // 候选：地址计算 m = x * k; a = base + m（m 只在这里使用），整个地址改成 r
+    struct Candidate
+    {
+        std::shared_ptr<TAC> mul, add;
+        int iv;
+        int factor;
+        std::shared_ptr<SYM> base, offset;
+    };
+    std::vector<Candidate> candidates;
+    for (auto& tac : loop_instructions)
+    {
+        int factor;
+        std::shared_ptr<SYM> x;
+        if (tac->op != TAC_OP::MUL || !tac->a)
+            continue;
+        if (tac->c->get_const_value(factor))
+            x = tac->b;
+        else if (tac->b->get_const_value(factor))
+            x = tac->c;
+        else
+            continue;
+
+        auto ref = iv_at(x, tac, true);
+        if (ref.iv < 0 || factor == 0)
+            continue;
+        // 削减变量每次迭代都要递增，不是每次迭代都执行的乘法削减后反而更慢
+        if (std::any_of(loop->latches.begin(), loop->latches.end(), [&](const std::shared_ptr<BasicBlock>& latch) {
+                return !block_builder.dominates(instr_block[tac], latch);
+            }))
+            continue;
+
+        auto m = tac->a;
+        auto& m_uses = in_loop_uses(m);
+        if (m_uses.size() != 1 || m_uses.front()->op != TAC_OP::ADD ||
+            single_def(m) != tac || live_at_exit(m) || !follows(tac, m_uses.front()))
+            continue;
+
+        auto add = m_uses.front();
+        auto base = invariant_base(add->b == m ? add->c : add->b);
+        auto update = ivs[ref.iv].update;
+        if (!base || (follows(tac, update) && follows(update, add)))
+            continue;
+        candidates.push_back({tac, add, ref.iv, factor, base, ref.offset});
+    }
+
+    // 线性函数判断替换：i 只用于递增、被削减的乘法和一个与常量比较的出口判断，
+    // 且出循环后不再使用时，比较改用削减变量，i 整个删掉。
+    // 界限 base + k * (bound + offset) 放在预头会常驻内存，每次比较都要多读一次，
+    // 所以只在它是常量，或 base 是 &x、可以在比较前用 &x 加常量算出来时才做
+    struct ExitTest
+    {
+        std::shared_ptr<TAC> compare;
+        const Candidate* target;
+        int limit;
+    };
+    auto exit_test = [&](int n) -> std::optional<ExitTest> {
+        auto& iv = ivs[n];
+        if (live_at_exit(iv.var) || (iv.temp && in_loop_uses(iv.temp).size() != 1))
+            return std::nullopt;
+
+        std::shared_ptr<TAC> compare = nullptr;
+        for (auto& use : in_loop_uses(iv.var))
+        {
+            if (use == iv.step_tac)
+                continue;
+            bool reduced_use = std::any_of(candidates.begin(), candidates.end(), [&](const Candidate& c) {
+                return c.mul == use && c.iv == n && !c.offset;
+            });
+            if (reduced_use)
+                continue;
+            bool is_compare = use->op == TAC_OP::LT || use->op == TAC_OP::LE ||
+                              use->op == TAC_OP::GT || use->op == TAC_OP::GE ||
+                              use->op == TAC_OP::EQ || use->op == TAC_OP::NE;
+            if (compare || !is_compare)
+                return std::nullopt;
+            compare = use;
+        }
+        int bound;
+        if (!compare || compare == instr_block[compare]->start ||
+            !(compare->b == iv.var ? compare->c : compare->b)->get_const_value(bound))
+            return std::nullopt;
+
+        // 任意一个 k > 0 的削减变量都保持比较的方向
+        for (auto& c : candidates)
+        {
+            int offset = 0, base = 0;
+            if (c.iv != n || c.factor <= 0 || (c.offset && !c.offset->get_const_value(offset)))
+                continue;
+            if (!c.base->get_const_value(base) && single_def(c.base) == nullptr)
+                continue;
+            long long limit = base + static_cast<long long>(c.factor) * (bound + offset);
+            // i 在比较处的范围已知时，r 在整个范围上都不能回绕，否则比较的结果会变
+            auto range = ranges.range_at(compare, iv.var);
+            bool wraps = !range.is_full() && (base + c.factor * (range.lo + offset) < INT_MIN ||
+                                              base + c.factor * (range.hi + offset) > INT_MAX);
+            if (limit >= 0 && limit <= INT_MAX && !wraps)
+                return ExitTest{compare, &c, static_cast<int>(limit)};
+        }
+        return std::nullopt;
+    };
+
+    // 跨块的变量不在寄存器里，r 每次迭代要多一次读写内存，只省下一次乘法并不划算。
+    // 只有 i 能被删掉，或至少三个地址共用 r 时才做削减
+    std::vector<std::optional<ExitTest>> exit_tests(ivs.size());
+    std::vector<bool> profitable(ivs.size(), false);
+    for (size_t n = 0; n < ivs.size(); ++n)
+    {
+        size_t count = std::count_if(candidates.begin(), candidates.end(),
+                                     [&](const Candidate& c) { return c.iv == static_cast<int>(n); });
+        if (count == 0)
+            continue;
+        exit_tests[n] = exit_test(static_cast<int>(n));
+        profitable[n] = count >= 3 || exit_tests[n];
+    }
+
+    bool changed = false;
+    std::unordered_set<std::shared_ptr<TAC>> removed;
+    for (auto& c : candidates)
+    {
+        if (!profitable[c.iv])
+            continue;
+        auto var = find_reduced(c.iv, c.factor, c.base, c.offset);
+        if (!var)
+            continue;
+
+        std::clog << "    Strength reduction: " << c.add->to_string() << std::endl;
+        c.add->op = TAC_OP::COPY;
+        c.add->b = var;
+        c.add->c = nullptr;
+        if (remove_from_block(c.mul, instr_block[c.mul]))
+            removed.insert(c.mul);
+        changed = true;
+    }
+
+    // 在预头中计算 base + k * (value + offset)
+    auto emit_in_preheader = [&](std::shared_ptr<SYM> result, const Reduced& r, std::shared_ptr<SYM> value) {
+        auto new_temp = [&]() {
+            auto temp = make_temp(DATA_TYPE::INT, r.var->scope);
+            append_to_block(make_tac(TAC_OP::VAR, temp), preheader);
+            return temp;
+        };
+        if (r.offset)
+        {
+            auto sum = new_temp();
+            append_to_block(make_tac(TAC_OP::ADD, sum, value, r.offset), preheader);
+            value = sum;
+        }
+        auto base = r.base;
+        if (base->type == SYM_TYPE::VAR && defs_in_loop.count(base))
+        {
+            // 循环里的 &x 在预头重新计算一次
+            auto addr = new_temp();
+            append_to_block(make_tac(TAC_OP::ADDR, addr, single_def(base)->b), preheader);
+            base = addr;
+        }
+        auto product = new_temp();
+        append_to_block(make_tac(TAC_OP::MUL, product, value, make_const(r.factor)), preheader);
+        append_to_block(make_tac(TAC_OP::VAR, result), preheader);
+        append_to_block(make_tac(TAC_OP::ADD, result, base, product), preheader);
+    };
+
+    // 预头中初始化 r，i 每次递增后 r 同步加上 k * step
+    for (auto& r : reduced)
+    {
+        auto& iv = ivs[r.iv];
+        emit_in_preheader(r.var, r, iv.var);
+
+        int delta = r.factor * iv.step;
+        auto bump = delta > 0 ? make_tac(TAC_OP::ADD, r.var, r.var, make_const(delta))
+                              : make_tac(TAC_OP::SUB, r.var, r.var, make_const(-delta));
+        insert_after(bump, iv.update, instr_block[iv.update]);
+        instr_block[bump] = instr_block[iv.update];
+    }
+
+    // 改写或删除之后仍在使用 var 的指令
+    auto current_uses = [&](const std::shared_ptr<SYM>& var) {
+        std::vector<std::shared_ptr<TAC>> uses;
+        for (auto& use : in_loop_uses(var))
+        {
+            auto vars = use->get_uses();
+            if (!removed.count(use) && std::find(vars.begin(), vars.end(), var) != vars.end())
+                uses.push_back(use);
+        }
+        return uses;
+    };
+
+    for (size_t n = 0; n < ivs.size(); ++n)
+    {
+        auto& iv = ivs[n];
+        auto& test = exit_tests[n];
+        if (!test)
+            continue;
+        auto target = test->target;
+        auto r = std::find_if(reduced.begin(), reduced.end(), [&](const Reduced& r) {
+            return r.iv == target->iv && r.factor == target->factor &&
+                   r.base == target->base && r.offset == target->offset;
+        });
+        auto uses = current_uses(iv.var);
+        if (r == reduced.end() || uses.size() != 2 ||
+            (uses[0] != test->compare && uses[1] != test->compare))
+            continue;
+
+        auto compare = test->compare;
+        auto block = instr_block[compare];
+        std::clog << "    Linear test replacement: " << compare->to_string() << std::endl;
+
+        auto limit = make_const(test->limit);
+        int base;
+        if (!r->base->get_const_value(base))
+        {
+            // 比较前重新取 &x，与 &x + limit 比较
+            auto addr = make_temp(DATA_TYPE::INT, r->var->scope);
+            auto end = make_temp(DATA_TYPE::INT, r->var->scope);
+            auto position = compare->prev;
+            for (auto& tac : {make_tac(TAC_OP::VAR, addr),
+                              make_tac(TAC_OP::ADDR, addr, single_def(r->base)->b),
+                              make_tac(TAC_OP::VAR, end),
+                              make_tac(TAC_OP::ADD, end, addr, limit)})
+            {
+                insert_after(tac, position, block);
+                position = tac;
+            }
+            limit = end;
+        }
 
-    std::vector<std::shared_ptr<TAC>> loop_instructions;
-    std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> instr_block;
-    std::unordered_map<std::string, std::vector<std::shared_ptr<TAC>>> defs_in_loop;
-    std::unordered_map<std::string, std::shared_ptr<TAC>> var_decl_in_loop;
+        if (compare->b == iv.var)
+        {
+            compare->b = r->var;
+            compare->c = limit;
+        }
+        else
+        {
+            compare->b = limit;
+            compare->c = r->var;
+        }
 
-    auto record_instruction = [&](std::shared_ptr<BasicBlock> block, std::shared_ptr<TAC> tac) {
-        instr_block[tac] = block;
-        loop_instructions.push_back(tac);
+        remove_from_block(iv.update, instr_block[iv.update]);
+        if (iv.step_tac != iv.update)
+            remove_from_block(iv.step_tac, instr_block[iv.step_tac]);
+        changed = true;
+    }
 
-        if (tac->op == TAC_OP::VAR && tac->a && tac->a->type == SYM_TYPE::VAR)
+    return changed;
+}
+
+// 循环展开：只处理 header 只有一次比较、循环体是一个基本块的计数循环
+//   L: t = i < n; ifz t goto E; body; i = i + c; goto L
+// 迭代次数是小常数时完全展开；否则展开 factor 份，新的 header 判断还剩 factor 次迭代，
+// 不足时进入原循环执行余下的迭代
+bool TACOptimizer::loop_unrolling(std::shared_ptr<Loop> loop)
+{
+    auto header = loop->header;
+    auto preheader = loop->preheader;
+    if (!preheader || loop->blocks.size() != 2 || !loop->children.empty() ||
+        header->start->op != TAC_OP::LABEL || unrolled_loops.count(header->start))
+        return false;
+    auto body = loop->blocks.front() == header ? loop->blocks.back() : loop->blocks.front();
+    if (body->end->op != TAC_OP::GOTO || body->end->a->name != header->start->a->name)
+        return false;
+
+    // header 只有变量声明、比较和 ifz
+    auto branch = header->end;
+    if (branch->op != TAC_OP::IFZ)
+        return false;
+    std::shared_ptr<TAC> compare = nullptr;
+    for (auto tac = header->start->next; tac != branch; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::VAR)
+            continue;
+        if (compare)
+            return false;
+        compare = tac;
+    }
+    if (!compare || compare->a != branch->b)
+        return false;
+
+    TAC_OP op = compare->op;
+    if (op != TAC_OP::LT && op != TAC_OP::LE && op != TAC_OP::GT && op != TAC_OP::GE)
+        return false;
+
+    // 循环体中不能有其他出口或标签
+    bool has_call = false;
+    std::vector<std::shared_ptr<TAC>> body_tacs;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<TAC>>> defs;
+    for (auto tac = body->start; tac != body->end; tac = tac->next)
+    {
+        switch (tac->op)
+        {
+        case TAC_OP::LABEL:
+        case TAC_OP::GOTO:
+        case TAC_OP::IFZ:
+        case TAC_OP::RETURN:
+        case TAC_OP::BEGINFUNC:
+        case TAC_OP::ENDFUNC:
+            return false;
+        case TAC_OP::CALL:
+            has_call = true;
+            break;
+        default:
+            break;
+        }
+        body_tacs.push_back(tac);
+        if (auto def = tac->get_def())
+            defs[def].push_back(tac);
+    }
+
+    // 统一成 i op n 的形式
+    auto is_invariant = [&](const std::shared_ptr<SYM>& sym) {
+        int value;
+        return sym->get_const_value(value) ||
+               (sym->type == SYM_TYPE::VAR && !sym->is_array && !block_builder.is_memory_var(sym) &&
+                !defs.count(sym));
+    };
+    auto iv = compare->b, bound = compare->c;
+    if (!is_invariant(bound))
+    {
+        std::swap(iv, bound);
+        op = op == TAC_OP::LT ? TAC_OP::GT : op == TAC_OP::LE ? TAC_OP::GE : op == TAC_OP::GT ? TAC_OP::LT : TAC_OP::LE;
+    }
+    if (!is_invariant(bound) || iv->type != SYM_TYPE::VAR || iv->data_type != DATA_TYPE::INT ||
+        iv->is_array || block_builder.is_memory_var(iv))
+        return false;
+
+    // i 在循环中唯一的定值是 i = i ± c，或 t = i ± c; i = t
+    auto it = defs.find(iv);
+    if (it == defs.end() || it->second.size() != 1)
+        return false;
+    auto update = it->second.front();
+    auto step_tac = update;
+    if (update->op == TAC_OP::COPY)
+    {
+        auto temp = defs.find(update->b);
+        if (temp == defs.end() || temp->second.size() != 1)
+            return false;
+        step_tac = temp->second.front();
+    }
+    int step = 0, value;
+    if (step_tac->op == TAC_OP::ADD && step_tac->b == iv && step_tac->c->get_const_value(value))
+        step = value;
+    else if (step_tac->op == TAC_OP::ADD && step_tac->c == iv && step_tac->b->get_const_value(value))
+        step = value;
+    else if (step_tac->op == TAC_OP::SUB && step_tac->b == iv && step_tac->c->get_const_value(value))
+        step = -value;
+    bool upward = op == TAC_OP::LT || op == TAC_OP::LE;
+    if (step == 0 || (step > 0) != upward)
+        return false;
+
+    int body_size = 0;
+    for (auto& tac : body_tacs)
+    {
+        if (tac->op != TAC_OP::VAR)
+            body_size++;
+    }
+
+    // 迭代次数：i 在预头中被赋为常量且 n 是常量时可以算出来
+    long long trips = -1;
+    int init, limit;
+    if (bound->get_const_value(limit))
+    {
+        for (auto tac = preheader->end; tac; tac = tac->prev)
+        {
+            if (tac->get_def() == iv)
+            {
+                if (tac->op == TAC_OP::COPY && tac->b->get_const_value(init))
+                {
+                    long long distance = upward ? static_cast<long long>(limit) - init
+                                                : static_cast<long long>(init) - limit;
+                    if (op == TAC_OP::LE || op == TAC_OP::GE)
+                        distance++;
+                    long long stride = step > 0 ? step : -static_cast<long long>(step);
+                    trips = distance <= 0 ? 0 : (distance + stride - 1) / stride;
+                }
+                break;
+            }
+            if (tac == preheader->start)
+                break;
+        }
+    }
+
+    bool full = trips >= 0 && trips <= unroll_options.full_trip_limit &&
+                trips * body_size <= unroll_options.size_budget;
+    // 部分展开：调用本身的开销远大于省下的判断和跳转，不值得展开。
+    // 迭代次数已知时优先选能整除它的倍数，余下的迭代太多就不展开
+    int factor = unroll_options.factor;
+    while (factor >= 2 && factor * body_size > unroll_options.size_budget)
+        factor--;
+    bool exact = false;
+    if (trips >= 0)
+    {
+        int divisor = factor;
+        while (divisor >= 2 && trips % divisor != 0)
+            divisor--;
+        exact = divisor >= 2;
+        if (exact)
+            factor = divisor;
+        else if (trips < 2 * factor)
+            factor = 0;
+    }
+    if (!full && (factor < 2 || has_call || count_labels() >= unroll_options.label_limit))
+        return false;
+
+    // 只在一次迭代内使用的临时变量每份换一个名字：在循环体中先定值，header 入口不活跃
+    const auto& header_in = block_builder.get_block_in().at(header).live_vars;
+    std::unordered_set<std::shared_ptr<SYM>> seen, private_temps;
+    for (auto& tac : body_tacs)
+    {
+        if (tac->op == TAC_OP::VAR)
+            continue;
+        for (auto& use : tac->get_uses())
+            seen.insert(use);
+        auto def = tac->get_def();
+        if (def && !seen.count(def) && !header_in.count(def) && def->name.rfind("@t", 0) == 0 &&
+            !block_builder.is_memory_var(def))
+        {
+            private_temps.insert(def);
+        }
+        if (def)
+            seen.insert(def);
+    }
+
+    // 复制一份循环体，插在 position 之后，返回最后一条指令
+    auto copy_body = [&](std::shared_ptr<TAC> position, std::shared_ptr<BasicBlock> block) {
+        std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<SYM>> rename;
+        for (auto& temp : private_temps)
+        {
+            rename[temp] = make_temp(temp->data_type, temp->scope);
+            auto decl = make_tac(TAC_OP::VAR, rename[temp]);
+            insert_after(decl, position, block);
+            position = decl;
+        }
+        auto renamed = [&](const std::shared_ptr<SYM>& sym) {
+            auto r = sym ? rename.find(sym) : rename.end();
+            return r != rename.end() ? r->second : sym;
+        };
+        for (auto& tac : body_tacs)
+        {
+            if (tac->op == TAC_OP::VAR)
+                continue;
+            auto copy = make_tac(tac->op, renamed(tac->a), renamed(tac->b), renamed(tac->c));
+            insert_after(copy, position, block);
+            position = copy;
+        }
+        return position;
+    };
+
+    if (full)
+    {
+        // header 的判断去掉，循环体复制 trips 份，最后跳到出口
+        std::clog << "    Fully unrolled loop at block " << header->id << " (" << trips << " iterations)" << std::endl;
+        remove_from_block(compare, header);
+        remove_from_block(branch, header);
+        auto position = header->end;
+        for (long long n = 0; n < trips; ++n)
+            position = copy_body(position, header);
+        auto exit = make_tac(TAC_OP::GOTO, branch->a);
+        insert_after(exit, position, header);
+
+        // 原循环体整个摘掉
+        auto before = body->start->prev, after = body->end->next;
+        before->next = after;
+        if (after)
+            after->prev = before;
+        return true;
+    }
+
+    // 迭代次数是 factor 的倍数时不需要余数循环，直接在循环体里多复制几份
+    if (exact)
+    {
+        std::clog << "    Unrolled loop at block " << header->id << " by " << factor << std::endl;
+        auto position = body->end->prev;
+        for (int n = 1; n < factor; ++n)
+            position = copy_body(position, body);
+        unrolled_loops.insert(header->start);
+        return true;
+    }
+
+    // 新 header：L': p = i + (factor - 1) * c; g = p op n; ifz g goto L; body * factor; goto L'
+    std::clog << "    Unrolled loop at block " << header->id << " by " << factor << std::endl;
+    auto scope = header->start->a->scope;
+    auto label = make_label(scope);
+    auto probe = make_temp(DATA_TYPE::INT, iv->scope);
+    auto guard = make_temp(DATA_TYPE::INT, compare->a->scope);
+    int ahead = (factor - 1) * step;
+
+    // 预头跳到 L 的改为跳到 L'；顺序流入的直接进入 L'
+    if (preheader->end->op == TAC_OP::GOTO && preheader->end->a->name == header->start->a->name)
+        preheader->end->a = label;
+
+    auto entry = make_tac(TAC_OP::LABEL, label);
+    auto position = header->start->prev;
+    for (auto& tac : {entry,
+                      make_tac(TAC_OP::VAR, probe),
+                      ahead > 0 ? make_tac(TAC_OP::ADD, probe, iv, make_const(ahead))
+                                : make_tac(TAC_OP::SUB, probe, iv, make_const(-ahead)),
+                      make_tac(TAC_OP::VAR, guard),
+                      make_tac(op, guard, probe, bound),
+                      make_tac(TAC_OP::IFZ, header->start->a, guard)})
+    {
+        insert_after(tac, position, preheader);
+        position = tac;
+    }
+    for (int n = 0; n < factor; ++n)
+        position = copy_body(position, preheader);
+    insert_after(make_tac(TAC_OP::GOTO, label), position, preheader);
+
+    unrolled_loops.insert(header->start);
+    unrolled_loops.insert(entry);
+    return true;
+}
+
+// 循环旋转：把顶部判断的循环改成入口判断一次、底部判断的形式
+//   L: cond; ifz t goto E; body; goto L; E:
+// =>
+//   cond'; ifz t' goto E; L': body; L: cond; ifz !t goto L'; E:
+// L 留在底部判断处，continue 跳到 L 仍然会重新判断；循环体结尾的 goto L 变成跳到下一条，随后被删掉
+bool TACOptimizer::loop_rotation(std::shared_ptr<Loop> loop)
+{
+    auto header = loop->header;
+    auto preheader = loop->preheader;
+    if (!preheader || loop->blocks.front() != header || header->start->op != TAC_OP::LABEL ||
+        header->end->op != TAC_OP::IFZ)
+        return false;
+
+    // 预头顺序流入 header，最后一块以 goto L 结尾且紧跟出口标签
+    auto branch = header->end;
+    auto header_label = header->start->a;
+    auto last = loop->blocks.back();
+    if (preheader->end->next != header->start || preheader->end->op == TAC_OP::GOTO || last == header ||
+        last->end->op != TAC_OP::GOTO || last->end->a->name != header_label->name)
+        return false;
+    auto exit = last->end->next;
+    if (!exit || exit->op != TAC_OP::LABEL || exit->a->name != branch->a->name)
+        return false;
+
+    // 判断部分要复制一份，只处理短的
+    std::vector<std::shared_ptr<TAC>> code;
+    for (auto tac = header->start->next; tac != branch; tac = tac->next)
+    {
+        if (tac->op != TAC_OP::VAR)
+            code.push_back(tac);
+    }
+    if (code.size() > 8 || count_labels() + 2 > unroll_options.label_limit)
+        return false;
+
+    std::clog << "    Rotated loop at block " << header->id << std::endl;
+
+    // 入口判断：header 中定值、出了 header 就不再使用的临时变量换成新名字，
+    // 这样两处比较都只有一次定值和一次使用，仍能和 ifz 合并
+    const auto& header_out = block_builder.get_block_out().at(header).live_vars;
+    std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<SYM>> rename;
+    auto position = preheader->end;
+    for (auto& tac : code)
+    {
+        auto def = tac->get_def();
+        if (def && !header_out.count(def) && def->name.rfind("@t", 0) == 0 && !rename.count(def))
+        {
+            rename[def] = make_temp(def->data_type, def->scope);
+            auto decl = make_tac(TAC_OP::VAR, rename[def]);
+            insert_after(decl, position, preheader);
+            position = decl;
+        }
+    }
+    auto renamed = [&](const std::shared_ptr<SYM>& sym) {
+        auto it = sym ? rename.find(sym) : rename.end();
+        return it != rename.end() ? it->second : sym;
+    };
+    auto body_label = make_label(header_label->scope);
+    std::vector<std::shared_ptr<TAC>> guard;
+    for (auto& tac : code)
+        guard.push_back(make_tac(tac->op, renamed(tac->a), renamed(tac->b), renamed(tac->c)));
+    guard.push_back(make_tac(TAC_OP::IFZ, branch->a, renamed(branch->b)));
+    guard.push_back(make_tac(TAC_OP::LABEL, body_label));
+    for (auto& tac : guard)
+    {
+        insert_after(tac, position, preheader);
+        position = tac;
+    }
+
+    // header 整体移到循环体之后、出口之前
+    auto before = header->start->prev, after = header->end->next;
+    before->next = after;
+    after->prev = before;
+    last->end->next = header->start;
+    header->start->prev = last->end;
+    header->end->next = exit;
+    exit->prev = header->end;
+
+    // 底部判断条件成立时回到循环体：比较只给 ifz 用就直接取反，否则补一条 t == 0
+    auto cond = branch->b;
+    auto compare = code.empty() ? nullptr : code.back();
+    bool single_use = compare && compare->a == cond && rename.count(cond);
+    static const std::unordered_map<TAC_OP, TAC_OP> negate = {
+        {TAC_OP::LT, TAC_OP::GE}, {TAC_OP::GE, TAC_OP::LT}, {TAC_OP::LE, TAC_OP::GT},
+        {TAC_OP::GT, TAC_OP::LE}, {TAC_OP::EQ, TAC_OP::NE}, {TAC_OP::NE, TAC_OP::EQ}};
+    if (single_use && negate.count(compare->op))
+    {
+        compare->op = negate.at(compare->op);
+    }
+    else
+    {
+        auto inverse = make_temp(DATA_TYPE::INT, cond->scope);
+        insert_after(make_tac(TAC_OP::VAR, inverse), branch->prev, header);
+        insert_after(make_tac(TAC_OP::EQ, inverse, cond, make_const(0)), branch->prev, header);
+        branch->b = inverse;
+    }
+    branch->a = body_label;
+
+    return true;
+}
+
+// 尾递归消除：return f(...) 调用的是自己时，先把实参算到新的临时变量里，
+// 再赋给形参，然后跳回形参之后的入口标签，递归变成循环，不再每层占一个栈帧
+bool TACOptimizer::tail_recursion_elimination()
+{
+    bool changed = false;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op != TAC_OP::BEGINFUNC || !tac->prev || tac->prev->op != TAC_OP::LABEL)
+            continue;
+        auto name = tac->prev->a->name;
+        std::vector<std::shared_ptr<SYM>> formals;
+        auto entry = tac;
+        for (; entry->next && entry->next->op == TAC_OP::FORMAL; entry = entry->next)
+            formals.push_back(entry->next->a);
+
+        std::shared_ptr<SYM> entry_label = nullptr;
+        for (tac = entry->next; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+        {
+            if (tac->op != TAC_OP::CALL || tac->b->name != name)
+                continue;
+
+            // call 之后只隔着声明和标签就返回它的结果
+            auto ret = tac->next;
+            while (ret && (ret->op == TAC_OP::VAR || ret->op == TAC_OP::LABEL))
+                ret = ret->next;
+            if (!ret || !((ret->op == TAC_OP::RETURN && ret->a == tac->a) || ret->op == TAC_OP::ENDFUNC))
+                continue;
+
+            std::vector<std::shared_ptr<TAC>> actuals;
+            auto first = tac;
+            while (first->prev && first->prev->op == TAC_OP::ACTUAL)
+            {
+                first = first->prev;
+                actuals.insert(actuals.begin(), first);
+            }
+            if (actuals.size() != formals.size())
+                continue;
+
+            std::clog << "    Eliminated tail recursion in " << name << std::endl;
+            if (!entry_label)
+            {
+                entry_label = make_label(SYM_SCOPE::LOCAL);
+                auto label = make_tac(TAC_OP::LABEL, entry_label);
+                label->prev = entry;
+                label->next = entry->next;
+                entry->next->prev = label;
+                entry->next = label;
+            }
+
+            // 实参之间可能互相引用形参，先全部算到临时变量再赋值
+            std::vector<std::shared_ptr<TAC>> code;
+            std::vector<std::shared_ptr<SYM>> values;
+            for (size_t i = 0; i < actuals.size(); i++)
+            {
+                auto value = actuals[i]->a;
+                if (value != formals[i] && value->type == SYM_TYPE::VAR)
+                {
+                    auto temp = make_temp(formals[i]->data_type, SYM_SCOPE::LOCAL);
+                    code.push_back(make_tac(TAC_OP::VAR, temp));
+                    code.push_back(make_tac(TAC_OP::COPY, temp, value));
+                    value = temp;
+                }
+                values.push_back(value);
+            }
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                if (values[i] != formals[i])
+                    code.push_back(make_tac(TAC_OP::COPY, formals[i], values[i]));
+            }
+            code.push_back(make_tac(TAC_OP::GOTO, entry_label));
+
+            // 替换实参和 call，后面的 return 可能还有别的路径到达，留给不可达代码消除
+            auto before = first->prev;
+            auto after = tac->next;
+            auto position = before;
+            for (auto& node : code)
+            {
+                node->prev = position;
+                position->next = node;
+                position = node;
+            }
+            position->next = after;
+            after->prev = position;
+            tac = position;
+            changed = true;
+        }
+        if (!tac)
+            break;
+    }
+    return changed;
+}
+
+// 函数内联：把叶子函数的 TAC 复制到调用点，局部变量和临时变量换成新的，形参改成复制实参。
+// VM 上一次调用要传参、跳转、调整 BP、保存恢复寄存器，按节省的周期和调用点所在循环的深度估算收益，
+// 超过代码增长的代价才内联。只内联叶子函数，每轮之后被内联过的函数可能成为新的叶子，自底向上做几轮
+bool TACOptimizer::function_inlining()
+{
+    const int CALL_CYCLES = 24;      // 跳转、返回地址、BP 调整，以及调用前后寄存器的写回和重新装入
+    const int ARG_CYCLES = 2;        // 每个参数送进寄存器
+    const int SIZE_WEIGHT = 4;       // 每条复制出来的指令折算的周期
+    const int MAX_CALLEE_SIZE = 60;
+    const int MAX_GROWTH = 400;      // 整个程序新增指令数的上限
+    const int MAX_ROUNDS = 3;
+
+    struct Callee
+    {
+        std::shared_ptr<TAC> label, end;
+        std::vector<std::shared_ptr<SYM>> formals;
+        int size = 0;       // 不算声明和标签的指令数
+        int labels = 0;
+        bool leaf = true;
+        bool inlined = false;
+    };
+
+    bool changed = false;
+    int growth = 0;
+    std::unordered_set<std::string> inlined_names;
+    for (int round = 0; round < MAX_ROUNDS; round++)
+    {
+        block_builder.build();
+        block_builder.build_loops();
+
+        std::unordered_map<std::string, Callee> callees;
+        std::unordered_map<std::string, int> call_sites;
+        for (auto tac = tac_first; tac; tac = tac->next)
+        {
+            if (tac->op != TAC_OP::BEGINFUNC || !tac->prev || tac->prev->op != TAC_OP::LABEL)
+                continue;
+            auto& callee = callees[tac->prev->a->name];
+            callee.label = tac->prev;
+            for (tac = tac->next; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+            {
+                if (tac->op == TAC_OP::FORMAL)
+                    callee.formals.push_back(tac->a);
+                else if (tac->op == TAC_OP::LABEL)
+                    callee.labels++;
+                else if (tac->op != TAC_OP::VAR)
+                    callee.size++;
+                if (tac->op == TAC_OP::CALL)
+                {
+                    callee.leaf = false;
+                    call_sites[tac->b->name]++;
+                }
+            }
+            callee.end = tac;
+            if (!tac)
+                break;
+        }
+
+        // 调用点按执行频率估算收益，热的先内联
+        struct Site
+        {
+            std::shared_ptr<TAC> call;
+            std::string caller;
+            int benefit;
+        };
+        std::vector<Site> sites;
+        for (const auto& func : block_builder.get_functions())
+        {
+            for (const auto& block : func.blocks)
+            {
+                auto loop = block_builder.get_loop(block);
+                int frequency = 1;
+                for (int depth = loop ? loop->depth : 0; depth > 0 && frequency < 1000; depth--)
+                    frequency *= 10;
+                for (auto tac = block->start; tac; tac = tac->next)
+                {
+                    if (tac->op == TAC_OP::CALL && callees.count(tac->b->name))
+                    {
+                        int nargs = static_cast<int>(callees[tac->b->name].formals.size());
+                        sites.push_back({tac, func.name, (CALL_CYCLES + ARG_CYCLES * nargs) * frequency});
+                    }
+                    if (tac == block->end)
+                        break;
+                }
+            }
+        }
+        std::stable_sort(sites.begin(), sites.end(), [](const Site& x, const Site& y) {
+            return x.benefit > y.benefit;
+        });
+
+        bool round_changed = false;
+        int labels = count_labels();
+        for (auto& site : sites)
+        {
+            auto& name = site.call->b->name;
+            auto& callee = callees[name];
+            if (!callee.leaf || name == "main" || name == site.caller || callee.size > MAX_CALLEE_SIZE)
+                continue;
+            // 只被调用一次的函数内联后整个删掉，不算增长
+            bool once = call_sites[name] == 1;
+            if (!once && (site.benefit < SIZE_WEIGHT * callee.size || growth + callee.size > MAX_GROWTH))
+                continue;
+            if (labels + callee.labels + 1 > unroll_options.label_limit)
+                continue;
+
+            // 实参紧挨在 call 之前，个数要和形参一致
+            std::vector<std::shared_ptr<TAC>> actuals;
+            auto first = site.call;
+            while (first->prev && first->prev->op == TAC_OP::ACTUAL)
+            {
+                first = first->prev;
+                actuals.insert(actuals.begin(), first);
+            }
+            if (actuals.size() != callee.formals.size())
+                continue;
+
+            std::clog << "    Inlined " << name << " into " << site.caller << std::endl;
+
+            // 局部变量、形参和临时变量各复制一份，标签重新编号
+            std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<SYM>> rename;
+            std::unordered_map<std::string, std::shared_ptr<SYM>> rename_label;
+            int next_label = std::stoi(make_label(SYM_SCOPE::LOCAL)->name.substr(1));
+            auto new_label = [&]() {
+                auto label = make_label(SYM_SCOPE::LOCAL);
+                label->name = "L" + std::to_string(next_label++);
+                return label;
+            };
+            auto renamed = [&](const std::shared_ptr<SYM>& sym) -> std::shared_ptr<SYM> {
+                if (!sym)
+                    return sym;
+                if (sym->type == SYM_TYPE::LABEL)
+                {
+                    auto& label = rename_label[sym->name];
+                    if (!label)
+                        label = new_label();
+                    return label;
+                }
+                auto it = rename.find(sym);
+                if (it != rename.end())
+                    return it->second;
+                if (sym->type != SYM_TYPE::VAR || sym->scope == SYM_SCOPE::GLOBAL)
+                    return sym;
+                auto var = std::make_shared<SYM>(*sym);
+                var->scope = SYM_SCOPE::LOCAL;
+                var->offset = -1;
+                if (sym->name.rfind("@t", 0) == 0)
+                    var->name = make_temp(sym->data_type, SYM_SCOPE::LOCAL)->name;
+                return rename[sym] = var;
+            };
+
+            std::vector<std::shared_ptr<TAC>> code;
+            for (size_t i = 0; i < actuals.size(); i++)
+            {
+                auto formal = renamed(callee.formals[i]);
+                code.push_back(make_tac(TAC_OP::VAR, formal));
+                code.push_back(make_tac(TAC_OP::COPY, formal, actuals[i]->a));
+            }
+            // return 改成给调用结果赋值再跳到出口，最后一条 return 直接落到出口
+            std::shared_ptr<SYM> exit = nullptr;
+            auto ret = site.call->a;
+            auto last = callee.end->prev;
+            for (auto tac = callee.label->next->next; tac != callee.end; tac = tac->next)
+            {
+                if (tac->op == TAC_OP::FORMAL)
+                    continue;
+                if (tac->op != TAC_OP::RETURN)
+                {
+                    code.push_back(make_tac(tac->op, renamed(tac->a), renamed(tac->b), renamed(tac->c)));
+                    continue;
+                }
+                if (ret && tac->a)
+                    code.push_back(make_tac(TAC_OP::COPY, ret, renamed(tac->a)));
+                if (tac != last)
+                {
+                    if (!exit)
+                        exit = new_label();
+                    code.push_back(make_tac(TAC_OP::GOTO, exit));
+                }
+            }
+            if (exit)
+                code.push_back(make_tac(TAC_OP::LABEL, exit));
+
+            // 用复制出来的代码替换实参和 call
+            auto before = first->prev, after = site.call->next;
+            auto position = before;
+            for (auto& tac : code)
+            {
+                tac->prev = position;
+                position->next = tac;
+                position = tac;
+            }
+            position->next = after;
+            if (after)
+                after->prev = position;
+
+            labels += callee.labels + (exit ? 1 : 0);
+            if (!once)
+                growth += callee.size;
+            callee.inlined = true;
+            call_sites[name]--;
+            inlined_names.insert(name);
+            round_changed = true;
+        }
+
+        // 不再被调用的函数删掉，给后面的轮次腾出标签
+        for (auto& [name, callee] : callees)
+        {
+            if (!callee.inlined || call_sites[name] > 0 || callee.label == tac_first)
+                continue;
+            auto before = callee.label->prev, after = callee.end->next;
+            before->next = after;
+            if (after)
+                after->prev = before;
+            std::clog << "    Removed function " << name << std::endl;
+        }
+
+        if (!round_changed)
+            break;
+        changed = true;
+    }
+
+    return changed;
+}
+
+// 过程间常量传播：沿调用图把常量实参传进被调函数，把常量返回值传回调用点。
+// 所有调用点都传同一个常量的形参（自己递归调用时原样传下去的也算），直接在函数入口绑定成这个常量并删掉实参；
+// 只有部分调用点传常量时，为热的调用点克隆一份特化的函数，克隆新增的指令数受预算限制。
+// SCCP 之后实参和返回值里会出现新的常量，所以每轮迭代开始都做一次
+bool TACOptimizer::interprocedural_constant_propagation()
+{
+    const int ARG_CYCLES = 2;           // 每个参数送进寄存器
+    const int USE_CYCLES = 10;          // 形参的每处使用，跨块时要从内存装入
+    const int SIZE_WEIGHT = 4;          // 每条复制出来的指令折算的周期
+    const int MAX_CLONE_GROWTH = 300;   // 整个程序克隆出的指令数上限
+
+    struct Function
+    {
+        std::shared_ptr<TAC> label, end;
+        std::vector<std::shared_ptr<SYM>> formals;
+        std::vector<std::shared_ptr<TAC>> calls;    // 调用它的 call
+        int size = 0;       // 不算声明和标签的指令数
+        int labels = 0;
+    };
+
+    block_builder.build();
+    block_builder.build_loops();
+
+    std::unordered_map<std::string, Function> functions;
+    std::vector<std::string> order;
+    std::vector<std::shared_ptr<TAC>> calls;
+    std::unordered_map<std::shared_ptr<TAC>, std::string> caller_of;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op != TAC_OP::BEGINFUNC || !tac->prev || tac->prev->op != TAC_OP::LABEL)
+            continue;
+        auto name = tac->prev->a->name;
+        auto& func = functions[name];
+        func.label = tac->prev;
+        order.push_back(name);
+        for (tac = tac->next; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::FORMAL)
+                func.formals.push_back(tac->a);
+            else if (tac->op == TAC_OP::LABEL)
+                func.labels++;
+            else if (tac->op != TAC_OP::VAR)
+                func.size++;
+            if (tac->op == TAC_OP::CALL)
+            {
+                calls.push_back(tac);
+                caller_of[tac] = name;
+            }
+        }
+        func.end = tac;
+        if (!tac)
+            break;
+    }
+    for (auto& call : calls)
+    {
+        auto it = functions.find(call->b->name);
+        if (it != functions.end())
+            it->second.calls.push_back(call);
+    }
+
+    // 调用点的执行频率按所在循环的深度估算
+    std::unordered_map<std::shared_ptr<TAC>, int> frequency;
+    for (const auto& func : block_builder.get_functions())
+    {
+        for (const auto& block : func.blocks)
+        {
+            auto loop = block_builder.get_loop(block);
+            int freq = 1;
+            for (int depth = loop ? loop->depth : 0; depth > 0 && freq < 1000; depth--)
+                freq *= 10;
+            for (auto tac = block->start; tac; tac = tac->next)
+            {
+                if (tac->op == TAC_OP::CALL)
+                    frequency[tac] = freq;
+                if (tac == block->end)
+                    break;
+            }
+        }
+    }
+
+    auto unlink = [](std::shared_ptr<TAC> tac) {
+        tac->prev->next = tac->next;
+        if (tac->next)
+            tac->next->prev = tac->prev;
+        tac->prev = tac->next = nullptr;
+    };
+    auto splice_after = [](std::shared_ptr<TAC> position, const std::vector<std::shared_ptr<TAC>>& code) {
+        auto after = position->next;
+        for (auto& tac : code)
+        {
+            tac->prev = position;
+            position->next = tac;
+            position = tac;
+        }
+        position->next = after;
+        if (after)
+            after->prev = position;
+    };
+    // 实参紧挨在 call 之前
+    auto actuals_of = [](std::shared_ptr<TAC> call) {
+        std::vector<std::shared_ptr<TAC>> actuals;
+        for (auto prev = call->prev; prev && prev->op == TAC_OP::ACTUAL; prev = prev->prev)
+            actuals.insert(actuals.begin(), prev);
+        return actuals;
+    };
+    // 只绑定整数和字符形参
+    auto bindable = [](const std::shared_ptr<SYM>& formal) {
+        return !formal->is_pointer && !formal->is_array &&
+               (formal->data_type == DATA_TYPE::INT || formal->data_type == DATA_TYPE::CHAR);
+    };
+    // 调用点各形参对应的常量，实参不是常量或个数不对的位置为空
+    auto constants_at = [&](std::shared_ptr<TAC> call, const Function& callee) {
+        std::vector<std::shared_ptr<SYM>> values(callee.formals.size());
+        auto actuals = actuals_of(call);
+        if (actuals.size() != values.size())
+            return values;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            int value;
+            if (bindable(callee.formals[i]) && actuals[i]->a->get_const_value(value))
+                values[i] = make_const(value, callee.formals[i]->data_type);
+        }
+        return values;
+    };
+    auto same_constant = [](const std::shared_ptr<SYM>& x, const std::shared_ptr<SYM>& y) {
+        int u, v;
+        return x->get_const_value(u) && y->get_const_value(v) && u == v;
+    };
+    // 去掉绑定了常量的实参
+    auto drop_actuals = [&](std::shared_ptr<TAC> call, const std::vector<std::shared_ptr<SYM>>& values) {
+        auto actuals = actuals_of(call);
+        for (size_t i = 0; i < actuals.size() && i < values.size(); i++)
+        {
+            if (values[i])
+                unlink(actuals[i]);
+        }
+    };
+    // 绑定了常量的形参改成局部变量，放在剩下的形参之后并赋初值
+    auto bind_formals = [&](std::shared_ptr<TAC> label, const std::vector<std::shared_ptr<SYM>>& values) {
+        auto last = label->next;
+        std::vector<std::shared_ptr<TAC>> code;
+        size_t i = 0;
+        for (auto tac = last->next; tac && tac->op == TAC_OP::FORMAL; i++)
         {
-            var_decl_in_loop[tac->a->name] = tac;
+            auto next = tac->next;
+            if (i < values.size() && values[i])
+            {
+                unlink(tac);
+                code.push_back(make_tac(TAC_OP::VAR, tac->a));
+                code.push_back(make_tac(TAC_OP::COPY, tac->a, values[i]));
+            }
+            else
+            {
+                last = tac;
+            }
+            tac = next;
         }
+        splice_after(last, code);
 
-        auto def = tac->get_def();
-        if (def)
+        auto& types = label->a->param_types;
+        if (types.size() == values.size())
         {
-            defs_in_loop[def->name].push_back(tac);
+            for (size_t k = values.size(); k-- > 0;)
+            {
+                if (values[k])
+                    types.erase(types.begin() + k);
+            }
         }
     };
+    auto describe = [](const std::string& name, const std::vector<std::shared_ptr<SYM>>& values) {
+        std::string text = name + "(";
+        for (size_t i = 0; i < values.size(); i++)
+            text += (i ? "," : "") + (values[i] ? values[i]->to_string() : "");
+        return text + ")";
+    };
+
+    bool changed = false;
 
-    for (auto& block : loop_blocks)
+    // 所有调用点一致的常量实参：就地绑定
+    for (auto& name : order)
     {
-        if (!block || block == loop_header || !block->start || !block->end)
+        auto& func = functions[name];
+        if (name == "main" || func.calls.empty())
             continue;
-
-        auto tac = block->start;
-        while (tac)
+        size_t n = func.formals.size();
+        std::vector<std::shared_ptr<SYM>> bound(n);
+        std::vector<bool> agree(n, true);
+        for (auto& call : func.calls)
         {
-            record_instruction(block, tac);
-            if (tac == block->end)
+            auto actuals = actuals_of(call);
+            if (actuals.size() != n)
+            {
+                agree.assign(n, false);
                 break;
-            tac = tac->next;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                auto arg = actuals[i]->a;
+                if (!agree[i] || (caller_of[call] == name && arg == func.formals[i]))
+                    continue;
+                int value;
+                if (!bindable(func.formals[i]) || !arg->get_const_value(value) ||
+                    (bound[i] && !same_constant(bound[i], arg)))
+                {
+                    agree[i] = false;
+                    continue;
+                }
+                if (!bound[i])
+                    bound[i] = make_const(value, func.formals[i]->data_type);
+            }
         }
-    }
-
-    if (loop_instructions.empty())
-        return false;
-
-    auto is_supported_op = [](TAC_OP op) {
-        switch (op)
+        bool any = false;
+        for (size_t i = 0; i < n; i++)
         {
-        case TAC_OP::ADD:
-        case TAC_OP::SUB:
-        case TAC_OP::MUL:
-        case TAC_OP::DIV:
-        case TAC_OP::LT:
-        case TAC_OP::LE:
-        case TAC_OP::GT:
-        case TAC_OP::GE:
-        case TAC_OP::EQ:
-        case TAC_OP::NE:
-        case TAC_OP::COPY:
-            return true;
-        default:
-            return false;
+            if (!agree[i])
+                bound[i] = nullptr;
+            any = any || bound[i];
         }
-    };
-
-    auto operand_ready = [&](const std::shared_ptr<SYM>& sym,
-                             const std::unordered_set<std::shared_ptr<TAC>>& movable) -> bool {
-        if (!sym)
-            return true;
-
-        if (sym->type == SYM_TYPE::CONST_INT || sym->type == SYM_TYPE::CONST_CHAR)
-            return true;
-
-        if (sym->type != SYM_TYPE::VAR)
-            return false;
-
-        auto it = defs_in_loop.find(sym->name);
-        if (it == defs_in_loop.end())
-            return true; // 定义在循环外
+        if (!any)
+            continue;
 
-        for (auto& defining_instr : it->second)
+        std::clog << "    Bound constant arguments of " << describe(name, bound) << std::endl;
+        for (auto& call : func.calls)
+            drop_actuals(call, bound);
+        bind_formals(func.label, bound);
+        std::vector<std::shared_ptr<SYM>> formals;
+        for (size_t i = 0; i < n; i++)
         {
-            if (movable.find(defining_instr) == movable.end())
-                return false;
+            if (!bound[i])
+                formals.push_back(func.formals[i]);
         }
+        func.formals = formals;
+        // 形参变了，以它为克隆目标的特化不再适用
+        for (auto it = specializations.begin(); it != specializations.end();)
+            it = it->second == name ? specializations.erase(it) : std::next(it);
+        changed = true;
+    }
 
-        return true;
+    // 部分调用点的常量实参：按收益从高到低为调用点克隆特化版本，相同的特化共用一个克隆
+    struct Site
+    {
+        std::shared_ptr<TAC> call;
+        std::vector<std::shared_ptr<SYM>> values;
+        int benefit;
     };
-
-    std::unordered_set<std::shared_ptr<TAC>> movable;
-    bool progress = true;
-    while (progress)
+    std::vector<Site> sites;
+    for (auto& name : order)
     {
-        progress = false;
-
-        for (auto& instr : loop_instructions)
+        auto& func = functions[name];
+        if (name == "main")
+            continue;
+        for (auto& call : func.calls)
         {
-            if (movable.find(instr) != movable.end())
+            auto values = constants_at(call, func);
+            int bound = 0, uses = 0;
+            std::unordered_set<std::shared_ptr<SYM>> specialized;
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                if (values[i])
+                {
+                    bound++;
+                    specialized.insert(func.formals[i]);
+                }
+            }
+            if (!bound)
                 continue;
+            for (auto tac = func.label->next; tac != func.end; tac = tac->next)
+            {
+                for (auto& use : tac->get_uses())
+                    uses += specialized.count(use);
+            }
+            int freq = frequency.count(call) ? frequency[call] : 1;
+            sites.push_back({call, values, freq * (ARG_CYCLES * bound + USE_CYCLES * uses)});
+        }
+    }
+    std::stable_sort(sites.begin(), sites.end(), [](const Site& x, const Site& y) {
+        return x.benefit > y.benefit;
+    });
 
-            if (!is_supported_op(instr->op))
+    int labels = count_labels();
+    std::unordered_set<std::string> lost_callers;
+    for (auto& site : sites)
+    {
+        auto name = site.call->b->name;
+        auto& callee = functions[name];
+        auto key = describe(name, site.values);
+        std::shared_ptr<SYM> target = nullptr;
+        auto cached = specializations.find(key);
+        if (cached != specializations.end() && functions.count(cached->second))
+        {
+            target = functions[cached->second].label->a;
+        }
+        else
+        {
+            if (site.benefit < SIZE_WEIGHT * callee.size || clone_growth + callee.size > MAX_CLONE_GROWTH ||
+                labels + callee.labels + 1 > unroll_options.label_limit)
                 continue;
 
-            auto def = instr->get_def();
-            if (!def)
-                continue;
+            std::string clone_name;
+            for (int k = 1; clone_name.empty() || functions.count(clone_name); k++)
+                clone_name = name + "_" + std::to_string(k);
 
-            auto def_it = defs_in_loop.find(def->name);
-            if (def_it == defs_in_loop.end())
-                continue;
+            // 局部变量、形参和临时变量各复制一份，标签重新编号
+            std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<SYM>> rename;
+            std::unordered_map<std::string, std::shared_ptr<SYM>> rename_label;
+            int next_label = std::stoi(make_label(SYM_SCOPE::LOCAL)->name.substr(1));
+            auto renamed = [&](const std::shared_ptr<SYM>& sym) -> std::shared_ptr<SYM> {
+                if (!sym)
+                    return sym;
+                if (sym->type == SYM_TYPE::LABEL)
+                {
+                    auto& label = rename_label[sym->name];
+                    if (!label)
+                    {
+                        label = make_label(SYM_SCOPE::LOCAL);
+                        label->name = "L" + std::to_string(next_label++);
+                    }
+                    return label;
+                }
+                auto it = rename.find(sym);
+                if (it != rename.end())
+                    return it->second;
+                if (sym->type != SYM_TYPE::VAR || sym->scope == SYM_SCOPE::GLOBAL)
+                    return sym;
+                auto var = std::make_shared<SYM>(*sym);
+                var->offset = -1;
+                if (sym->name.rfind("@t", 0) == 0)
+                    var->name = make_temp(sym->data_type, SYM_SCOPE::LOCAL)->name;
+                return rename[sym] = var;
+            };
 
-            if (def_it->second.size() != 1)
-                continue; // 在循环中有多次定值，不能外提
+            target = std::make_shared<SYM>(*callee.label->a);
+            target->name = clone_name;
+            std::vector<std::shared_ptr<TAC>> code{make_tac(TAC_OP::LABEL, target)};
+            for (auto tac = callee.label->next; tac; tac = tac->next)
+            {
+                code.push_back(make_tac(tac->op, renamed(tac->a), renamed(tac->b), renamed(tac->c)));
+                if (tac == callee.end)
+                    break;
+            }
+            splice_after(callee.end, code);
+            bind_formals(code.front(), site.values);
 
-            if (!operand_ready(instr->b, movable))
-                continue;
+            auto& clone = functions[clone_name];
+            clone.label = code.front();
+            clone.end = code.back();
+            clone.size = callee.size;
+            clone.labels = callee.labels;
+            specializations[key] = clone_name;
+            clone_growth += callee.size;
+            labels += callee.labels + 1;
+            std::clog << "    Specialized " << key << " as " << clone_name << std::endl;
+        }
 
-            if (!operand_ready(instr->c, movable))
+        drop_actuals(site.call, site.values);
+        site.call->b = target;
+        lost_callers.insert(name);
+        changed = true;
+    }
+
+    // 所有 return 都返回同一个常量、也不会从函数末尾落出去时，调用结果就是这个常量；
+    // call 本身留着，它可能有副作用
+    for (auto& name : order)
+    {
+        auto& func = functions[name];
+        std::shared_ptr<SYM> result = nullptr;
+        bool constant = true;
+        for (auto tac = func.label->next; tac != func.end && constant; tac = tac->next)
+        {
+            if (tac->op != TAC_OP::RETURN)
                 continue;
+            int value;
+            constant = tac->a && tac->a->get_const_value(value) && (!result || same_constant(result, tac->a));
+            result = tac->a;
+        }
+        auto last = func.end->prev;
+        while (last->op == TAC_OP::VAR)
+            last = last->prev;
+        if (!constant || !result || (last->op != TAC_OP::RETURN && last->op != TAC_OP::GOTO))
+            continue;
 
-            movable.insert(instr);
-            progress = true;
+        for (auto& call : func.calls)
+        {
+            if (!call->a || call->b->name != name)
+                continue;
+            int value;
+            result->get_const_value(value);
+            std::clog << "    Propagated return value " << value << " of " << name << std::endl;
+            splice_after(call, {make_tac(TAC_OP::COPY, call->a, make_const(value, call->a->data_type))});
+            call->a = nullptr;
+            changed = true;
         }
     }
 
-    if (movable.empty())
-        return false;
+    // 调用都转到了克隆上的原函数删掉
+    remove_uncalled_functions(lost_callers);
+
+    return changed;
+}
+
+// 纯函数的编译期求值：不做输入输出、不访问全局变量、形参都是整数或字符、只调用纯函数的函数，
+// 返回值只取决于实参。实参全是常量的调用交给 TAC 解释器执行，求出值就把调用换成返回值；
+// 解释器有步数预算，跑不完或者遇到解释不了的指令时保留调用
+bool TACOptimizer::compile_time_evaluation()
+{
+    const int STEP_BUDGET = 20000;
+
+    struct Function
+    {
+        std::vector<std::shared_ptr<SYM>> formals;
+        std::vector<std::string> callees;
+        bool pure = true;
+    };
 
-    std::shared_ptr<BasicBlock> preheader = nullptr;
-    for (auto& pred : loop_header->predecessors)
+    std::unordered_map<std::string, Function> functions;
+    std::vector<std::shared_ptr<TAC>> calls;
+    for (auto tac = tac_first; tac; tac = tac->next)
     {
-        if (loop_blocks.find(pred) == loop_blocks.end())
+        if (tac->op != TAC_OP::BEGINFUNC || !tac->prev || tac->prev->op != TAC_OP::LABEL)
+            continue;
+        auto& func = functions[tac->prev->a->name];
+        for (tac = tac->next; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
         {
-            preheader = pred;
-            break;
+            if (tac->op == TAC_OP::FORMAL)
+            {
+                auto formal = tac->a;
+                func.formals.push_back(formal);
+                func.pure = func.pure && !formal->is_pointer && !formal->is_array &&
+                            (formal->data_type == DATA_TYPE::INT || formal->data_type == DATA_TYPE::CHAR);
+            }
+            else if (tac->op == TAC_OP::INPUT || tac->op == TAC_OP::OUTPUT)
+            {
+                func.pure = false;
+            }
+            else if (tac->op == TAC_OP::CALL)
+            {
+                func.callees.push_back(tac->b->name);
+                calls.push_back(tac);
+            }
+            for (auto sym : {tac->a, tac->b, tac->c})
+            {
+                if (sym && sym->type == SYM_TYPE::VAR && sym->scope == SYM_SCOPE::GLOBAL)
+                    func.pure = false;
+            }
         }
+        if (!tac)
+            break;
     }
 
-    if (!preheader || !preheader->end)
-        return false;
-
-    std::vector<std::shared_ptr<TAC>> ordered_to_move;
-    ordered_to_move.reserve(movable.size());
-    for (auto& instr : loop_instructions)
+    // 调用了非纯函数的函数也不是纯函数，沿调用图传播到不动点
+    for (bool updated = true; updated;)
     {
-        if (movable.find(instr) != movable.end())
-            ordered_to_move.push_back(instr);
+        updated = false;
+        for (auto& [name, func] : functions)
+        {
+            if (!func.pure)
+                continue;
+            for (auto& callee : func.callees)
+            {
+                auto it = functions.find(callee);
+                if (it == functions.end() || !it->second.pure)
+                {
+                    func.pure = false;
+                    updated = true;
+                    break;
+                }
+            }
+        }
     }
 
-    std::unordered_set<std::string> moved_var_decls;
+    TACInterpreter interpreter(tac_first, STEP_BUDGET);
+    std::unordered_map<std::string, std::optional<int>> results;
+    std::unordered_set<std::string> lost_callers;
+    bool changed = false;
+    for (auto& call : calls)
+    {
+        auto it = functions.find(call->b->name);
+        if (it == functions.end() || !it->second.pure)
+            continue;
 
-    auto remove_from_block = [&](std::shared_ptr<TAC> node) {
-        if (!node)
-            return;
+        std::vector<std::shared_ptr<TAC>> actuals;
+        for (auto prev = call->prev; prev && prev->op == TAC_OP::ACTUAL; prev = prev->prev)
+            actuals.insert(actuals.begin(), prev);
+        if (actuals.size() != it->second.formals.size())
+            continue;
+        std::vector<int> args;
+        std::string key = call->b->name + "(";
+        for (auto& actual : actuals)
+        {
+            int value;
+            if (!actual->a->get_const_value(value))
+                break;
+            key += (args.empty() ? "" : ",") + std::to_string(value);
+            args.push_back(value);
+        }
+        if (args.size() != actuals.size())
+            continue;
+        key += ")";
 
-        auto block_it = instr_block.find(node);
-        if (block_it == instr_block.end())
-            return;
+        auto cached = results.find(key);
+        if (cached == results.end())
+        {
+            int value;
+            cached = results.emplace(key, interpreter.evaluate(call->b->name, args, value)
+                                              ? std::optional<int>(value) : std::nullopt).first;
+        }
+        if (!cached->second)
+            continue;
 
-        auto block = block_it->second;
-        if (!block)
-            return;
+        std::clog << "    Evaluated " << key << " = " << *cached->second << " at compile time" << std::endl;
+        for (auto& actual : actuals)
+        {
+            actual->prev->next = actual->next;
+            actual->next->prev = actual->prev;
+        }
+        lost_callers.insert(call->b->name);
+        if (call->a)
+        {
+            call->op = TAC_OP::COPY;
+            call->b = make_const(*cached->second, call->a->data_type);
+        }
+        else
+        {
+            call->prev->next = call->next;
+            if (call->next)
+                call->next->prev = call->prev;
+        }
+        changed = true;
+    }
 
-        if (node == block->start)
-            block->start = node->next;
-        if (node == block->end)
-            block->end = node->prev;
+    remove_uncalled_functions(lost_callers);
+    return changed;
+}
 
-        if (node->prev)
-            node->prev->next = node->next;
-        if (node->next)
-            node->next->prev = node->prev;
+// 删除不再被别的函数调用的函数，自己递归调用自己不算
+void TACOptimizer::remove_uncalled_functions(const std::unordered_set<std::string>& names)
+{
+    std::unordered_map<std::string, int> call_sites;
+    std::unordered_map<std::string, std::pair<std::shared_ptr<TAC>, std::shared_ptr<TAC>>> bounds;
+    std::string current;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::BEGINFUNC && tac->prev && tac->prev->op == TAC_OP::LABEL)
+        {
+            current = tac->prev->a->name;
+            bounds[current].first = tac->prev;
+        }
+        else if (tac->op == TAC_OP::ENDFUNC)
+        {
+            bounds[current].second = tac;
+        }
+        else if (tac->op == TAC_OP::CALL && tac->b->name != current)
+        {
+            call_sites[tac->b->name]++;
+        }
+    }
 
-        node->prev = nullptr;
-        node->next = nullptr;
+    for (auto& name : names)
+    {
+        auto it = bounds.find(name);
+        if (it == bounds.end() || call_sites[name] > 0 || name == "main" || it->second.first == tac_first)
+            continue;
+        auto [label, end] = it->second;
+        label->prev->next = end->next;
+        if (end->next)
+            end->next->prev = label->prev;
+        std::clog << "    Removed function " << name << std::endl;
+    }
+}
 
-        if (!block->start)
-            block->start = block->end;
+// 全局变量优化（整个程序）：全局标量在 STATIC 区，每次访问都要先取基址再读写内存。
+// 程序中从没写过的全局变量恒为 0，只在 main 开头（第一次调用或跳转之前）赋过一次常量的恒为该常量，
+// 读它的地方直接换成常量；其余没有取过地址的全局标量，在循环中访问它的函数里换成局部的影子变量：
+// 函数入口读一次，调用可能访问它的函数之前和函数出口写回，调用可能写它的函数之后重新读
+bool TACOptimizer::global_variable_promotion()
+{
+    struct Function
+    {
+        std::shared_ptr<TAC> begin;
+        std::vector<std::string> callees;
+        std::unordered_set<std::shared_ptr<SYM>> touches, writes;  // 包括调用的函数访问的
+        bool unknown_callee = false;
     };
 
-    auto insert_after = [&](std::shared_ptr<TAC> node, std::shared_ptr<TAC> position) {
-        if (!node || !position)
-            return;
-
-        node->prev = position;
-        node->next = position->next;
-
-        if (position->next)
-            position->next->prev = node;
-        position->next = node;
-
-        if (preheader->end == position)
-            preheader->end = node;
-
-        instr_block[node] = preheader;
-    };
+    std::unordered_set<std::shared_ptr<SYM>> globals, address_taken;
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<TAC>>> defs;
+    std::unordered_map<std::string, Function> functions;
+    bool main_called = false;
+    for (auto tac = tac_first; tac; tac = tac->next)
+    {
+        if (tac->op == TAC_OP::VAR && tac->a->scope == SYM_SCOPE::GLOBAL && !tac->a->is_array &&
+            !tac->a->is_pointer && (tac->a->data_type == DATA_TYPE::INT || tac->a->data_type == DATA_TYPE::CHAR))
+        {
+            globals.insert(tac->a);
+            continue;
+        }
+        if (tac->op != TAC_OP::BEGINFUNC || !tac->prev || tac->prev->op != TAC_OP::LABEL)
+            continue;
+        auto& func = functions[tac->prev->a->name];
+        func.begin = tac;
+        for (tac = tac->next; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::ADDR)
+                address_taken.insert(tac->b);
+            if (tac->op == TAC_OP::CALL)
+            {
+                func.callees.push_back(tac->b->name);
+                main_called = main_called || tac->b->name == "main";
+            }
+            for (auto sym : {tac->a, tac->b, tac->c})
+            {
+                if (sym && globals.count(sym))
+                    func.touches.insert(sym);
+            }
+            auto def = tac->get_def();
+            if (def && globals.count(def))
+            {
+                func.writes.insert(def);
+                defs[def].push_back(tac);
+            }
+        }
+        if (!tac)
+            break;
+    }
+    for (auto& sym : address_taken)
+        globals.erase(sym);
+    if (globals.empty())
+        return false;
 
-    auto insertion_point = preheader->end;
+    // 调用的函数访问的全局变量也算在调用者头上，沿调用图传播到不动点
+    for (bool updated = true; updated;)
+    {
+        updated = false;
+        for (auto& [name, func] : functions)
+        {
+            for (auto& callee : func.callees)
+            {
+                auto it = functions.find(callee);
+                if (it == functions.end())
+                {
+                    updated = updated || !func.unknown_callee;
+                    func.unknown_callee = true;
+                    continue;
+                }
+                for (auto& sym : it->second.touches)
+                    updated = func.touches.insert(sym).second || updated;
+                for (auto& sym : it->second.writes)
+                    updated = func.writes.insert(sym).second || updated;
+                if (it->second.unknown_callee && !func.unknown_callee)
+                {
+                    func.unknown_callee = true;
+                    updated = true;
+                }
+            }
+        }
+    }
 
-    for (auto& instr : ordered_to_move)
+    // main 开头只执行一次的直线代码中，全局变量被常量赋值之前有没有被读过
+    std::unordered_set<std::shared_ptr<TAC>> prefix;
+    std::unordered_set<std::shared_ptr<SYM>> read_early;
+    auto main_func = functions.find("main");
+    if (main_func != functions.end() && !main_called)
     {
-        auto def = instr->get_def();
-        if (def)
+        for (auto tac = main_func->second.begin->next; tac; tac = tac->next)
         {
-            auto decl_it = var_decl_in_loop.find(def->name);
-            if (decl_it != var_decl_in_loop.end() &&
-                moved_var_decls.insert(def->name).second)
+            if (tac->op == TAC_OP::LABEL || tac->op == TAC_OP::GOTO || tac->op == TAC_OP::IFZ ||
+                tac->op == TAC_OP::ACTUAL || tac->op == TAC_OP::CALL || tac->op == TAC_OP::RETURN ||
+                tac->op == TAC_OP::ENDFUNC)
+                break;
+            prefix.insert(tac);
+            for (auto& use : tac->get_uses())
             {
-                auto decl = decl_it->second;
-                remove_from_block(decl);
-                insert_after(decl, insertion_point);
-                insertion_point = decl;  // Update insertion point to maintain order
-                changed = true;
+                if (globals.count(use) && !(defs[use].size() == 1 && prefix.count(defs[use].front())))
+                    read_early.insert(use);
             }
         }
+    }
 
-        remove_from_block(instr);
-        insert_after(instr, insertion_point);
-        insertion_point = instr;  // Update insertion point to maintain order
+    // 常量化：读的位置都要能换成常量
+    auto replaceable = [](const std::shared_ptr<TAC>& tac, const std::shared_ptr<SYM>& sym) {
+        if (tac->op == TAC_OP::LOAD_PTR || tac->op == TAC_OP::STORE_PTR)
+            return tac->b != sym && tac->c != sym && tac->a != sym;
+        if (tac->a == sym && tac->get_def() != sym)
+            return tac->op == TAC_OP::RETURN || tac->op == TAC_OP::OUTPUT || tac->op == TAC_OP::ACTUAL;
+        return true;
+    };
+    bool changed = false;
+    for (auto it = globals.begin(); it != globals.end();)
+    {
+        auto sym = *it;
+        auto& sym_defs = defs[sym];
+        int value = 0;
+        bool constant = sym_defs.empty();
+        if (sym_defs.size() == 1 && prefix.count(sym_defs.front()) && !read_early.count(sym) &&
+            sym_defs.front()->op == TAC_OP::COPY && sym_defs.front()->b->get_const_value(value))
+            constant = true;
+        for (auto tac = tac_first; constant && tac; tac = tac->next)
+            constant = tac->op == TAC_OP::VAR || replaceable(tac, sym);
+        if (!constant)
+        {
+            ++it;
+            continue;
+        }
+
+        std::clog << "    Global constant: " << sym->name << " = " << value << std::endl;
+        auto replacement = make_const(value, sym->data_type);
+        for (auto tac = tac_first; tac; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::VAR || tac->get_def() == sym)
+                continue;
+            for (auto operand : {&tac->a, &tac->b, &tac->c})
+            {
+                if (*operand == sym)
+                    *operand = replacement;
+            }
+        }
+        for (auto& def : sym_defs)
+        {
+            def->prev->next = def->next;
+            def->next->prev = def->prev;
+        }
         changed = true;
+        it = globals.erase(it);
     }
 
-    if (changed)
+    // 影子变量：只在循环中的访问多于循环中需要同步的调用时才划算
+    block_builder.build();
+    block_builder.build_loops();
+    std::unordered_set<std::shared_ptr<TAC>> in_loop;
+    for (auto& block : block_builder.get_basic_blocks())
     {
-        std::clog << "    Loop invariant code motion: found "
-                  << ordered_to_move.size() << " invariant instructions" << std::endl;
+        if (!block_builder.get_loop(block))
+            continue;
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            in_loop.insert(tac);
+            if (tac == block->end)
+                break;
+        }
     }
+    auto callee_of = [&](const std::shared_ptr<TAC>& call) -> const Function* {
+        auto it = functions.find(call->b->name);
+        return it != functions.end() && !it->second.unknown_callee ? &it->second : nullptr;
+    };
+    auto insert_before = [](std::shared_ptr<TAC> node, std::shared_ptr<TAC> position) {
+        node->prev = position->prev;
+        node->next = position;
+        position->prev->next = node;
+        position->prev = node;
+    };
+
+    for (auto& [name, func] : functions)
+    {
+        for (auto& sym : globals)
+        {
+            int loop_accesses = 0, loop_syncs = 0;
+            bool writes = false;
+            for (auto tac = func.begin->next; tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+            {
+                bool uses = tac->a == sym || tac->b == sym || tac->c == sym;
+                writes = writes || tac->get_def() == sym;
+                if (!in_loop.count(tac))
+                    continue;
+                if (uses)
+                    loop_accesses++;
+                auto callee = tac->op == TAC_OP::CALL ? callee_of(tac) : nullptr;
+                if (tac->op == TAC_OP::CALL && (!callee || callee->touches.count(sym)))
+                    loop_syncs++;
+            }
+            if (loop_accesses <= loop_syncs)
+                continue;
+
+            std::clog << "    Promoted global " << sym->name << " in function " << name << std::endl;
+            auto shadow = make_temp(sym->data_type, SYM_SCOPE::LOCAL);
+            std::vector<std::shared_ptr<TAC>> calls, exits;
+            auto tac = func.begin->next;
+            for (; tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+            {
+                for (auto operand : {&tac->a, &tac->b, &tac->c})
+                {
+                    if (*operand == sym)
+                        *operand = shadow;
+                }
+                if (tac->op == TAC_OP::CALL)
+                    calls.push_back(tac);
+                else if (tac->op == TAC_OP::RETURN)
+                    exits.push_back(tac);
+            }
+            exits.push_back(tac);
+
+            auto entry = func.begin->next;
+            while (entry->op == TAC_OP::FORMAL)
+                entry = entry->next;
+            // 没有被调用的 main 入口处全局变量都还是 0，出口处程序就结束了，不必写回
+            bool program_entry = name == "main" && !main_called;
+            insert_before(make_tac(TAC_OP::VAR, shadow), entry);
+            insert_before(make_tac(TAC_OP::COPY, shadow, program_entry ? make_const(0, sym->data_type) : sym), entry);
 
+            for (auto& call : calls)
+            {
+                auto callee = callee_of(call);
+                if (callee && !callee->touches.count(sym))
+                    continue;
+                auto first = call;
+                while (first->prev->op == TAC_OP::ACTUAL)
+                    first = first->prev;
+                if (writes)
+                    insert_before(make_tac(TAC_OP::COPY, sym, shadow), first);
+                // g = f() 的返回值在调用之后才赋给 g
+                if ((!callee || callee->writes.count(sym)) && call->a != shadow)
+                    insert_before(make_tac(TAC_OP::COPY, shadow, sym), call->next);
+            }
+            for (auto& exit : writes && !program_entry ? exits : std::vector<std::shared_ptr<TAC>>{})
+                insert_before(make_tac(TAC_OP::COPY, sym, shadow), exit);
+            changed = true;
+        }
+    }
     return changed;
 }
 
@@ -1030,10 +4515,233 @@ bool TACOptimizer::simplify_control_flow(std::shared_ptr<TAC> tac_start)
         
         current = current->next;
     }
+
     
     return changed;
 }
 
+// 跳转线程化：块 B 以 ifz 结尾且有多个前驱，沿某个前驱 P 进来时条件已经确定
+// （例如 P 刚给标志赋了常量，或 P 自己的分支已经判断过同一个比较），
+// 就把 B 中 ifz 之前的指令复制一份给 P，复制品直接跳到最终目标，不再重新判断；
+// 目标块的条件沿这条路径也确定时继续往下走，一连串的判断一次跳过。
+// 所有前驱都确定时由值域传播折叠，这里只处理部分前驱确定的情况；
+// 路径不经过循环头，否则循环会有第二个入口
+bool TACOptimizer::jump_threading()
+{
+    const size_t MAX_THREAD_SIZE = 6;   // 一条路径上复制的指令数上限
+
+    block_builder.build();
+    block_builder.build_loops();
+    block_builder.compute_data_flow();
+    RangeAnalysis ranges(block_builder);
+    ranges.compute();
+    const auto& block_out = block_builder.get_block_out();
+
+    // 块中 ifz 之前要复制的指令：只给 ifz 算条件的指令在复制品中是死的，不复制
+    std::unordered_map<std::shared_ptr<BasicBlock>, std::vector<std::shared_ptr<TAC>>> bodies;
+    auto body_of = [&](const std::shared_ptr<BasicBlock>& block) -> const std::vector<std::shared_ptr<TAC>>& {
+        auto it = bodies.find(block);
+        if (it != bodies.end())
+            return it->second;
+        auto live = block_out.at(block).live_vars;
+        std::vector<std::shared_ptr<TAC>> body;
+        for (auto tac = block->end->prev; tac && tac != block->start->prev; tac = tac->prev)
+        {
+            if (tac->op == TAC_OP::LABEL || tac->op == TAC_OP::VAR)
+                continue;
+            auto def = tac->get_def();
+            bool pure = tac->op == TAC_OP::COPY || tac->op == TAC_OP::ADD || tac->op == TAC_OP::SUB ||
+                        tac->op == TAC_OP::MUL || tac->op == TAC_OP::NEG || tac->op == TAC_OP::EQ ||
+                        tac->op == TAC_OP::NE || tac->op == TAC_OP::LT || tac->op == TAC_OP::LE ||
+                        tac->op == TAC_OP::GT || tac->op == TAC_OP::GE;
+            if (pure && def && def->type == SYM_TYPE::VAR && !live.count(def) && !block_builder.is_memory_var(def))
+                continue;
+            if (def)
+                live.erase(def);
+            for (auto& use : block_builder.get_uses(tac))
+                live.insert(use);
+            body.push_back(tac);
+        }
+        std::reverse(body.begin(), body.end());
+        return bodies[block] = body;
+    };
+    auto threadable = [&](const std::shared_ptr<BasicBlock>& block) {
+        if (block->successors.size() != 2 || block->successors[0] == block->successors[1])
+            return false;
+        auto loop = block_builder.get_loop(block);
+        if (loop && loop->header == block)
+            return false;
+        for (auto tac = block->start->next; tac != block->end; tac = tac->next)
+        {
+            if (tac->op == TAC_OP::LABEL)
+                return false;
+        }
+        return true;
+    };
+
+    struct Thread
+    {
+        std::shared_ptr<BasicBlock> pred;
+        std::shared_ptr<TAC> pred_end;
+        std::vector<std::pair<std::shared_ptr<BasicBlock>, bool>> path;
+    };
+    std::vector<Thread> threads;
+    for (auto& block : block_builder.get_basic_blocks())
+    {
+        if (block->end->op != TAC_OP::IFZ || block->predecessors.size() < 2 || !threadable(block))
+            continue;
+        for (auto& pred : block->predecessors)
+        {
+            size_t size = 0;
+            auto path = ranges.branch_path(pred, block, [&](const std::shared_ptr<BasicBlock>& next) {
+                if (!threadable(next))
+                    return false;
+                size += body_of(next).size();
+                return size <= MAX_THREAD_SIZE;
+            });
+            if (!path.empty())
+                threads.push_back({pred, pred->end, path});
+        }
+    }
+
+    auto link_before = [](std::shared_ptr<TAC> node, std::shared_ptr<TAC> position) {
+        node->prev = position->prev;
+        node->next = position;
+        if (position->prev)
+            position->prev->next = node;
+        position->prev = node;
+    };
+    auto link_after = [](std::shared_ptr<TAC> node, std::shared_ptr<TAC> position) {
+        node->prev = position;
+        node->next = position->next;
+        if (position->next)
+            position->next->prev = node;
+        position->next = node;
+    };
+
+    bool changed = false;
+    for (auto& thread : threads)
+    {
+        auto block = thread.path.front().first;
+        auto [last, taken] = thread.path.back();
+        auto pred_end = thread.pred_end;
+        bool jumps = pred_end->op == TAC_OP::GOTO ||
+                     (pred_end->op == TAC_OP::IFZ && thread.pred->successors[0] == block);
+
+        // 条件跳转进来的前驱需要一个新标签，复制品放在 B 之前不会顺序流入的位置，或函数中最后一个 return 之后
+        std::shared_ptr<TAC> place = nullptr;
+        bool place_before = false;
+        if (jumps && pred_end->op == TAC_OP::IFZ)
+        {
+            auto prev = block->start->prev;
+            if (prev && (prev->op == TAC_OP::GOTO || prev->op == TAC_OP::RETURN))
+            {
+                place = block->start;
+                place_before = true;
+            }
+            else
+            {
+                for (auto tac = block->end; tac && tac->op != TAC_OP::ENDFUNC; tac = tac->next)
+                {
+                    if (tac->op == TAC_OP::RETURN)
+                        place = tac;
+                }
+            }
+            if (!place)
+                continue;
+        }
+
+        // 最终目标：跳转时是 ifz 的标签，顺序执行时是其后的块，没有标签就补一个
+        auto next = last->successors[1];
+        int new_labels = (place ? 1 : 0) + (!taken && next->start->op != TAC_OP::LABEL ? 1 : 0);
+        if (count_labels() + new_labels > unroll_options.label_limit)
+            continue;
+        std::shared_ptr<SYM> target;
+        if (taken)
+        {
+            target = last->end->a;
+        }
+        else if (next->start->op == TAC_OP::LABEL)
+        {
+            target = next->start->a;
+        }
+        else
+        {
+            target = make_label(last->end->a->scope);
+            auto label = make_tac(TAC_OP::LABEL, target);
+            link_before(label, next->start);
+            next->start = label;
+        }
+
+        // 和循环旋转一样，块中定值、出了块就不再使用的临时变量在复制品中换成新名字
+        std::vector<std::shared_ptr<TAC>> copy;
+        for (auto& [path_block, path_taken] : thread.path)
+        {
+            const auto& live_out = block_out.at(path_block).live_vars;
+            std::unordered_map<std::shared_ptr<SYM>, std::shared_ptr<SYM>> rename;
+            auto renamed = [&](const std::shared_ptr<SYM>& sym) {
+                auto it = sym ? rename.find(sym) : rename.end();
+                return it != rename.end() ? it->second : sym;
+            };
+            for (auto& tac : body_of(path_block))
+            {
+                auto b = renamed(tac->b), c = renamed(tac->c);
+                auto def = tac->get_def();
+                if (def && !live_out.count(def) && def->name.rfind("@t", 0) == 0 && !rename.count(def))
+                {
+                    rename[def] = make_temp(def->data_type, def->scope);
+                    copy.push_back(make_tac(TAC_OP::VAR, rename[def]));
+                }
+                copy.push_back(make_tac(tac->op, renamed(tac->a), b, c));
+            }
+        }
+        copy.push_back(make_tac(TAC_OP::GOTO, target));
+
+        std::clog << "    Threaded jump: block " << thread.pred->id << " -> block " << block->id;
+        if (thread.path.size() > 1)
+            std::clog << " ... block " << last->id;
+        std::clog << " -> " << target->name << std::endl;
+        if (pred_end->op == TAC_OP::GOTO)
+        {
+            // goto B 换成复制品加 goto 目标
+            copy.pop_back();
+            for (auto& tac : copy)
+                link_before(tac, pred_end);
+            pred_end->a = target;
+        }
+        else if (place)
+        {
+            auto label = make_label(target->scope);
+            copy.insert(copy.begin(), make_tac(TAC_OP::LABEL, label));
+            for (auto& tac : copy)
+            {
+                if (place_before)
+                {
+                    link_before(tac, place);
+                }
+                else
+                {
+                    link_after(tac, place);
+                    place = tac;
+                }
+            }
+            pred_end->a = label;
+        }
+        else
+        {
+            // 顺序流入 B 的前驱：复制品紧跟在前驱之后
+            auto position = pred_end;
+            for (auto& tac : copy)
+            {
+                link_after(tac, position);
+                position = tac;
+            }
+        }
+        changed = true;
+    }
+    return changed;
+}
+
 // 不可达代码消除：删除永远不会执行的代码块
 bool TACOptimizer::eliminate_unreachable_code(std::vector<std::shared_ptr<BasicBlock>>& blocks)
 {
@@ -1046,9 +4754,12 @@ bool TACOptimizer::eliminate_unreachable_code(std::vector<std::shared_ptr<BasicB
     std::unordered_set<std::shared_ptr<BasicBlock>> reachable;
     std::queue<std::shared_ptr<BasicBlock>> worklist;
     
-    // 从第一个块开始（程序入口，多函数由于不启用优化，可认为block 0为入口）
-    worklist.push(blocks[0]);
-    reachable.insert(blocks[0]);
+    // 从每个函数的入口块开始（被调用的函数由 CALL 进入，不在控制流图中）
+    for (auto& func : block_builder.get_functions())
+    {
+        worklist.push(func.blocks.front());
+        reachable.insert(func.blocks.front());
+    }
     
     while (!worklist.empty())
     {
@@ -1075,13 +4786,20 @@ bool TACOptimizer::eliminate_unreachable_code(std::vector<std::shared_ptr<BasicB
         }
         else
         {
-            std::clog << "    Removing unreachable block " << block->id << std::endl;
-            
-            // 从 TAC 链表中删除该块的所有指令
+            // 从 TAC 链表中删除该块的所有指令，声明和函数结束标记除外
+            bool removed = false;
             auto tac = block->start;
             while (tac)
             {
                 auto next = (tac == block->end) ? nullptr : tac->next;
+                if (tac->op == TAC_OP::VAR || tac->op == TAC_OP::ENDFUNC)
+                {
+                    tac = next;
+                    if (!next)
+                        break;
+                    continue;
+                }
+                removed = true;
                 auto prev = tac->prev;
                 auto curr_next = tac->next;
                 
@@ -1099,7 +4817,11 @@ bool TACOptimizer::eliminate_unreachable_code(std::vector<std::shared_ptr<BasicB
                     break;
             }
             
-            changed = true;
+            if (removed)
+            {
+                std::clog << "    Removing unreachable block " << block->id << std::endl;
+                changed = true;
+            }
         }
     }
     
@@ -1111,13 +4833,13 @@ bool TACOptimizer::eliminate_unreachable_code(std::vector<std::shared_ptr<BasicB
     return changed;
 }
 
-// 消除未使用的变量声明（该方法不适用于多函数，因为没有考虑函数作用域和参数传递）
+// 消除未使用的变量声明（按符号区分，不同函数中的同名局部变量互不影响）
 bool TACOptimizer::eliminate_unused_var_declarations(std::shared_ptr<TAC> tac_start)
 {
     bool changed = false;
     
     // 收集所有被使用的变量（除了声明）
-    std::unordered_set<std::string> used_vars;
+    std::unordered_set<std::shared_ptr<SYM>> used_vars;
     
     auto current = tac_start;
     while (current)
@@ -1126,11 +4848,11 @@ bool TACOptimizer::eliminate_unused_var_declarations(std::shared_ptr<TAC> tac_st
         if (current->op != TAC_OP::VAR)
         {
             if (current->a && current->a->type == SYM_TYPE::VAR)
-                used_vars.insert(current->a->name);
+                used_vars.insert(current->a);
             if (current->b && current->b->type == SYM_TYPE::VAR)
-                used_vars.insert(current->b->name);
+                used_vars.insert(current->b);
             if (current->c && current->c->type == SYM_TYPE::VAR)
-                used_vars.insert(current->c->name);
+                used_vars.insert(current->c);
         }
         
         current = current->next;
@@ -1145,7 +4867,8 @@ bool TACOptimizer::eliminate_unused_var_declarations(std::shared_ptr<TAC> tac_st
         if (current->op == TAC_OP::VAR && current->a && current->a->type == SYM_TYPE::VAR)
         {
             // 检查该变量是否被使用
-            if (used_vars.find(current->a->name) == used_vars.end())
+            // 程序的第一条 TAC 由 TACGenerator 持有，不能删除
+            if (used_vars.find(current->a) == used_vars.end() && current->prev)
             {
                 std::clog << "    Removing unused var declaration: " << current->a->name << std::endl;
                 
@@ -1174,18 +4897,40 @@ bool TACOptimizer::eliminate_unused_var_declarations(std::shared_ptr<TAC> tac_st
 
 void TACOptimizer::optimize()
 {
-    // 构建控制流图
+    // 构建控制流图，先消除尾递归再做函数内联，变成循环的递归函数也可能被内联
+    if (tail_recursion_elimination())
+    {
+        std::clog << "  - Tail recursion elimination applied" << std::endl;
+    }
     block_builder.build();
+    // 编译期能求值的纯函数调用不必内联
+    if (compile_time_evaluation())
+    {
+        std::clog << "  - Compile-time evaluation applied" << std::endl;
+    }
+    if (function_inlining())
+    {
+        std::clog << "  - Function inlining applied" << std::endl;
+        block_builder.build();
+    }
+    // 全局变量：恒定的换成常量，循环中访问的换成局部影子变量
+    if (global_variable_promotion())
+    {
+        std::clog << "  - Global variable promotion applied" << std::endl;
+        block_builder.build();
+    }
     block_builder.print_basic_blocks(std::clog);
     auto blocks = block_builder.get_basic_blocks();
     
     if (blocks.empty())
         return;
     
-    // 多轮迭代优化
+    // 多轮迭代优化：SCCP 自己删掉走不到的分支，不再靠后面几轮的控制流简化收尾，
+    // 一般几轮就收敛，上限只是保险
     bool global_changed = true;
+    bool rotate_loops = false;
     int global_iter = 0;
-    const int MAX_GLOBAL_ITER = 20;
+    const int MAX_GLOBAL_ITER = 10;
     
     while (global_changed && global_iter < MAX_GLOBAL_ITER)
     {
@@ -1194,43 +4939,147 @@ void TACOptimizer::optimize()
         
         std::clog << "\n=== Optimization Pass " << global_iter << " ===" << std::endl;
 
+        // 纯函数求值和过程间常量传播：上一轮 SCCP 折叠出的常量实参和返回值传到调用图的另一端，
+        // 能直接求值的调用先求值，不必再为它特化
+        if (compile_time_evaluation())
+        {
+            global_changed = true;
+            std::clog << "  - Compile-time evaluation applied" << std::endl;
+        }
+        if (interprocedural_constant_propagation())
+        {
+            global_changed = true;
+            std::clog << "  - Interprocedural constant propagation applied" << std::endl;
+            block_builder.build();
+        }
+        blocks = block_builder.get_basic_blocks();
+
         //局部优化（基本块内）
         for (auto& block : blocks)
         {
             optimize_block_local(block);
         }
+
+        // 聚合量标量替换：局部常量折叠之后偏移才是常数
+        if (scalar_replacement_of_aggregates())
+        {
+            global_changed = true;
+            std::clog << "  - Scalar replacement of aggregates applied" << std::endl;
+            block_builder.build();
+            blocks = block_builder.get_basic_blocks();
+        }
         
-        // 公共子表达式消除（每个基本块内）
-        for (auto& block : blocks)
+        // 全局值编号（跨基本块的公共子表达式消除）
+        if (global_value_numbering())
+        {
+            global_changed = true;
+            std::clog << "  - Global value numbering applied" << std::endl;
+        }
+
+        // 冗余读消除
+        if (redundant_load_elimination())
+        {
+            global_changed = true;
+            std::clog << "  - Redundant load elimination applied" << std::endl;
+        }
+        
+        // 循环不变量外提：内层循环先处理，外提到内层预头的指令还可以继续外提
+        block_builder.build_loops();
+        blocks = block_builder.get_basic_blocks();
+        if (global_iter == 1)
+        {
+            block_builder.print_loops(std::clog);
+        }
+        block_builder.compute_data_flow();
+
+        // 循环展开：每个循环只展开一次，展开后重新建立循环
+        bool unrolled = false;
+        for (auto& loop : block_builder.get_loops())
+        {
+            if (loop_unrolling(loop))
+            {
+                unrolled = true;
+                std::clog << "  - Loop unrolling applied for loop at block " << loop->header->id << std::endl;
+            }
+        }
+        if (unrolled)
+        {
+            global_changed = true;
+            block_builder.build();
+            block_builder.build_loops();
+            blocks = block_builder.get_basic_blocks();
+            block_builder.compute_data_flow();
+        }
+
+        // 循环旋转：等展开等依赖顶部判断形状的变换稳定之后再做；
+        // 改变了块的顺序，互相嵌套的循环每轮只旋转一个
+        std::vector<std::shared_ptr<Loop>> rotated;
+        for (auto& loop : rotate_loops ? block_builder.get_loops() : std::vector<std::shared_ptr<Loop>>{})
+        {
+            bool nested = std::any_of(rotated.begin(), rotated.end(), [&](const std::shared_ptr<Loop>& other) {
+                return loop->contains(other->header) || other->contains(loop->header);
+            });
+            if (!nested && loop_rotation(loop))
+            {
+                rotated.push_back(loop);
+                std::clog << "  - Loop rotation applied for loop at block " << loop->header->id << std::endl;
+            }
+        }
+        if (!rotated.empty())
         {
-            if (common_subexpression_elimination(block))
+            global_changed = true;
+            block_builder.build();
+            block_builder.build_loops();
+            blocks = block_builder.get_basic_blocks();
+            block_builder.compute_data_flow();
+        }
+
+        for (auto& loop : block_builder.get_loops())
+        {
+            if (loop_invariant_code_motion(loop))
             {
                 global_changed = true;
-                std::clog << "  - CSE applied in block " << block->id << std::endl;
+                std::clog << "  - LICM applied for loop at block " << loop->header->id << std::endl;
+                block_builder.compute_data_flow();
             }
         }
-        
-        // 循环不变量外提
-        for (auto& block : blocks)
+
+        // 归纳变量强度削减，线性判断替换用值域排除回绕
+        RangeAnalysis ranges(block_builder);
+        ranges.compute();
+        for (auto& loop : block_builder.get_loops())
         {
-            if (is_loop_header(block))
+            if (strength_reduction(loop, ranges))
             {
-                if (loop_invariant_code_motion(block))
-                {
-                    global_changed = true;
-                    std::clog << "  - LICM applied for loop at block " << block->id << std::endl;
-                }
+                global_changed = true;
+                std::clog << "  - Strength reduction applied for loop at block " << loop->header->id << std::endl;
+                block_builder.compute_data_flow();
             }
         }
         
+        // 惰性代码移动：LICM 之后剩下的部分冗余，拆边后重建基本块
+        block_builder.compute_data_flow();
+        if (lazy_code_motion())
+        {
+            global_changed = true;
+            std::clog << "  - Lazy code motion applied" << std::endl;
+            block_builder.build();
+            blocks = block_builder.get_basic_blocks();
+        }
+
         // 数据流分析
         block_builder.compute_data_flow();
         
         // 全局优化
-        if (global_constant_propagation(blocks))
+        if (sparse_conditional_constant_propagation())
         {
             global_changed = true;
-            std::clog << "  - Global constant propagation applied" << std::endl;
+            std::clog << "  - Sparse conditional constant propagation applied" << std::endl;
+
+            // SCCP 可能删掉了分支，后面的死存储和死代码消除要用新的控制流图
+            block_builder.build();
+            blocks = block_builder.get_basic_blocks();
+            block_builder.compute_data_flow();
         }
         
         // 再次进行局部常量折叠（处理新产生的常量）
@@ -1242,6 +5091,20 @@ void TACOptimizer::optimize()
             }
         }
         
+        // 值域传播：折叠结果已知的比较和分支，SCCP 只认识精确的常量
+        if (value_range_propagation())
+        {
+            global_changed = true;
+            std::clog << "  - Value range propagation applied" << std::endl;
+        }
+
+        // 死存储消除：和死代码消除用同一份活跃变量信息
+        if (dead_store_elimination(blocks))
+        {
+            global_changed = true;
+            std::clog << "  - Dead store elimination applied" << std::endl;
+        }
+
         //消除未使用的变量声明
         if (global_dead_code_elimination(blocks))
         {
@@ -1261,6 +5124,17 @@ void TACOptimizer::optimize()
             block_builder.build();
             blocks = block_builder.get_basic_blocks();
         }
+
+        // 跳转线程化：前驱已经决定了后继块末尾分支的走向时，复制这个小块直接跳到最终目标；
+        // 它自己会重建控制流图，所以无论是否改动都要重新取基本块
+        if (jump_threading())
+        {
+            global_changed = true;
+            std::clog << "  - Jump threading applied" << std::endl;
+
+            block_builder.build();
+        }
+        blocks = block_builder.get_basic_blocks();
         
         // 不可达代码消除
         if (eliminate_unreachable_code(blocks))
@@ -1271,6 +5145,12 @@ void TACOptimizer::optimize()
             block_builder.build();
             blocks = block_builder.get_basic_blocks();
         }
+
+        if (!global_changed && !rotate_loops)
+        {
+            rotate_loops = true;
+            global_changed = true;
+        }
     }
     
     // 最后一轮清理：删除未使用的变量声明（包括临时变量）
@@ -8,19 +8,44 @@
 #include <unordered_set>
 #include "abstraction/block_struct.hh"
 #include "block.hh"
+#include "range.hh"
 
 namespace twlm::ccpl::modules
 {
     using namespace twlm::ccpl::abstraction;
+
+    // 循环展开的参数
+    struct UnrollOptions
+    {
+        int factor = 4;             // 部分展开的倍数，小于 2 时不做部分展开
+        int full_trip_limit = 8;    // 迭代次数不超过它的常数循环完全展开
+        int size_budget = 48;       // 一个循环展开后新增指令数的上限
+        int label_limit = 90;       // 汇编器最多 100 个标签，留出余量
+    };
     
     class TACOptimizer
     {
     private:
         std::shared_ptr<TAC> tac_first;
         BlockBuilder block_builder;
+        int next_temp = -1;  // 新临时变量的编号，首次使用时扫描 TAC 确定
+        UnrollOptions unroll_options;
+        std::unordered_set<std::shared_ptr<TAC>> unrolled_loops;  // 已展开循环的 header 标签
+        std::unordered_map<std::string, std::string> specializations;  // 特化的键（如 "f(,3)"）到克隆出的函数名
+        int clone_growth = 0;       // 特化克隆累计新增的指令数
         
         void warning(const std::string& module,const std::string& msg)const;
-        std::shared_ptr<SYM> make_const(int value)const;
+        std::shared_ptr<SYM> make_const(int value, DATA_TYPE type = DATA_TYPE::INT)const;
+        std::shared_ptr<SYM> make_temp(DATA_TYPE type, SYM_SCOPE scope);
+        std::shared_ptr<SYM> make_label(SYM_SCOPE scope);
+        int count_labels() const;
+        std::shared_ptr<TAC> make_tac(TAC_OP op, std::shared_ptr<SYM> a,
+                                      std::shared_ptr<SYM> b = nullptr, std::shared_ptr<SYM> c = nullptr) const;
+
+        // 编辑 TAC 链表，同时维护基本块的首尾
+        void insert_after(std::shared_ptr<TAC> node, std::shared_ptr<TAC> position, std::shared_ptr<BasicBlock> block);
+        void append_to_block(std::shared_ptr<TAC> node, std::shared_ptr<BasicBlock> block);
+        bool remove_from_block(std::shared_ptr<TAC> node, std::shared_ptr<BasicBlock> block);
         
         // 局部优化（基本块内）
         bool local_constant_folding(std::shared_ptr<TAC> tac,std::shared_ptr<TAC> end);
@@ -30,25 +55,34 @@ namespace twlm::ccpl::modules
         void optimize_block_local(std::shared_ptr<BasicBlock> block);
         
         // 全局优化（基于数据流分析）
-        bool global_constant_propagation(const std::vector<std::shared_ptr<BasicBlock>>& blocks);
+        bool sparse_conditional_constant_propagation();
+        bool value_range_propagation();
         bool global_dead_code_elimination(const std::vector<std::shared_ptr<BasicBlock>>& blocks);
+        bool dead_store_elimination(const std::vector<std::shared_ptr<BasicBlock>>& blocks);
         
         // 高级优化
-        bool common_subexpression_elimination(std::shared_ptr<BasicBlock> block);
-        bool loop_invariant_code_motion(std::shared_ptr<BasicBlock> loop_header);
+        bool global_value_numbering();
+        bool scalar_replacement_of_aggregates();
+        bool redundant_load_elimination();
+        bool lazy_code_motion();
+        bool loop_invariant_code_motion(std::shared_ptr<Loop> loop);
+        bool strength_reduction(std::shared_ptr<Loop> loop, const RangeAnalysis& ranges);
+        bool loop_unrolling(std::shared_ptr<Loop> loop);
+        bool loop_rotation(std::shared_ptr<Loop> loop);
+        bool tail_recursion_elimination();
+        bool function_inlining();
+        bool interprocedural_constant_propagation();
+        bool compile_time_evaluation();
+        void remove_uncalled_functions(const std::unordered_set<std::string>& names);
+        bool global_variable_promotion();
         bool simplify_control_flow(std::shared_ptr<TAC> tac_start);
+        bool jump_threading();
         bool eliminate_unreachable_code(std::vector<std::shared_ptr<BasicBlock>>& blocks);
         bool eliminate_unused_var_declarations(std::shared_ptr<TAC> tac_start);
         
-        // 辅助函数
-        bool is_loop_header(std::shared_ptr<BasicBlock> block) const;
-        void find_loop_blocks(std::shared_ptr<BasicBlock> header,
-                             std::unordered_set<std::shared_ptr<BasicBlock>>& loop_blocks) const;
-        std::string get_expression_key(std::shared_ptr<TAC> tac) const;
-        
     public:
-        TACOptimizer(std::shared_ptr<TAC> first)
-            : tac_first(first), block_builder(first) {}
+        TACOptimizer(std::shared_ptr<TAC> first, UnrollOptions unroll = {})
+            : tac_first(first), block_builder(first), unroll_options(unroll) {}
         void optimize();
     };
 }
\ No newline at end of file
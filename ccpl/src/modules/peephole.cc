@@ -0,0 +1,388 @@
+#include "peephole.hh"
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+using namespace twlm::ccpl::modules;
+using namespace twlm::ccpl::abstraction;
+
+namespace
+{
+    // Register number of a plain register operand, -1 for anything else
+    int reg_of(const MOperand& opnd)
+    {
+        return opnd.kind == MOPND_KIND::REG ? opnd.base : -1;
+    }
+
+    // Constants and labels
+    bool is_imm(const MOperand& opnd)
+    {
+        return opnd.kind == MOPND_KIND::IMM || opnd.kind == MOPND_KIND::LABEL;
+    }
+
+    bool is_jump(const std::string& op)
+    {
+        return op == "JMP" || op == "JEZ" || op == "JLZ" || op == "JGZ";
+    }
+
+    // Labels the compiler made up for the TAC (L1, L2, ...)
+    bool is_local_label(const std::string& s)
+    {
+        return s.size() >= 2 && s[0] == 'L' &&
+               std::all_of(s.begin() + 1, s.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+    }
+}
+
+void twlm::ccpl::modules::print_code(const MCode& code, std::ostream& os)
+{
+    // Every instruction is 8 bytes
+    std::unordered_map<std::shared_ptr<MInst>, int> addr;
+    int n = 0;
+    for (const auto& inst : code)
+    {
+        if (inst->kind == MINST_KIND::INSN)
+            addr[inst] = 8 * n++;
+    }
+
+    for (const auto& inst : code)
+    {
+        if (inst->kind == MINST_KIND::COMMENT)
+        {
+            os << "\n" << inst->to_string() << "\n";
+            continue;
+        }
+        MInst laid_out = *inst;
+        for (auto& arg : laid_out.args)
+        {
+            if (arg.kind == MOPND_KIND::INSN)
+                arg.value = addr.at(arg.insn) - addr.at(inst);
+        }
+        os << laid_out.to_string() << "\n";
+    }
+}
+
+void PeepholeOptimizer::count(const std::string& rule, int n)
+{
+    for (auto& stat : stats)
+    {
+        if (stat.first == rule)
+        {
+            stat.second += n;
+            return;
+        }
+    }
+    stats.emplace_back(rule, n);
+}
+
+void PeepholeOptimizer::collect_targets()
+{
+    targets.clear();
+    for (const auto& inst : code)
+    {
+        for (const auto& arg : inst->args)
+        {
+            if (arg.kind == MOPND_KIND::INSN)
+                targets.insert(arg.insn);
+        }
+    }
+}
+
+bool PeepholeOptimizer::is_barrier(const std::shared_ptr<MInst>& inst) const
+{
+    // Control can arrive here from somewhere else
+    return inst->kind == MINST_KIND::LABEL || targets.count(inst);
+}
+
+bool PeepholeOptimizer::forward_values()
+{
+    bool changed = false;
+
+    // Value numbers of registers and memory words along straight-line code
+    int next_val = 1;
+    std::unordered_map<int, int> val;
+    std::unordered_map<std::string, int> imm_val;
+    std::map<std::pair<int, int>, int> mem_val;  // (base, disp) -> value
+
+    auto reset = [&]()
+    {
+        val.clear();
+        mem_val.clear();
+    };
+    auto value_of = [&](int r)
+    {
+        int& v = val[r];
+        if (v == 0)
+            v = next_val++;
+        return v;
+    };
+    auto holds = [&](int r, int v)
+    {
+        auto it = val.find(r);
+        return it != val.end() && it->second == v;
+    };
+    auto write = [&](int r, int v)
+    {
+        val[r] = v;
+        // Memory words addressed through r are no longer known
+        for (auto it = mem_val.begin(); it != mem_val.end();)
+        {
+            if (it->first.first == r)
+                it = mem_val.erase(it);
+            else
+                ++it;
+        }
+    };
+    auto clobber = [&](const MOperand& mem, int width)
+    {
+        // Only words at the same base and a disjoint offset survive
+        bool known = mem.kind == MOPND_KIND::MEM;
+        for (auto it = mem_val.begin(); it != mem_val.end();)
+        {
+            auto [b, d] = it->first;
+            if (known && b == mem.base && (d + 4 <= mem.value || mem.value + width <= d))
+                ++it;
+            else
+                it = mem_val.erase(it);
+        }
+    };
+
+    for (size_t i = 0; i < code.size();)
+    {
+        auto inst = code[i];
+        if (is_barrier(inst))
+        {
+            reset();
+        }
+        if (inst->kind != MINST_KIND::INSN)
+        {
+            i++;
+            continue;
+        }
+
+        const auto& op = inst->op;
+        auto& args = inst->args;
+        std::string rule;
+
+        if (op == "LOD" && args.size() == 2 && reg_of(args[0]) >= 0)
+        {
+            int x = reg_of(args[0]);
+            int y = reg_of(args[1]);
+
+            if (y >= 0)
+            {
+                if (x == y)
+                    rule = "self_move";
+                else if (holds(x, value_of(y)))
+                    rule = "redundant_move";
+                else
+                    write(x, value_of(y));
+            }
+            else if (args[1].kind == MOPND_KIND::MEM)
+            {
+                std::pair<int, int> word{args[1].base, args[1].value};
+                auto it = mem_val.find(word);
+                if (it == mem_val.end())
+                {
+                    int v = next_val++;
+                    write(x, v);
+                    if (word.first != x)
+                        mem_val[word] = v;
+                }
+                else if (holds(x, it->second))
+                {
+                    rule = "store_reload";
+                }
+                else
+                {
+                    // Another register still has the stored value
+                    int v = it->second;
+                    for (const auto& [r, rv] : val)
+                    {
+                        if (rv == v)
+                        {
+                            args[1] = MOperand::reg(r);
+                            count("load_forward");
+                            changed = true;
+                            break;
+                        }
+                    }
+                    write(x, v);
+                }
+            }
+            else if (is_imm(args[1]))
+            {
+                int& k = imm_val[args[1].to_string()];
+                if (k == 0)
+                    k = next_val++;
+                if (holds(x, k))
+                    rule = "redundant_imm";
+                else
+                    write(x, k);
+            }
+            else
+            {
+                write(x, next_val++);
+            }
+        }
+        else if (op == "STO" || op == "STC")
+        {
+            clobber(args[0], op == "STO" ? 4 : 1);
+            int r = args.size() == 2 ? reg_of(args[1]) : -1;
+            if (op == "STO" && r >= 0 && args[0].kind == MOPND_KIND::MEM)
+                mem_val[{args[0].base, args[0].value}] = value_of(r);
+        }
+        else if (op == "LDC" || op == "ADD" || op == "SUB" || op == "MUL" || op == "DIV")
+        {
+            write(reg_of(args[0]), next_val++);
+        }
+        else if (op == "ITI" || op == "ITC")
+        {
+            write(15, next_val++);
+        }
+        else if (op == "JMP" || op == "END" || op == "DBN" || op == "DBS")
+        {
+            // Calls clobber everything; TST, OT* and conditional jumps
+            // leave registers and memory alone
+            reset();
+        }
+
+        if (!rule.empty() && !targets.count(inst))
+        {
+            count(rule);
+            code.erase(code.begin() + i);
+            changed = true;
+            continue;
+        }
+        i++;
+    }
+
+    return changed;
+}
+
+bool PeepholeOptimizer::remove_jump_to_next()
+{
+    bool changed = false;
+
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        auto inst = code[i];
+        if (inst->kind != MINST_KIND::INSN || !is_jump(inst->op) || inst->args.size() != 1 ||
+            targets.count(inst))
+        {
+            continue;
+        }
+
+        // Only labels and comments may separate the jump from its label
+        for (size_t j = i + 1; j < code.size() && code[j]->kind != MINST_KIND::INSN; j++)
+        {
+            if (code[j]->kind == MINST_KIND::LABEL && inst->args[0].kind == MOPND_KIND::LABEL &&
+                code[j]->op == inst->args[0].name)
+            {
+                count("jump_to_next");
+                code.erase(code.begin() + i);
+                changed = true;
+                i--;
+                break;
+            }
+        }
+    }
+
+    return changed;
+}
+
+bool PeepholeOptimizer::remove_unreachable()
+{
+    bool changed = false;
+    bool dead = false;
+
+    for (size_t i = 0; i < code.size();)
+    {
+        auto inst = code[i];
+        if (is_barrier(inst))
+        {
+            dead = false;
+        }
+        if (inst->kind != MINST_KIND::INSN)
+        {
+            i++;
+            continue;
+        }
+        if (dead)
+        {
+            count("unreachable");
+            code.erase(code.begin() + i);
+            changed = true;
+            continue;
+        }
+        dead = inst->op == "JMP" || inst->op == "END";
+        i++;
+    }
+
+    return changed;
+}
+
+bool PeepholeOptimizer::remove_unused_labels()
+{
+    bool changed = false;
+
+    std::unordered_set<std::string> used;
+    for (const auto& inst : code)
+    {
+        if (inst->kind != MINST_KIND::INSN)
+            continue;
+        for (const auto& arg : inst->args)
+        {
+            if (arg.kind == MOPND_KIND::LABEL)
+                used.insert(arg.name);
+        }
+    }
+
+    for (size_t i = 0; i < code.size();)
+    {
+        const auto& inst = code[i];
+        if (inst->kind == MINST_KIND::LABEL && is_local_label(inst->op) &&
+            !used.count(inst->op) && !targets.count(inst))
+        {
+            count("unused_label");
+            code.erase(code.begin() + i);
+            changed = true;
+            continue;
+        }
+        i++;
+    }
+
+    return changed;
+}
+
+void PeepholeOptimizer::optimize()
+{
+    stats.clear();
+    for (const char* rule : {"self_move", "redundant_move", "store_reload", "redundant_imm",
+                             "load_forward", "jump_to_next", "unreachable", "unused_label"})
+    {
+        stats.emplace_back(rule, 0);
+    }
+
+    collect_targets();
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        changed |= remove_unreachable();
+        changed |= remove_jump_to_next();
+        changed |= remove_unused_labels();
+        changed |= forward_values();
+    }
+}
+
+void PeepholeOptimizer::report(std::ostream& os) const
+{
+    os << "=== Peephole Optimization ===" << std::endl;
+    for (const auto& [rule, n] : stats)
+    {
+        os << "  " << rule << ": " << n << (rule == "load_forward" ? " rewritten" : " removed") << std::endl;
+    }
+}
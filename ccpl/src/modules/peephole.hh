@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <vector>
+#include <iostream>
+#include <unordered_set>
+#include "abstraction/minst_struct.hh"
+
+namespace twlm::ccpl::modules
+{
+    using namespace twlm::ccpl::abstraction;
+    using MCode = std::vector<std::shared_ptr<MInst>>;
+
+    // Print the code, writing each instruction address operand as an
+    // offset from R1, the address of the instruction being executed
+    void print_code(const MCode& code, std::ostream& os);
+
+    // Pattern-driven peephole pass over register-allocated machine code
+    class PeepholeOptimizer
+    {
+    private:
+        MCode& code;
+        std::unordered_set<std::shared_ptr<MInst>> targets;  // Instructions whose address is taken
+        std::vector<std::pair<std::string, int>> stats;      // Instructions changed per rule
+
+        void count(const std::string& rule, int n = 1);
+        void collect_targets();
+        bool is_barrier(const std::shared_ptr<MInst>& inst) const;
+
+        // Rules, each returns true if it changed the code
+        bool forward_values();       // LOD Rx,Rx / redundant moves, reloads and immediates
+        bool remove_jump_to_next();  // JMP L immediately followed by L:
+        bool remove_unreachable();   // Code after an unconditional JMP
+        bool remove_unused_labels(); // Compiler labels nobody jumps to
+
+    public:
+        PeepholeOptimizer(MCode& code) : code(code) {}
+        void optimize();
+        void report(std::ostream& os) const;
+    };
+}
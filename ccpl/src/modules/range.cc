@@ -0,0 +1,547 @@
+#include "range.hh"
+#include <algorithm>
+#include <map>
+using namespace twlm::ccpl::modules;
+
+namespace
+{
+    const int WIDEN_AFTER = 2;     // 循环头访问几次之后开始加宽
+    const int NARROW_PASSES = 2;
+
+    std::shared_ptr<SYM> constant(long long value)
+    {
+        auto sym = std::make_shared<SYM>();
+        sym->type = SYM_TYPE::CONST_INT;
+        sym->data_type = DATA_TYPE::INT;
+        sym->value = static_cast<int>(value);
+        return sym;
+    }
+
+    bool is_compare(TAC_OP op)
+    {
+        return op == TAC_OP::EQ || op == TAC_OP::NE || op == TAC_OP::LT ||
+               op == TAC_OP::LE || op == TAC_OP::GT || op == TAC_OP::GE;
+    }
+
+    // x op y 等价于 y swapped(op) x
+    TAC_OP swapped(TAC_OP op)
+    {
+        switch (op)
+        {
+        case TAC_OP::LT: return TAC_OP::GT;
+        case TAC_OP::LE: return TAC_OP::GE;
+        case TAC_OP::GT: return TAC_OP::LT;
+        case TAC_OP::GE: return TAC_OP::LE;
+        default: return op;
+        }
+    }
+
+    TAC_OP negated(TAC_OP op)
+    {
+        switch (op)
+        {
+        case TAC_OP::LT: return TAC_OP::GE;
+        case TAC_OP::LE: return TAC_OP::GT;
+        case TAC_OP::GT: return TAC_OP::LE;
+        case TAC_OP::GE: return TAC_OP::LT;
+        case TAC_OP::EQ: return TAC_OP::NE;
+        default: return TAC_OP::EQ;
+        }
+    }
+
+    // 已知 x fact y 成立时 x query y 的结果
+    std::optional<bool> implied(TAC_OP fact, TAC_OP query)
+    {
+        if (fact == query)
+            return true;
+        if (fact == negated(query))
+            return false;
+        switch (fact)
+        {
+        case TAC_OP::LT:
+        case TAC_OP::GT:
+            if (query == TAC_OP::NE || query == (fact == TAC_OP::LT ? TAC_OP::LE : TAC_OP::GE))
+                return true;
+            if (query == TAC_OP::EQ || query == (fact == TAC_OP::LT ? TAC_OP::GT : TAC_OP::LT))
+                return false;
+            break;
+        case TAC_OP::EQ:
+            if (query == TAC_OP::LE || query == TAC_OP::GE)
+                return true;
+            if (query == TAC_OP::LT || query == TAC_OP::GT)
+                return false;
+            break;
+        default:
+            break;
+        }
+        return std::nullopt;
+    }
+
+    RangeState join(const RangeState &a, const RangeState &b)
+    {
+        if (!a.reachable)
+            return b;
+        if (!b.reachable)
+            return a;
+        RangeState result;
+        result.reachable = true;
+        for (auto &[sym, x] : a.ranges)
+        {
+            auto it = b.ranges.find(sym);
+            if (it != b.ranges.end())
+                result.ranges[sym] = {std::min(x.lo, it->second.lo), std::max(x.hi, it->second.hi)};
+        }
+        for (auto &fact : a.facts)
+        {
+            if (b.facts.count(fact))
+                result.facts.insert(fact);
+        }
+        return result;
+    }
+
+    // 加宽：结果包含旧状态，还在变大的端点直接放到无界，保证循环头的状态只增不减
+    RangeState widen(const RangeState &old, const RangeState &state)
+    {
+        if (!old.reachable)
+            return state;
+        auto result = join(old, state);
+        for (auto it = result.ranges.begin(); it != result.ranges.end();)
+        {
+            auto &prev = old.ranges.at(it->first);
+            if (it->second.lo < prev.lo)
+                it->second.lo = INT_MIN;
+            if (it->second.hi > prev.hi)
+                it->second.hi = INT_MAX;
+            if (it->second.is_full())
+                it = result.ranges.erase(it);
+            else
+                ++it;
+        }
+        return result;
+    }
+}
+
+ValueRange RangeState::range(const std::shared_ptr<SYM> &sym) const
+{
+    int value;
+    if (sym && sym->get_const_value(value))
+        return {value, value};
+    auto it = ranges.find(sym);
+    return it != ranges.end() ? it->second : ValueRange{};
+}
+
+std::optional<bool> RangeState::evaluate(TAC_OP op, const std::shared_ptr<SYM> &x, const std::shared_ptr<SYM> &y) const
+{
+    auto a = range(x), b = range(y);
+    switch (op)
+    {
+    case TAC_OP::LT:
+        if (a.hi < b.lo) return true;
+        if (a.lo >= b.hi) return false;
+        break;
+    case TAC_OP::LE:
+        if (a.hi <= b.lo) return true;
+        if (a.lo > b.hi) return false;
+        break;
+    case TAC_OP::GT:
+        if (a.lo > b.hi) return true;
+        if (a.hi <= b.lo) return false;
+        break;
+    case TAC_OP::GE:
+        if (a.lo >= b.hi) return true;
+        if (a.hi < b.lo) return false;
+        break;
+    case TAC_OP::EQ:
+    case TAC_OP::NE:
+        if (a.is_constant() && b.is_constant() && a.lo == b.lo)
+            return op == TAC_OP::EQ;
+        if (a.hi < b.lo || b.hi < a.lo)
+            return op == TAC_OP::NE;
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    if (x == y && x->type == SYM_TYPE::VAR)
+        return op == TAC_OP::EQ || op == TAC_OP::LE || op == TAC_OP::GE;
+    for (auto &[fact, fx, fy] : facts)
+    {
+        if (fx == x && fy == y)
+        {
+            if (auto known = implied(fact, op))
+                return known;
+        }
+        else if (fx == y && fy == x)
+        {
+            if (auto known = implied(swapped(fact), op))
+                return known;
+        }
+    }
+    return std::nullopt;
+}
+
+bool RangeState::operator==(const RangeState &other) const
+{
+    return reachable == other.reachable && ranges == other.ranges && facts == other.facts;
+}
+
+bool RangeAnalysis::is_tracked(const std::shared_ptr<SYM> &sym) const
+{
+    return sym && sym->type == SYM_TYPE::VAR && !sym->is_array && !sym->is_pointer &&
+           (sym->data_type == DATA_TYPE::INT || sym->data_type == DATA_TYPE::CHAR) &&
+           !block_builder.is_memory_var(sym);
+}
+
+// 超出 int 的结果可能回绕，按无界处理；字符变量跨块时按字节存取，只保留 0 到 127 之间的范围
+void RangeAnalysis::set_range(RangeState &state, const std::shared_ptr<SYM> &sym, ValueRange range) const
+{
+    if (range.lo < INT_MIN || range.hi > INT_MAX ||
+        (sym->data_type == DATA_TYPE::CHAR && (range.lo < 0 || range.hi > 127)))
+        range = ValueRange{};
+    if (range.is_full())
+        state.ranges.erase(sym);
+    else
+        state.ranges[sym] = range;
+}
+
+// 假定 x op y 成立，收窄两边的范围；范围变空说明这条路径走不到
+void RangeAnalysis::assume(RangeState &state, TAC_OP op, const std::shared_ptr<SYM> &x, const std::shared_ptr<SYM> &y) const
+{
+    if (op == TAC_OP::GT || op == TAC_OP::GE)
+    {
+        assume(state, swapped(op), y, x);
+        return;
+    }
+
+    auto a = state.range(x), b = state.range(y);
+    switch (op)
+    {
+    case TAC_OP::LT:
+    case TAC_OP::LE:
+    {
+        long long gap = op == TAC_OP::LT ? 1 : 0;
+        a.hi = std::min(a.hi, b.hi - gap);
+        b.lo = std::max(b.lo, a.lo + gap);
+        break;
+    }
+    case TAC_OP::EQ:
+        a.lo = b.lo = std::max(a.lo, b.lo);
+        a.hi = b.hi = std::min(a.hi, b.hi);
+        break;
+    case TAC_OP::NE:
+        // 区间只能去掉端点上的值
+        if (b.is_constant() && a.lo == b.lo)
+            a.lo++;
+        else if (b.is_constant() && a.hi == b.lo)
+            a.hi--;
+        if (a.is_constant() && b.lo == a.lo)
+            b.lo++;
+        else if (a.is_constant() && b.hi == a.lo)
+            b.hi--;
+        break;
+    default:
+        return;
+    }
+
+    if (a.is_empty() || b.is_empty())
+    {
+        state.reachable = false;
+        return;
+    }
+    if (is_tracked(x))
+        set_range(state, x, a);
+    if (is_tracked(y))
+        set_range(state, y, b);
+    if (is_tracked(x) && is_tracked(y) && x != y)
+        state.facts.insert({op, x, y});
+}
+
+void RangeAnalysis::transfer(const std::shared_ptr<TAC> &tac, RangeState &state) const
+{
+    auto def = tac->get_def();
+    if (!def)
+        return;
+    for (auto it = state.facts.begin(); it != state.facts.end();)
+    {
+        if (std::get<1>(*it) == def || std::get<2>(*it) == def)
+            it = state.facts.erase(it);
+        else
+            ++it;
+    }
+    if (!is_tracked(def))
+        return;
+
+    ValueRange result;
+    auto a = state.range(tac->b), b = state.range(tac->c);
+    switch (tac->op)
+    {
+    case TAC_OP::COPY:
+        result = a;
+        break;
+    case TAC_OP::ADD:
+        result = {a.lo + b.lo, a.hi + b.hi};
+        break;
+    case TAC_OP::SUB:
+        result = {a.lo - b.hi, a.hi - b.lo};
+        break;
+    case TAC_OP::NEG:
+        result = {-a.hi, -a.lo};
+        break;
+    case TAC_OP::MUL:
+    case TAC_OP::DIV:
+    {
+        // 除数不含 0 时，截断除法在两个端点之间单调
+        if (tac->op == TAC_OP::DIV && b.contains(0))
+            break;
+        long long corners[4];
+        int n = 0;
+        for (long long x : {a.lo, a.hi})
+        {
+            for (long long y : {b.lo, b.hi})
+                corners[n++] = tac->op == TAC_OP::MUL ? x * y : x / y;
+        }
+        result = {*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4)};
+        break;
+    }
+    default:
+        if (is_compare(tac->op))
+        {
+            auto known = state.evaluate(tac->op, tac->b, tac->c);
+            result = known ? ValueRange{*known, *known} : ValueRange{0, 1};
+        }
+        break;
+    }
+    set_range(state, def, result);
+}
+
+RangeState RangeAnalysis::block_out(const std::shared_ptr<BasicBlock> &block) const
+{
+    auto state = block_in.at(block);
+    for (auto tac = block->start; tac && state.reachable; tac = tac->next)
+    {
+        transfer(tac, state);
+        if (tac == block->end)
+            break;
+    }
+    return state;
+}
+
+// IFZ 的第一个后继是跳转（条件为 0），第二个是顺序执行
+RangeState RangeAnalysis::edge_state(const std::shared_ptr<BasicBlock> &block, size_t succ, RangeState state) const
+{
+    auto end = block->end;
+    if (!state.reachable || end->op != TAC_OP::IFZ || block->successors.size() != 2 ||
+        block->successors[0] == block->successors[1])
+        return state;
+    bool taken = succ == 0;
+    auto cond = end->b;
+    auto zero = constant(0);
+    int value;
+    if (cond->get_const_value(value))
+    {
+        state.reachable = (value == 0) == taken;
+        return state;
+    }
+    if (!is_tracked(cond))
+        return state;
+
+    // 条件在本块中的定值，定值之后操作数没有被改写
+    std::shared_ptr<TAC> def = nullptr;
+    for (auto tac = end == block->start ? nullptr : end->prev; tac && !def; tac = tac == block->start ? nullptr : tac->prev)
+    {
+        if (tac->get_def() == cond)
+            def = tac;
+    }
+    if (def && (def->b == cond || def->c == cond))
+        def = nullptr;
+    for (auto tac = def ? def->next : end; def && tac != end; tac = tac->next)
+    {
+        auto redefined = tac->get_def();
+        if (redefined && (redefined == def->b || redefined == def->c))
+            def = nullptr;
+    }
+
+    assume(state, taken ? TAC_OP::EQ : TAC_OP::NE, cond, zero);
+    if (!def || !state.reachable)
+        return state;
+    if (is_compare(def->op))
+    {
+        assume(state, taken ? negated(def->op) : def->op, def->b, def->c);
+    }
+    else if ((def->op == TAC_OP::SUB || def->op == TAC_OP::ADD) && def->c->get_const_value(value))
+    {
+        // switch 的 t = x - c：t 为 0 即 x == c
+        auto target = constant(def->op == TAC_OP::SUB ? value : -static_cast<long long>(value));
+        assume(state, taken ? TAC_OP::EQ : TAC_OP::NE, def->b, target);
+    }
+    return state;
+}
+
+void RangeAnalysis::analyze_function(const FunctionCFG &func)
+{
+    // 逆后序，指向序号不大于自己的块的边是回边
+    std::vector<std::shared_ptr<BasicBlock>> order;
+    std::unordered_map<std::shared_ptr<BasicBlock>, int> index;
+    std::function<void(const std::shared_ptr<BasicBlock> &)> dfs = [&](const std::shared_ptr<BasicBlock> &block) {
+        index[block] = -1;
+        for (auto &succ : block->successors)
+        {
+            if (!index.count(succ))
+                dfs(succ);
+        }
+        order.push_back(block);
+    };
+    auto entry = func.blocks.front();
+    dfs(entry);
+    std::reverse(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); i++)
+        index[order[i]] = static_cast<int>(i);
+
+    std::unordered_set<std::shared_ptr<BasicBlock>> headers;
+    for (auto &block : order)
+    {
+        for (auto &succ : block->successors)
+        {
+            if (index[succ] <= index[block])
+                headers.insert(succ);
+        }
+    }
+    for (auto &block : func.blocks)
+        block_in[block] = RangeState{};
+
+    auto incoming = [&](const std::shared_ptr<BasicBlock> &block, std::unordered_map<std::shared_ptr<BasicBlock>, RangeState> &out) {
+        RangeState state;
+        if (block == entry)
+        {
+            state.reachable = true;
+            return state;
+        }
+        for (auto &pred : block->predecessors)
+        {
+            auto it = out.find(pred);
+            if (it == out.end())
+                continue;
+            for (size_t k = 0; k < pred->successors.size(); k++)
+            {
+                if (pred->successors[k] == block)
+                    state = join(state, edge_state(pred, k, it->second));
+            }
+        }
+        return state;
+    };
+
+    std::unordered_map<std::shared_ptr<BasicBlock>, RangeState> out;
+    std::unordered_map<std::shared_ptr<BasicBlock>, int> visits;
+    std::set<int> worklist{0};
+    while (!worklist.empty())
+    {
+        auto block = order[*worklist.begin()];
+        worklist.erase(worklist.begin());
+
+        auto state = incoming(block, out);
+        if (headers.count(block) && visits[block] >= WIDEN_AFTER)
+            state = widen(block_in[block], state);
+        if (visits[block]++ > 0 && state == block_in[block])
+            continue;
+        block_in[block] = state;
+        out[block] = block_out(block);
+        for (auto &succ : block->successors)
+            worklist.insert(index[succ]);
+    }
+
+    // 从加宽得到的不动点出发再迭代几遍，收回加宽时放得过宽的端点
+    for (int pass = 0; pass < NARROW_PASSES; pass++)
+    {
+        for (auto &block : order)
+        {
+            block_in[block] = incoming(block, out);
+            out[block] = block_out(block);
+        }
+    }
+}
+
+void RangeAnalysis::compute()
+{
+    block_in.clear();
+    tac_block.clear();
+    for (auto &block : block_builder.get_basic_blocks())
+    {
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            tac_block[tac] = block;
+            if (tac == block->end)
+                break;
+        }
+    }
+    for (auto &func : block_builder.get_functions())
+    {
+        if (!func.blocks.empty())
+            analyze_function(func);
+    }
+}
+
+void RangeAnalysis::visit(const std::shared_ptr<BasicBlock> &block,
+                          const std::function<void(const std::shared_ptr<TAC> &, const RangeState &)> &callback) const
+{
+    auto it = block_in.find(block);
+    if (it == block_in.end() || !it->second.reachable)
+        return;
+    auto state = it->second;
+    for (auto tac = block->start; tac && state.reachable; tac = tac->next)
+    {
+        callback(tac, state);
+        transfer(tac, state);
+        if (tac == block->end)
+            break;
+    }
+}
+
+ValueRange RangeAnalysis::range_at(const std::shared_ptr<TAC> &tac, const std::shared_ptr<SYM> &sym) const
+{
+    auto it = tac_block.find(tac);
+    if (it == tac_block.end())
+        return {};
+    ValueRange range;
+    bool found = false;
+    visit(it->second, [&](const std::shared_ptr<TAC> &current, const RangeState &state) {
+        if (current == tac && !found)
+        {
+            range = state.range(sym);
+            found = true;
+        }
+    });
+    return range;
+}
+
+std::vector<std::pair<std::shared_ptr<BasicBlock>, bool>> RangeAnalysis::branch_path(
+    const std::shared_ptr<BasicBlock> &pred, const std::shared_ptr<BasicBlock> &block,
+    const std::function<bool(const std::shared_ptr<BasicBlock> &)> &can_pass) const
+{
+    std::vector<std::pair<std::shared_ptr<BasicBlock>, bool>> path;
+    auto it = block_in.find(pred);
+    if (it == block_in.end() || !it->second.reachable)
+        return path;
+
+    auto state = block_out(pred);
+    std::unordered_set<std::shared_ptr<BasicBlock>> seen{pred};
+    for (auto from = pred, to = block; seen.insert(to).second && to->end->op == TAC_OP::IFZ && can_pass(to);)
+    {
+        auto &succs = from->successors;
+        if (std::count(succs.begin(), succs.end(), to) != 1)
+            break;
+        state = edge_state(from, std::find(succs.begin(), succs.end(), to) - succs.begin(), state);
+        for (auto tac = to->start; tac != to->end && state.reachable; tac = tac->next)
+            transfer(tac, state);
+        if (!state.reachable)
+            break;
+
+        auto cond = state.range(to->end->b);
+        bool taken = cond.is_constant() && cond.lo == 0;
+        if (!taken && cond.contains(0))
+            break;
+        path.push_back({to, taken});
+        from = to;
+        to = to->successors[taken ? 0 : 1];
+    }
+    return path;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <climits>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include "block.hh"
+
+namespace twlm::ccpl::modules
+{
+    using namespace twlm::ccpl::abstraction;
+
+    // 整数的取值范围 [lo, hi]，端点到达 int 的边界即为无界
+    struct ValueRange
+    {
+        long long lo = INT_MIN;
+        long long hi = INT_MAX;
+
+        bool is_full() const { return lo <= INT_MIN && hi >= INT_MAX; }
+        bool is_empty() const { return lo > hi; }
+        bool is_constant() const { return lo == hi; }
+        bool contains(long long value) const { return lo <= value && value <= hi; }
+        bool operator==(const ValueRange &other) const { return lo == other.lo && hi == other.hi; }
+    };
+
+    // 程序点上的范围信息：变量的取值范围，以及已知成立的变量之间的比较 x op y
+    struct RangeState
+    {
+        bool reachable = false;
+        std::unordered_map<std::shared_ptr<SYM>, ValueRange> ranges;  // 没有记录的变量无界
+        std::set<std::tuple<TAC_OP, std::shared_ptr<SYM>, std::shared_ptr<SYM>>> facts;
+
+        ValueRange range(const std::shared_ptr<SYM> &sym) const;
+        // x op y 的结果已知时返回它
+        std::optional<bool> evaluate(TAC_OP op, const std::shared_ptr<SYM> &x, const std::shared_ptr<SYM> &y) const;
+        bool operator==(const RangeState &other) const;
+    };
+
+    // 值域分析：在控制流图上前向传播区间，IFZ 的两条出边按条件收窄操作数的范围
+    // （包括 switch 降级出的 t = x - c; ifz t），循环头在几轮之后加宽，收敛后再收窄。
+    // 只跟踪不在内存中的整数和字符标量，它们的定值都显式出现在 TAC 中
+    class RangeAnalysis
+    {
+    private:
+        BlockBuilder &block_builder;
+        std::unordered_map<std::shared_ptr<BasicBlock>, RangeState> block_in;
+        std::unordered_map<std::shared_ptr<TAC>, std::shared_ptr<BasicBlock>> tac_block;
+
+        bool is_tracked(const std::shared_ptr<SYM> &sym) const;
+        void set_range(RangeState &state, const std::shared_ptr<SYM> &sym, ValueRange range) const;
+        void assume(RangeState &state, TAC_OP op, const std::shared_ptr<SYM> &x, const std::shared_ptr<SYM> &y) const;
+        void transfer(const std::shared_ptr<TAC> &tac, RangeState &state) const;
+        RangeState block_out(const std::shared_ptr<BasicBlock> &block) const;
+        RangeState edge_state(const std::shared_ptr<BasicBlock> &block, size_t succ, RangeState state) const;
+        void analyze_function(const FunctionCFG &func);
+
+    public:
+        RangeAnalysis(BlockBuilder &block_builder) : block_builder(block_builder) {}
+
+        void compute();
+
+        // 依次访问块中的指令，回调拿到执行该指令之前的状态，可以就地改写指令；不可达的块不访问
+        void visit(const std::shared_ptr<BasicBlock> &block,
+                   const std::function<void(const std::shared_ptr<TAC> &, const RangeState &)> &callback) const;
+        // 执行 tac 之前 sym 的取值范围，分析之后新加的指令返回无界
+        ValueRange range_at(const std::shared_ptr<TAC> &tac, const std::shared_ptr<SYM> &sym) const;
+        // 从 pred 沿边进入 block 后，依次经过末尾 IFZ 走向确定、且 can_pass 允许的块，
+        // 返回这些块和各自的走向（true 为跳转，false 为顺序执行）
+        std::vector<std::pair<std::shared_ptr<BasicBlock>, bool>> branch_path(
+            const std::shared_ptr<BasicBlock> &pred, const std::shared_ptr<BasicBlock> &block,
+            const std::function<bool(const std::shared_ptr<BasicBlock> &)> &can_pass) const;
+    };
+}
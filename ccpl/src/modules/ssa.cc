@@ -0,0 +1,196 @@
+#include "ssa.hh"
+#include <unordered_set>
+using namespace twlm::ccpl::modules;
+
+bool SSABuilder::is_ssa_var(std::shared_ptr<SYM> sym) const
+{
+    return sym && sym->type == SYM_TYPE::VAR && !sym->is_array &&
+           sym->data_type != DATA_TYPE::STRUCT && !block_builder.is_memory_var(sym);
+}
+
+int SSABuilder::new_value(std::shared_ptr<SYM> var, std::shared_ptr<TAC> def,
+                          std::shared_ptr<BasicBlock> block, bool is_phi)
+{
+    int id = values.size();
+    values.emplace_back(id, var, def, block, is_phi);
+    return id;
+}
+
+void SSABuilder::build()
+{
+    values.clear();
+    def_values.clear();
+    use_values.clear();
+    block_phis.clear();
+
+    block_builder.compute_dominators();
+    for (auto &func : block_builder.get_functions())
+    {
+        if (!func.blocks.empty())
+            build_function(func);
+    }
+}
+
+void SSABuilder::build_function(const FunctionCFG &func)
+{
+    insert_phis(func);
+
+    RenameStacks stacks;
+    auto entry = func.blocks.front();
+    rename(entry, stacks, entry);
+}
+
+// 在每个变量定值所在块的迭代支配边界上放置 phi
+void SSABuilder::insert_phis(const FunctionCFG &func)
+{
+    std::unordered_map<std::shared_ptr<SYM>, std::vector<std::shared_ptr<BasicBlock>>> def_sites;
+    std::vector<std::shared_ptr<SYM>> vars;  // 保持程序顺序，使 phi 的顺序稳定
+
+    for (auto &block : func.blocks)
+    {
+        for (auto tac = block->start; tac; tac = tac->next)
+        {
+            auto def = tac->get_def();
+            if (is_ssa_var(def))
+            {
+                auto &sites = def_sites[def];
+                if (sites.empty())
+                    vars.push_back(def);
+                if (sites.empty() || sites.back() != block)
+                    sites.push_back(block);
+            }
+            if (tac == block->end)
+                break;
+        }
+    }
+
+    for (auto &var : vars)
+    {
+        std::unordered_set<std::shared_ptr<BasicBlock>> has_phi;
+        std::unordered_set<std::shared_ptr<BasicBlock>> queued(def_sites[var].begin(), def_sites[var].end());
+        std::vector<std::shared_ptr<BasicBlock>> worklist = def_sites[var];
+
+        while (!worklist.empty())
+        {
+            auto block = worklist.back();
+            worklist.pop_back();
+            for (auto &frontier : block_builder.get_dominance_frontier(block))
+            {
+                if (!has_phi.insert(frontier).second)
+                    continue;
+                block_phis[frontier].push_back(new_value(var, nullptr, frontier, true));
+                if (queued.insert(frontier).second)
+                    worklist.push_back(frontier);
+            }
+        }
+    }
+}
+
+// 没有任何定值支配这里时，使用函数入口处的初值（形参或未初始化的变量）
+int SSABuilder::current_value(RenameStacks &stacks, std::shared_ptr<SYM> var, std::shared_ptr<BasicBlock> entry)
+{
+    auto &stack = stacks[var];
+    if (stack.empty())
+        stack.push_back(new_value(var, nullptr, entry, false));
+    return stack.back();
+}
+
+// 沿支配树先序遍历重命名，离开块时弹出本块压入的版本
+void SSABuilder::rename(std::shared_ptr<BasicBlock> block, RenameStacks &stacks, std::shared_ptr<BasicBlock> entry)
+{
+    std::vector<std::shared_ptr<SYM>> pushed;
+
+    for (int phi : get_phis(block))
+    {
+        auto var = values[phi].var;
+        stacks[var].push_back(phi);
+        pushed.push_back(var);
+    }
+
+    for (auto tac = block->start; tac; tac = tac->next)
+    {
+        for (auto &var : tac->get_uses())
+        {
+            if (!is_ssa_var(var) || use_values[tac].count(var))
+                continue;
+            int id = current_value(stacks, var, entry);
+            use_values[tac][var] = id;
+            values[id].tac_users.push_back(tac);
+        }
+
+        auto def = tac->get_def();
+        if (is_ssa_var(def))
+        {
+            int id = new_value(def, tac, block, false);
+            def_values[tac] = id;
+            stacks[def].push_back(id);
+            pushed.push_back(def);
+        }
+
+        if (tac == block->end)
+            break;
+    }
+
+    for (auto &succ : block->successors)
+    {
+        for (int phi : get_phis(succ))
+        {
+            int id = current_value(stacks, values[phi].var, entry);
+            values[phi].phi_args.push_back({block, id});
+            values[id].phi_users.push_back(phi);
+        }
+    }
+
+    for (auto &child : block_builder.get_dom_children(block))
+    {
+        rename(child, stacks, entry);
+    }
+
+    for (auto &var : pushed)
+    {
+        stacks[var].pop_back();
+    }
+}
+
+const std::vector<int> &SSABuilder::get_phis(std::shared_ptr<BasicBlock> block) const
+{
+    static const std::vector<int> empty;
+    auto it = block_phis.find(block);
+    return it != block_phis.end() ? it->second : empty;
+}
+
+int SSABuilder::get_def(std::shared_ptr<TAC> tac) const
+{
+    auto it = def_values.find(tac);
+    return it != def_values.end() ? it->second : -1;
+}
+
+int SSABuilder::get_use(std::shared_ptr<TAC> tac, std::shared_ptr<SYM> var) const
+{
+    auto it = use_values.find(tac);
+    if (it == use_values.end())
+        return -1;
+    auto var_it = it->second.find(var);
+    return var_it != it->second.end() ? var_it->second : -1;
+}
+
+void SSABuilder::print(std::ostream &os) const
+{
+    os << "\n============== SSA ===============" << std::endl;
+    for (auto &value : values)
+    {
+        if (!value.is_phi)
+            continue;
+        os << "Block " << value.block->id << ": " << value.var->name << "." << value.id << " = phi(";
+        for (size_t i = 0; i < value.phi_args.size(); ++i)
+        {
+            if (i > 0)
+                os << ", ";
+            os << value.var->name << "." << value.phi_args[i].second
+               << " <- " << value.phi_args[i].first->id;
+        }
+        os << ")" << std::endl;
+    }
+    os << "Total values: " << values.size() << std::endl;
+    os << "==================================" << std::endl;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
+#include "abstraction/ssa_struct.hh"
+#include "block.hh"
+
+namespace twlm::ccpl::modules
+{
+    using namespace twlm::ccpl::abstraction;
+
+    // 在 TAC 之上建立 SSA 视图：每个定值是一个新版本，每个使用指向唯一的版本，
+    // 汇合点按支配边界插入 phi。TAC 本身不被改写，同一变量的所有版本都合并回原变量，
+    // 所以只要变换不让版本的活跃范围重叠（例如只把使用替换成常量），出 SSA 就不需要插入拷贝
+    class SSABuilder
+    {
+    private:
+        BlockBuilder &block_builder;
+        std::vector<SSAValue> values;
+        std::unordered_map<std::shared_ptr<TAC>, int> def_values;
+        std::unordered_map<std::shared_ptr<TAC>, std::unordered_map<std::shared_ptr<SYM>, int>> use_values;
+        std::unordered_map<std::shared_ptr<BasicBlock>, std::vector<int>> block_phis;
+
+        // 重命名时每个变量当前可见的版本
+        using RenameStacks = std::unordered_map<std::shared_ptr<SYM>, std::vector<int>>;
+
+        int new_value(std::shared_ptr<SYM> var, std::shared_ptr<TAC> def,
+                      std::shared_ptr<BasicBlock> block, bool is_phi);
+        void build_function(const FunctionCFG &func);
+        void insert_phis(const FunctionCFG &func);
+        int current_value(RenameStacks &stacks, std::shared_ptr<SYM> var, std::shared_ptr<BasicBlock> entry);
+        void rename(std::shared_ptr<BasicBlock> block, RenameStacks &stacks, std::shared_ptr<BasicBlock> entry);
+
+    public:
+        SSABuilder(BlockBuilder &block_builder) : block_builder(block_builder) {}
+
+        void build();
+
+        // 只有不在内存中的标量变量进入 SSA
+        bool is_ssa_var(std::shared_ptr<SYM> sym) const;
+
+        const std::vector<SSAValue> &get_values() const { return values; }
+        const std::vector<int> &get_phis(std::shared_ptr<BasicBlock> block) const;
+
+        // 指令定值的版本，没有则返回 -1
+        int get_def(std::shared_ptr<TAC> tac) const;
+        // 指令中某个变量使用的版本，没有则返回 -1
+        int get_use(std::shared_ptr<TAC> tac, std::shared_ptr<SYM> var) const;
+
+        void print(std::ostream &os = std::cout) const;
+    };
+}
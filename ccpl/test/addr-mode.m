@@ -0,0 +1,40 @@
+struct point
+{
+    int x;
+    char tag;
+    int y;
+};
+
+int g[8];
+
+main()
+{
+    int i, s;
+    int a[6];
+    struct point pt, *pp;
+
+    i = 0;
+    while (i < 6) {
+        a[i] = i * 3;
+        g[i + 1] = a[i] + 1;
+        i = i + 1;
+    }
+
+    g[0] = a[5];
+    a[2] = g[3];
+
+    pt.x = 40;
+    pt.tag = 'p';
+    pt.y = 2;
+    pp = &pt;
+    pp->y = pp->x + pp->y;
+    pt.x = pt.x + 1;
+
+    s = a[2] + g[0] + g[6];
+    output s;
+    output "\n";
+    output pt.x;
+    output pt.tag;
+    output pp->y;
+    output "\n";
+}
@@ -0,0 +1,36 @@
+int calls;
+
+int sq(int x)
+{
+    calls = calls + 1;
+    return x * x;
+}
+
+int sum_sq(int n)
+{
+    int i, s;
+    s = 0;
+    i = 1;
+    while (i <= n) {
+        s = s + sq(i);
+        i = i + 1;
+    }
+    return s;
+}
+
+main()
+{
+    int k, total, last;
+    total = 0;
+    last = 0;
+    for (k = 1; k <= 4; k = k + 1) {
+        last = sum_sq(k);
+        total = total + last;
+    }
+    output total;
+    output " ";
+    output last;
+    output " ";
+    output calls;
+    output "\n";
+}
@@ -0,0 +1,49 @@
+int g[4];
+
+int sum(int *p, int i, int n)
+{
+	if (i >= n)
+	{
+		return 0;
+	}
+	return p[i] + sum(p, i + 1, n);
+}
+
+main()
+{
+	int a[6] = {0, 0, 0, 0, 0, 0};
+	int tmp[8];
+	int i, k, n, s;
+
+	input n;
+	k = n - n / 8 * 8;
+
+	a[0] = n;
+	a[1] = n + 1;
+	a[2] = a[0] * a[1];
+	a[3] = 0;
+	a[3] = a[2] - n;
+	a[4] = 7;
+	a[5] = 8;
+	output sum(a, 0, 6);
+	output " ";
+
+	i = 0;
+	while (i < 8)
+	{
+		tmp[i] = i * n;
+		i = i + 1;
+	}
+	s = tmp[k];
+	tmp[k] = 0;
+	tmp[k - 1] = s;
+	output s;
+	output " ";
+
+	g[k - 2] = n;
+	g[k - 2] = g[k - 2] + 1;
+	g[0] = 1;
+	g[0] = 2;
+	output g[k - 2] + g[0];
+	output "\n";
+}
@@ -0,0 +1,47 @@
+int g;
+
+int sub(int x, int y)
+{
+    return x - y;
+}
+
+int mix(int a, int b, int c, int d, int e, int f)
+{
+    g = g + 1;
+    return a * 100000 + b * 10000 + c * 1000 + d * 100 + e * 10 + f;
+}
+
+int fact(int n)
+{
+    if (n < 2) {
+        return 1;
+    }
+    return n * fact(n - 1);
+}
+
+int swap_sub(int x, int y)
+{
+    return sub(y, x);
+}
+
+main()
+{
+    int a, b, r;
+    input a;
+    input b;
+
+    r = sub(a, b);
+    output r;
+    output " ";
+    r = swap_sub(a, b);
+    output r;
+    output " ";
+    r = mix(1, 2, a, b, sub(9, 4), fact(3));
+    output r;
+    output " ";
+    r = fact(a) + sub(b, a) * 2;
+    output r;
+    output " ";
+    output g;
+    output "\n";
+}
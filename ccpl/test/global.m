@@ -0,0 +1,65 @@
+int scale, unused, count, total;
+char mark;
+
+int get(int x)
+{
+    return x * scale + unused;
+}
+
+void tick(int x)
+{
+    count = count + 1;
+    total = total + x;
+}
+
+int depth(int k)
+{
+    if (k == 0)
+    {
+        return 0;
+    }
+    count = count + 10;
+    return depth(k - 1) + 1;
+}
+
+int walk(int n)
+{
+    int i;
+    i = 0;
+    while (i < n)
+    {
+        total = total + get(i);
+        if (total > 100)
+        {
+            tick(i);
+        }
+        i = i + 1;
+    }
+    return total;
+}
+
+main()
+{
+    int n, r;
+    scale = 3;
+    mark = 'a';
+    input n;
+    r = walk(n + 5);
+    output r;
+    output " ";
+    output count;
+    output " ";
+    output total;
+    output " ";
+
+    r = 0;
+    while (r < 3)
+    {
+        count = count + 1;
+        r = r + depth(r) + 1;
+    }
+    output count;
+    output " ";
+    output mark;
+    output "\n";
+}
@@ -0,0 +1,32 @@
+main()
+{
+	int a,b,i,x,y,z;
+	int arr[10];
+	input a;
+	input b;
+
+	x = a * b + 3;
+	if (a > b)
+	{
+		y = a * b + 3;
+	}
+	else
+	{
+		y = b * a - 1;
+	}
+
+	i = 0;
+	while (i < 5)
+	{
+		arr[i + 2] = a * b;
+		z = arr[i + 2];
+		i = i + 1;
+	}
+
+	output x;
+	output " ";
+	output y;
+	output " ";
+	output z;
+	output "\n";
+}
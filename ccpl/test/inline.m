@@ -0,0 +1,65 @@
+int hits;
+
+int get(int *a, int i)
+{
+	return a[i];
+}
+
+int clamp(int x, int lo, int hi)
+{
+	if (x < lo) { return lo; }
+	if (x > hi) { return hi; }
+	return x;
+}
+
+void put(int *p, int v)
+{
+	*p = v;
+	hits = hits + 1;
+}
+
+int tri(int n)
+{
+	int s;
+	s = 0;
+	while (n > 0)
+	{
+		s = s + n;
+		n = n - 1;
+	}
+	return s;
+}
+
+int fact(int n)
+{
+	if (n <= 1) { return 1; }
+	return n * fact(n - 1);
+}
+
+main()
+{
+	int a[10];
+	int i,n,s,t;
+
+	input n;
+
+	i = 0;
+	while (i < 10)
+	{
+		put(&t, i * 7 - 20);
+		a[i] = clamp(t, 0 - n, n * 5);
+		i = i + 1;
+	}
+
+	s = 0;
+	for (i = 0; i < 10; i = i + 1)
+	{
+		s = s + get(a, i) + tri(i);
+	}
+	output s;
+	output " ";
+	output hits;
+	output " ";
+	output fact(n);
+	output "\n";
+}
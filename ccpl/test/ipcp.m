@@ -0,0 +1,73 @@
+int clamp(int x, int lo, int hi)
+{
+	if (x < lo)
+	{
+		return lo;
+	}
+	if (x > hi)
+	{
+		return hi;
+	}
+	return x;
+}
+
+int power(int base, int e, int mode)
+{
+	if (e == 0)
+	{
+		return 1;
+	}
+	if (mode == 1)
+	{
+		return clamp(base * power(base, e - 1, mode), 0, 1000);
+	}
+	return base * power(base, e - 1, mode);
+}
+
+int report(int n, int width)
+{
+	output power(n, width, 0);
+	output " ";
+	return 1;
+}
+
+int mix(int x, int mode, int scale)
+{
+	int r;
+	r = clamp(x, 0, 100);
+	if (mode == 0)
+	{
+		r = r * scale + power(2, scale, mode);
+	}
+	else
+	{
+		r = r / scale - power(3, mode, mode);
+	}
+	return r;
+}
+
+main()
+{
+	int a, b, i, s;
+	input a;
+	input b;
+
+	s = 0;
+	i = 0;
+	while (i < 10)
+	{
+		s = s + mix(i * a, 0, 4) + power(i, 3, 0);
+		i = i + 1;
+	}
+	output s;
+	output " ";
+	output mix(b, 1, 3);
+	output " ";
+	output power(a, b, 1);
+	output " ";
+	if (report(a, 2) == 1)
+	{
+		output report(b, 2) + 1;
+	}
+	output "\n";
+}
@@ -0,0 +1,71 @@
+main()
+{
+	int a, b, i, s, flag, neg;
+	input a;
+	input b;
+
+	s = 0;
+	i = 0;
+	while (i < 10)
+	{
+		if (i < a)
+		{
+			flag = 1;
+			s = s + i;
+		}
+		else
+		{
+			flag = 0;
+			s = s - b;
+		}
+		if (flag == 1)
+		{
+			s = s * 2;
+		}
+		else
+		{
+			s = s + 1;
+		}
+		i = i + 1;
+	}
+	output s;
+	output " ";
+
+	neg = 0;
+	if (b < 0)
+	{
+		neg = 1;
+		b = -b;
+	}
+	if (b < 0)
+	{
+		output "x";
+	}
+	if (neg)
+	{
+		output "-";
+	}
+	output b;
+	output " ";
+
+	s = 0;
+	i = 0;
+	while (i < 8)
+	{
+		if (i == 2)
+		{
+			s = s + 100;
+		}
+		if (i == 5)
+		{
+			s = s + 10;
+		}
+		if (i == 7)
+		{
+			s = s + 1;
+		}
+		i = i + 1;
+	}
+	output s;
+	output "\n";
+}
@@ -0,0 +1,47 @@
+main()
+{
+	int a, b, i, j, k, n, s, t;
+	input a;
+	input b;
+	input n;
+	k = n / 2;
+
+	s = 0;
+	i = 0;
+	while (i < n)
+	{
+		if (i > k)
+		{
+			s = s + a / b;
+		}
+		else
+		{
+			s = s - a / b * 2;
+		}
+		i = i + 1;
+	}
+	output s;
+	output " ";
+
+	t = 0;
+	i = 0;
+	while (i < n)
+	{
+		j = 0;
+		while (j < 3)
+		{
+			if (j == i)
+			{
+				t = t + (a + i) / b;
+			}
+			else
+			{
+				t = t + (a + i) / b + j;
+			}
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+	output t;
+	output "\n";
+}
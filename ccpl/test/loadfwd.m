@@ -0,0 +1,50 @@
+struct point
+{
+	int x;
+	int y;
+};
+
+int buf[8];
+
+void fill(int v)
+{
+	buf[2] = v;
+}
+
+main()
+{
+	int a[8];
+	struct point pt;
+	struct point *p;
+	int *q;
+	int i, n, s, t;
+
+	input n;
+	i = n - n / 8 * 8;
+
+	a[i] = n * 3;
+	s = a[i] + a[i];
+	output s;
+	output " ";
+
+	p = &pt;
+	p->x = n;
+	p->y = n + 1;
+	t = p->x * p->y + p->x;
+	output t;
+	output " ";
+
+	q = &a[0];
+	q = q + i;
+	a[i] = 7;
+	*q = 9;
+	output a[i];
+	output " ";
+
+	buf[2] = 1;
+	t = buf[2];
+	fill(n);
+	t = t + buf[2];
+	output t;
+	output "\n";
+}
@@ -0,0 +1,36 @@
+main()
+{
+	int a,b,d,i,j,n,sum;
+	input a;
+	input b;
+
+	d = 1;
+	n = 0;
+	i = 0;
+	while (i < n)
+	{
+		d = a / b;
+		i = i + 1;
+	}
+	output d;
+	output " ";
+
+	sum = 0;
+	i = 0;
+	while (i < 6)
+	{
+		i = i + 1;
+		if (i == 3)
+		{
+			continue;
+		}
+		j = 0;
+		while (j < i)
+		{
+			sum = sum + a * b;
+			j = j + 1;
+		}
+	}
+	output sum;
+	output "\n";
+}
@@ -0,0 +1,49 @@
+int g;
+
+int bump(int k)
+{
+    g = g + k;
+    return g;
+}
+
+void set(int *p)
+{
+    *p = 7;
+}
+
+int dead(int x)
+{
+    return x * 2;
+    output x;
+}
+
+main()
+{
+    int a, b, c, i;
+    g = 1;
+    a = g;
+    b = bump(2);
+    c = a + g;
+    output c;
+    output " ";
+    output b;
+    output " ";
+
+    a = 5;
+    set(&a);
+    output a;
+    output " ";
+
+    b = 0;
+    i = 0;
+    while (i < 3) {
+        c = g + 1;
+        b = b + c;
+        bump(1);
+        i = i + 1;
+    }
+    output b;
+    output " ";
+    output dead(g);
+    output "\n";
+}
@@ -0,0 +1,48 @@
+int *gp;
+int g;
+
+void bump(int *p)
+{
+	*p = *p + 1;
+	*gp = *gp + 10;
+}
+
+main()
+{
+	int a, b, c, k, s;
+	int *pa, *pb;
+
+	input a;
+	b = a * 2;
+	c = a + 3;
+	pa = &a;
+	pb = &b;
+	gp = &g;
+
+	s = 0;
+	k = 0;
+	while (k < 10)
+	{
+		*pa = *pa + k;
+		c = c + *pb;
+		s = s + c;
+		k = k + 1;
+	}
+	output a;
+	output " ";
+	output s;
+	output " ";
+
+	a = a + 1;
+	output *pa;
+	output " ";
+
+	bump(pb);
+	bump(&c);
+	output b;
+	output " ";
+	output c;
+	output " ";
+	output g;
+	output "\n";
+}
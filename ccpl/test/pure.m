@@ -0,0 +1,98 @@
+int scale;
+
+int fact(int n)
+{
+	if (n <= 1)
+	{
+		return 1;
+	}
+	return n * fact(n - 1);
+}
+
+int fib_table(int n)
+{
+	int t[20];
+	int i;
+	t[0] = 0;
+	t[1] = 1;
+	i = 2;
+	while (i < 20)
+	{
+		t[i] = t[i - 1] + t[i - 2];
+		i = i + 1;
+	}
+	return t[n];
+}
+
+struct pair
+{
+	int lo;
+	int hi;
+};
+
+int span(int a, int b)
+{
+	struct pair p;
+	struct pair *q;
+	q = &p;
+	q->lo = a;
+	q->hi = b;
+	if (p.lo > p.hi)
+	{
+		return p.lo - p.hi;
+	}
+	return p.hi - p.lo;
+}
+
+char digit(int n)
+{
+	return '0' + n - n / 10 * 10;
+}
+
+int count(int n)
+{
+	int i, s;
+	s = 0;
+	i = 0;
+	while (i < n)
+	{
+		s = s + i / 7;
+		i = i + 1;
+	}
+	return s;
+}
+
+int scaled(int n)
+{
+	return n * scale;
+}
+
+int safe_div(int a, int b)
+{
+	if (b == 0)
+	{
+		return 0;
+	}
+	return a / b;
+}
+
+main()
+{
+	int x;
+	input x;
+	scale = x;
+	output fact(7);
+	output " ";
+	output fib_table(19) + fib_table(10);
+	output " ";
+	output span(9, 4) + span(2, 11);
+	output " ";
+	output digit(1234);
+	output " ";
+	output count(3000);
+	output " ";
+	output scaled(6);
+	output " ";
+	output safe_div(17, 0) + safe_div(17, 5) + fact(x);
+	output "\n";
+}
@@ -0,0 +1,70 @@
+main()
+{
+	int a, n, i, s, c, d;
+	input a;
+	input n;
+	input c;
+
+	s = 0;
+	i = 0;
+	while (i < n)
+	{
+		if (i >= 0)
+		{
+			if (i < n)
+			{
+				s = s + i * a;
+			}
+		}
+		else
+		{
+			s = s - 1;
+		}
+		i = i + 1;
+	}
+	output s;
+	output " ";
+
+	if (c > 10)
+	{
+		c = 10;
+	}
+	if (c < 0)
+	{
+		c = 0;
+	}
+	d = 0;
+	if (c <= 10)
+	{
+		d = c * 3;
+	}
+	if (c > 20)
+	{
+		d = -1;
+	}
+	output d;
+	output " ";
+
+	s = 0;
+	i = 0;
+	while (i < 4)
+	{
+		switch (i)
+		{
+			case 0:
+				s = s + i + 1;
+				break;
+			case 2:
+				s = s * i;
+				break;
+			case 7:
+				s = -100;
+				break;
+			default:
+				s = s + 10;
+		}
+		i = i + 1;
+	}
+	output s;
+	output "\n";
+}
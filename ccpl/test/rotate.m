@@ -0,0 +1,40 @@
+main()
+{
+	int i,j,n,s,t;
+
+	input n;
+
+	s = 0;
+	i = 0;
+	while (i < n)
+	{
+		i = i + 1;
+		if (i == 3) { continue; }
+		if (i == 9) { break; }
+		s = s + i;
+	}
+	output s;
+	output " ";
+
+	t = 0;
+	for (i = 0; i < n; i = i + 1)
+	{
+		for (j = i; j < 10; j = j + 1)
+		{
+			if (j == 7) { continue; }
+			t = t + j;
+		}
+	}
+	output t;
+	output " ";
+
+	s = 0;
+	i = n;
+	while (i < 5)
+	{
+		s = s + 100;
+		i = i + 1;
+	}
+	output s;
+	output "\n";
+}
@@ -0,0 +1,28 @@
+main()
+{
+	int a,i,x,y,sum;
+	input a;
+
+	x = 1;
+	i = 0;
+	sum = 0;
+	while (i < 10)
+	{
+		if (x == 1)
+		{
+			y = 5;
+		}
+		else
+		{
+			y = a;
+			x = 2;
+		}
+		sum = sum + y;
+		i = i + 1;
+	}
+
+	output x;
+	output " ";
+	output sum;
+	output "\n";
+}
@@ -0,0 +1,22 @@
+struct S
+{
+	int a;
+	int c[3];
+};
+
+main()
+{
+	int n;
+	int arr[4];
+	int *q;
+	struct S s;
+
+	input n;
+	arr[2] = n;
+	s.c[0] = n + 5;
+	q = &arr[2];
+	output *q;
+	q = &s.c[0];
+	output *q;
+	output "\n";
+}
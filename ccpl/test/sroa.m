@@ -0,0 +1,71 @@
+struct point
+{
+	int x;
+	int y;
+	int w;
+};
+
+int sum(int *a, int n)
+{
+	int i, s;
+	s = 0;
+	for (i = 0; i < n; i = i + 1)
+	{
+		s = s + a[i];
+	}
+	return s;
+}
+
+main()
+{
+	struct point p, q;
+	int h[4];
+	int e[3];
+	int v[5];
+	char c[4];
+	int i, n, t;
+
+	input n;
+
+	p.x = n;
+	p.y = n * 2;
+	q.x = 0;
+	q.y = 0;
+	for (i = 0; i < 6; i = i + 1)
+	{
+		q.x = q.x + p.x;
+		q.y = q.y + p.y + i;
+	}
+	output q.x;
+	output " ";
+	output q.y;
+	output " ";
+
+	h[0] = n;
+	h[1] = h[0] + 1;
+	h[2] = h[1] * h[0];
+	h[3] = h[2] - h[1];
+	output h[3];
+	output " ";
+
+	e[0] = 1;
+	e[1] = n;
+	e[2] = 7;
+	output sum(e, 3);
+	output " ";
+
+	for (i = 0; i < 5; i = i + 1)
+	{
+		v[i] = i * n;
+	}
+	t = 0;
+	i = n - 3;
+	output v[i];
+	output " ";
+
+	c[0] = 'o';
+	c[1] = 'k';
+	output c[0];
+	output c[1];
+	output "\n";
+}
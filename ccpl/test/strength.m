@@ -0,0 +1,50 @@
+main()
+{
+	int a[20];
+	int m[4][5];
+	int i,j,s;
+
+	i = 0;
+	while (i < 20)
+	{
+		a[i] = i * 3;
+		i = i + 1;
+	}
+
+	s = 0;
+	i = 0;
+	while (i < 20)
+	{
+		s = s + a[i];
+		i = i + 1;
+	}
+	output s;
+	output " ";
+
+	i = 0;
+	while (i < 4)
+	{
+		j = 0;
+		while (j < 5)
+		{
+			m[i][j] = i + j;
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+
+	s = 0;
+	i = 0;
+	while (i < 4)
+	{
+		j = 0;
+		while (j < 5)
+		{
+			s = s + m[i][j] * m[i][j];
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+	output s;
+	output "\n";
+}
@@ -0,0 +1,21 @@
+int f(int dep)
+{
+    if (dep == 100)
+    {
+        output f(0);
+    }
+    if (dep <= 0)
+    {
+        return 0;
+    }
+    output dep;
+    return f(dep - 1);
+}
+
+main()
+{
+    int n;
+    input n;
+    f(n);
+    output "\n";
+}
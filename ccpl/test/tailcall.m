@@ -0,0 +1,53 @@
+int steps;
+
+int sum(int n, int acc)
+{
+	if (n == 0) { return acc; }
+	return sum(n - 1, acc + n);
+}
+
+int gcd(int a, int b)
+{
+	if (b == 0) { return a; }
+	return gcd(b, a - a / b * b);
+}
+
+int even(int n)
+{
+	steps = steps + 1;
+	if (n == 0) { return 1; }
+	return odd(n - 1);
+}
+
+int odd(int n)
+{
+	steps = steps + 1;
+	if (n == 0) { return 0; }
+	return even(n - 1);
+}
+
+void count(int n)
+{
+	if (n > 0)
+	{
+		steps = steps + 1;
+		count(n - 1);
+	}
+}
+
+main()
+{
+	int n;
+
+	input n;
+
+	output sum(n * 4000, 0);
+	output " ";
+	output gcd(n * 1071, 462);
+	output " ";
+	output even(n * 3001);
+	output " ";
+	count(n * 3000);
+	output steps;
+	output "\n";
+}
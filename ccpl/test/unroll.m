@@ -0,0 +1,41 @@
+main()
+{
+	int a[30];
+	int i,n,s;
+
+	input n;
+
+	i = 0;
+	while (i < 4)
+	{
+		a[i] = i * i;
+		i = i + 1;
+	}
+
+	i = 4;
+	while (i < 28)
+	{
+		a[i] = a[i - 1] + i;
+		i = i + 1;
+	}
+
+	s = 0;
+	i = n;
+	while (i < 30)
+	{
+		s = s + a[i];
+		i = i + 3;
+	}
+	output s;
+	output " ";
+
+	s = 0;
+	i = n + 20;
+	while (i >= n)
+	{
+		s = s + i;
+		i = i - 1;
+	}
+	output s;
+	output "\n";
+}